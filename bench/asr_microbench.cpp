@@ -0,0 +1,445 @@
+// 服务端热点路径的微基准，不加载模型，全部使用合成数据：
+//   pcm_convert   add_audio_data中的PCM转换（旧逐样本实现 / oneshot缓冲追加 / 流式环形缓冲写入）
+//   result_json   旧写法ASRResult::to_json + Json::writeString，与ResultWriter的JSON/二进制输出对比
+//   conn_lookup   ConnectionManager按句柄/按client_id查找（句柄哈希每次调用hdl.lock()）
+//   log_filtered  级别被过滤掉的LOG_*宏
+//   vad_trim      静音期间的缓冲区裁剪（旧vector重建 / 环形缓冲release_until）
+// 每个用例输出一行JSON（或CSV），便于跨版本对比
+// 用法: asr_microbench [--filter SUBSTR] [--min-time-ms N] [--repetitions N] [--format json|csv]
+#include "asr_result.h"
+#include "audio_ingest.h"
+#include "audio_ring_buffer.h"
+#include "connection_manager.h"
+#include "logger.h"
+#include "result_writer.h"
+#include <json/json.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::string filter;
+    double min_time_ms = 200.0;
+    int repetitions = 5;
+    bool csv = false;
+};
+
+// 阻止编译器把被测结果优化掉
+template <typename T>
+inline void do_not_optimize(const T& value) {
+#if defined(__GNUC__)
+    asm volatile("" : : "m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct BenchResult {
+    std::string name;
+    std::string variant;
+    size_t param = 0;
+    std::string unit;           // param的含义，例如samples、connections
+    size_t iterations = 0;      // 单次重复的迭代数
+    double ns_per_op = 0.0;     // 各次重复的中位数
+    double ns_per_op_min = 0.0;
+    double items_per_op = 1.0;  // 每次操作处理的元素数（样本等），用于换算吞吐
+};
+
+class Runner {
+public:
+    explicit Runner(const Options& options) : opts(options) {}
+
+    // op(iterations)执行iterations次被测操作。先翻倍迭代数直到单次耗时达到min_time，
+    // 再重复测量取中位数
+    void run(const std::string& name, const std::string& variant, size_t param, const std::string& unit,
+             double items_per_op, const std::function<void(size_t)>& op) {
+        std::string full_name = name + "/" + variant + "/" + std::to_string(param);
+        if (!opts.filter.empty() && full_name.find(opts.filter) == std::string::npos) return;
+
+        size_t iterations = 1;
+        while (true) {
+            double elapsed = time_once(op, iterations);
+            if (elapsed >= opts.min_time_ms * 1e6 || iterations >= (size_t(1) << 40)) break;
+            // 按已测耗时估算，最多放大10倍
+            double scale = elapsed > 0 ? opts.min_time_ms * 1e6 * 1.2 / elapsed : 10.0;
+            iterations = static_cast<size_t>(iterations * std::min(std::max(scale, 2.0), 10.0));
+        }
+
+        std::vector<double> samples;
+        for (int r = 0; r < opts.repetitions; ++r) {
+            samples.push_back(time_once(op, iterations) / iterations);
+        }
+        std::sort(samples.begin(), samples.end());
+
+        BenchResult result;
+        result.name = name;
+        result.variant = variant;
+        result.param = param;
+        result.unit = unit;
+        result.iterations = iterations;
+        result.ns_per_op = samples[samples.size() / 2];
+        result.ns_per_op_min = samples.front();
+        result.items_per_op = items_per_op;
+        print(result);
+    }
+
+    void print_header() const {
+        if (opts.csv) {
+            std::cout << "bench,variant,param,unit,iterations,ns_per_op,ns_per_op_min,ns_per_item,items_per_sec" << std::endl;
+            return;
+        }
+        Json::Value meta;
+        meta["type"] = "meta";
+        meta["timestamp"] = static_cast<Json::Int64>(std::time(nullptr));
+        meta["pcm_kernel"] = audio_ingest::get_active_kernel();
+#if defined(__VERSION__)
+        meta["compiler"] = __VERSION__;
+#endif
+#if defined(NDEBUG)
+        meta["build"] = "release";
+#else
+        meta["build"] = "debug";
+#endif
+        meta["min_time_ms"] = opts.min_time_ms;
+        meta["repetitions"] = opts.repetitions;
+        std::cout << write_compact(meta) << std::endl;
+    }
+
+private:
+    const Options& opts;
+
+    static double time_once(const std::function<void(size_t)>& op, size_t iterations) {
+        auto start = Clock::now();
+        op(iterations);
+        return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+    }
+
+    static std::string write_compact(const Json::Value& value) {
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        return Json::writeString(builder, value);
+    }
+
+    void print(const BenchResult& r) const {
+        double ns_per_item = r.ns_per_op / r.items_per_op;
+        double items_per_sec = ns_per_item > 0 ? 1e9 / ns_per_item : 0.0;
+        if (opts.csv) {
+            std::cout << r.name << "," << r.variant << "," << r.param << "," << r.unit << ","
+                      << r.iterations << "," << std::fixed << std::setprecision(3)
+                      << r.ns_per_op << "," << r.ns_per_op_min << "," << ns_per_item << ","
+                      << std::setprecision(0) << items_per_sec << std::endl;
+            return;
+        }
+        Json::Value line;
+        line["type"] = "result";
+        line["bench"] = r.name;
+        line["variant"] = r.variant;
+        line["param"] = static_cast<Json::UInt64>(r.param);
+        line["unit"] = r.unit;
+        line["iterations"] = static_cast<Json::UInt64>(r.iterations);
+        line["ns_per_op"] = r.ns_per_op;
+        line["ns_per_op_min"] = r.ns_per_op_min;
+        line["ns_per_item"] = ns_per_item;
+        line["items_per_sec"] = items_per_sec;
+        std::cout << write_compact(line) << std::endl;
+    }
+};
+
+std::vector<uint8_t> make_pcm(size_t num_samples, uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::vector<uint8_t> pcm(num_samples * 2);
+    for (auto& byte : pcm) byte = static_cast<uint8_t>(dist(rng));
+    return pcm;
+}
+
+// ---- pcm_convert ----
+
+void bench_pcm_convert(Runner& runner) {
+    for (size_t frame : {320, 1600}) {
+        const std::vector<uint8_t> pcm = make_pcm(frame, 1);
+
+        // 原add_audio_data：负载先复制进vector<uint8_t>，再逐样本push_back
+        runner.run("pcm_convert", "legacy_push_back", frame, "samples", static_cast<double>(frame), [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                std::vector<uint8_t> copy(pcm.begin(), pcm.end());
+                std::vector<float> samples;
+                for (size_t j = 0; j + 1 < copy.size(); j += 2) {
+                    int16_t sample = static_cast<int16_t>(copy[j] | (copy[j + 1] << 8));
+                    samples.push_back(static_cast<float>(sample) / 32768.0f);
+                }
+                do_not_optimize(samples.data());
+            }
+        });
+
+        // OneShotASRSession::add_audio_data：追加到录音缓冲区，定期清空模拟新一轮录音
+        runner.run("pcm_convert", "oneshot_append", frame, "samples", static_cast<double>(frame), [&](size_t n) {
+            std::vector<float> buffer;
+            buffer.reserve(16000 * 60);
+            for (size_t i = 0; i < n; ++i) {
+                if (buffer.size() + frame > buffer.capacity()) buffer.clear();
+                audio_ingest::append_pcm16le(pcm.data(), pcm.size(), buffer);
+                do_not_optimize(buffer.data());
+            }
+        });
+
+        // ASRSession::add_audio_data：写入环形缓冲区，消费者立即释放
+        runner.run("pcm_convert", "ring_write", frame, "samples", static_cast<double>(frame), [&](size_t n) {
+            AudioRingBuffer ring(16000 * 10);
+            for (size_t i = 0; i < n; ++i) {
+                ring.write_pcm16le(pcm.data(), frame);
+                ring.release_until(ring.end());
+            }
+            do_not_optimize(ring.end());
+        });
+    }
+}
+
+// ---- result_json ----
+
+ASRResult make_result(bool finished) {
+    ASRResult result;
+    result.text = finished ? "今天天气不错，我们下午一起去公园散步吧" : "今天天气不错";
+    result.finished = finished;
+    result.idx = 3;
+    result.lang = "zh";
+    if (finished) {
+        result.emotion = "NEUTRAL";
+        result.event = "Speech";
+        const char* tokens[] = {"今", "天", "天", "气", "不", "错", "，", "我", "们", "下", "午",
+                                "一", "起", "去", "公", "园", "散", "步", "吧"};
+        float t = 0.12f;
+        for (const char* token : tokens) {
+            result.tokens.push_back(token);
+            result.timestamps.push_back(t);
+            t += 0.18f;
+        }
+    }
+    return result;
+}
+
+void bench_result_json(Runner& runner) {
+    for (bool finished : {false, true}) {
+        const ASRResult result = make_result(finished);
+        const std::string variant = finished ? "final" : "partial";
+        const size_t token_count = result.tokens.size();
+
+        // 旧的send_result写法：每次构造StreamWriterBuilder（默认带缩进）
+        runner.run("result_json", variant, token_count, "tokens", 1.0, [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                Json::Value json_result = result.to_json();
+                Json::StreamWriterBuilder builder;
+                std::string json_string = Json::writeString(builder, json_result);
+                do_not_optimize(json_string.data());
+            }
+        });
+
+        runner.run("result_json", variant + "_to_json_only", token_count, "tokens", 1.0, [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                Json::Value json_result = result.to_json();
+                do_not_optimize(json_result);
+            }
+        });
+        
+        // 当前send_result：会话内复用的ResultWriter
+        ResultWriter writer;
+        runner.run("result_json", variant + "_writer", token_count, "tokens", 1.0, [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                const std::string& json_string = writer.write_json(result);
+                do_not_optimize(json_string.data());
+            }
+        });
+        
+        // ?fields=text：只写text/finished/idx
+        runner.run("result_json", variant + "_writer_text_only", token_count, "tokens", 1.0, [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                const std::string& json_string = writer.write_json(result, 0);
+                do_not_optimize(json_string.data());
+            }
+        });
+        
+        runner.run("result_json", variant + "_binary", token_count, "tokens", 1.0, [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                const std::string& frame = writer.write_binary(result);
+                do_not_optimize(frame.data());
+            }
+        });
+    }
+}
+
+// ---- conn_lookup ----
+
+void bench_conn_lookup(Runner& runner) {
+    for (size_t count : {10, 1000}) {
+        ConnectionManager manager;
+        std::vector<std::shared_ptr<int>> owners;
+        std::vector<connection_hdl> handles;
+        std::vector<std::string> ids;
+        for (size_t i = 0; i < count; ++i) {
+            owners.push_back(std::make_shared<int>(static_cast<int>(i)));
+            handles.push_back(owners.back());
+            ids.push_back(manager.add_connection(handles.back()));
+        }
+
+        // 查找顺序打乱，避免顺序访问带来的缓存优势
+        std::vector<size_t> order(count * 4);
+        std::mt19937 rng(7);
+        for (auto& index : order) index = rng() % count;
+
+        runner.run("conn_lookup", "get_client_id", count, "connections", 1.0, [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                std::string id = manager.get_client_id(handles[order[i % order.size()]]);
+                do_not_optimize(id.data());
+            }
+        });
+
+        runner.run("conn_lookup", "get_connection", count, "connections", 1.0, [&](size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                connection_hdl hdl = manager.get_connection(ids[order[i % order.size()]]);
+                do_not_optimize(hdl);
+            }
+        });
+
+        // 单独的句柄哈希（lock()带来的原子引用计数增减）
+        ConnectionHdlHash hash;
+        runner.run("conn_lookup", "hdl_hash", count, "connections", 1.0, [&](size_t n) {
+            size_t acc = 0;
+            for (size_t i = 0; i < n; ++i) {
+                acc += hash(handles[order[i % order.size()]]);
+            }
+            do_not_optimize(acc);
+        });
+    }
+}
+
+// ---- log_filtered ----
+
+void bench_log_filtered(Runner& runner) {
+    Logger::set_level(LogLevel::ERROR);
+    const std::string client_id = "client_000001_1234";
+    const std::string text = "今天天气不错";
+
+    runner.run("log_filtered", "debug_literal", 0, "args", 1.0, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            LOG_DEBUG(client_id, "Speech detected, starting recognition");
+        }
+    });
+
+    // 典型的带多个插值参数的调用，如发送结果时的日志
+    runner.run("log_filtered", "debug_formatted", 4, "args", 1.0, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            LOG_DEBUG(client_id, "Sent result: " << text << ", idx=" << i << ", rtf=" << 0.123f);
+        }
+    });
+
+    runner.run("log_filtered", "info_formatted", 4, "args", 1.0, [&](size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            LOG_INFO(client_id, "Sent result: " << text << ", idx=" << i << ", rtf=" << 0.123f);
+        }
+    });
+    Logger::set_level(LogLevel::INFO);
+}
+
+// ---- vad_trim ----
+
+void bench_vad_trim(Runner& runner) {
+    const size_t window_size = 512;
+    const size_t keep = 10 * window_size;
+
+    for (size_t frame : {320, 1600}) {
+        const std::vector<uint8_t> pcm = make_pcm(frame, 3);
+        std::vector<float> samples(frame);
+        audio_ingest::convert_pcm16le(pcm.data(), frame, samples.data());
+
+        // 原处理线程：静音时缓冲区超过10个窗口就重建为最后10个窗口
+        runner.run("vad_trim", "legacy_vector_rebuild", frame, "samples", static_cast<double>(frame), [&](size_t n) {
+            std::vector<float> buffer;
+            for (size_t i = 0; i < n; ++i) {
+                buffer.insert(buffer.end(), samples.begin(), samples.end());
+                if (buffer.size() > keep) {
+                    buffer = std::vector<float>(buffer.end() - keep, buffer.end());
+                }
+                do_not_optimize(buffer.data());
+            }
+        });
+
+        // 现实现：写入环形缓冲区，静音时release_until把已判决音频之前的空间归还生产者
+        runner.run("vad_trim", "ring_release", frame, "samples", static_cast<double>(frame), [&](size_t n) {
+            AudioRingBuffer ring(16000 * 10);
+            uint64_t begin = 0;
+            for (size_t i = 0; i < n; ++i) {
+                ring.write(samples.data(), frame);
+                uint64_t processed = ring.end();
+                if (processed > begin + keep) {
+                    begin = processed - keep;
+                    ring.release_until(begin);
+                }
+                do_not_optimize(begin);
+            }
+        });
+    }
+}
+
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options]\n\n"
+              << "Options:\n"
+              << "  --filter SUBSTR      Only run benchmarks whose bench/variant/param name contains SUBSTR\n"
+              << "  --min-time-ms N      Minimum time per repetition (default: 200)\n"
+              << "  --repetitions N      Repetitions per benchmark, the median is reported (default: 5)\n"
+              << "  --format json|csv    Output format (default: json, one object per line)\n"
+              << "  --help, -h           Show this help message\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        }
+        else if (arg == "--filter" && i + 1 < argc) {
+            opts.filter = argv[++i];
+        }
+        else if (arg == "--min-time-ms" && i + 1 < argc) {
+            opts.min_time_ms = std::max(1.0, std::atof(argv[++i]));
+        }
+        else if (arg == "--repetitions" && i + 1 < argc) {
+            opts.repetitions = std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--format" && i + 1 < argc) {
+            opts.csv = std::string(argv[++i]) == "csv";
+        }
+        else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 2;
+        }
+    }
+
+    Runner runner(opts);
+    runner.print_header();
+    bench_pcm_convert(runner);
+    bench_result_json(runner);
+    bench_conn_lookup(runner);
+    bench_log_filtered(runner);
+    bench_vad_trim(runner);
+    return 0;
+}
@@ -0,0 +1,113 @@
+// 音频接入转换核的微基准：对比逐样本push_back的旧实现与标量/SSE2/AVX2转换核
+// 用法: audio_ingest_bench [total_samples]
+#include "audio_ingest.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef bool (*KernelFn)(const uint8_t*, size_t, float*);
+
+// 原ASRSession::add_audio_data中的转换方式
+void legacy_convert(const std::vector<uint8_t>& pcm_bytes, std::vector<float>& samples) {
+    samples.clear();
+    for (size_t i = 0; i < pcm_bytes.size(); i += 2) {
+        if (i + 1 < pcm_bytes.size()) {
+            int16_t sample = static_cast<int16_t>(pcm_bytes[i] | (pcm_bytes[i + 1] << 8));
+            samples.push_back(static_cast<float>(sample) / 32768.0f);
+        }
+    }
+}
+
+volatile float sink;
+
+void report(const std::string& kernel, size_t frame_samples, size_t total_samples, double seconds) {
+    double ns_per_sample = seconds * 1e9 / total_samples;
+    std::cout << std::left << std::setw(10) << kernel
+              << std::right << std::setw(8) << frame_samples
+              << std::setw(14) << std::fixed << std::setprecision(3) << ns_per_sample
+              << std::setw(14) << std::setprecision(1) << total_samples / seconds / 1e6
+              << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t total_samples = (argc > 1) ? std::strtoull(argv[1], nullptr, 10) : 64 * 1024 * 1024;
+    
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(0, 255);
+    std::vector<uint8_t> pcm(2 * 16000 * 10 + 1);
+    for (auto& byte : pcm) byte = static_cast<uint8_t>(dist(rng));
+    
+    // 先校验各转换核与标量实现逐位一致（含奇数长度的尾部处理）
+    const size_t check_samples = pcm.size() / 2;
+    std::vector<float> reference(check_samples), output(check_samples);
+    audio_ingest::convert_pcm16le_scalar(pcm.data() + 1, check_samples - 1, reference.data());
+    
+    struct Kernel { const char* name; KernelFn fn; };
+    const Kernel kernels[] = {
+        {"scalar", audio_ingest::convert_pcm16le_scalar},
+        {"sse2", audio_ingest::convert_pcm16le_sse2},
+        {"avx2", audio_ingest::convert_pcm16le_avx2},
+    };
+    for (const auto& kernel : kernels) {
+        if (!kernel.fn(pcm.data() + 1, check_samples - 1, output.data())) continue;
+        if (std::memcmp(reference.data(), output.data(), (check_samples - 1) * sizeof(float)) != 0) {
+            std::cerr << "Kernel " << kernel.name << " does not match scalar reference" << std::endl;
+            return 1;
+        }
+    }
+    
+    std::cout << "Active kernel: " << audio_ingest::get_active_kernel() << std::endl;
+    std::cout << std::left << std::setw(10) << "kernel"
+              << std::right << std::setw(8) << "frame"
+              << std::setw(14) << "ns/sample"
+              << std::setw(14) << "Msamples/s" << std::endl;
+    
+    // 20ms、100ms帧与1秒的大块
+    for (size_t frame_samples : {320, 1600, 16000}) {
+        const size_t iterations = std::max<size_t>(1, total_samples / frame_samples);
+        const size_t measured = iterations * frame_samples;
+        std::vector<uint8_t> frame_bytes(pcm.begin(), pcm.begin() + frame_samples * 2);
+        
+        {
+            std::vector<float> samples;
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                // 旧实现每帧还会把负载复制到新的vector
+                std::vector<uint8_t> copy(frame_bytes.begin(), frame_bytes.end());
+                std::vector<float> fresh;
+                legacy_convert(copy, fresh);
+                sink = fresh.back();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            report("legacy", frame_samples, measured, elapsed.count());
+        }
+        
+        std::vector<float> dst(frame_samples);
+        for (const auto& kernel : kernels) {
+            if (!kernel.fn(frame_bytes.data(), frame_samples, dst.data())) {
+                std::cout << std::left << std::setw(10) << kernel.name << " unsupported on this CPU" << std::endl;
+                continue;
+            }
+            auto start = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < iterations; ++i) {
+                kernel.fn(frame_bytes.data(), frame_samples, dst.data());
+                sink = dst[i % frame_samples];
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            report(kernel.name, frame_samples, measured, elapsed.count());
+        }
+    }
+    
+    return 0;
+}
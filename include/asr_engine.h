@@ -1,8 +1,10 @@
 #pragma once
 
 #include "model_pool.h"
+#include "worker_pool.h"
 #include <sherpa-onnx/c-api/cxx-api.h>
 #include <string>
+#include <vector>
 #include <memory>
 #include <atomic>
 
@@ -14,6 +16,8 @@ class ASREngine {
 private:
     std::unique_ptr<ModelManager> model_manager;        // 向后兼容的旧接口
     std::unique_ptr<ModelPoolManager> pool_manager;     // 新的优化管理器
+    std::unique_ptr<ServerConfig> config;               // 初始化时的配置副本，供会话读取
+    std::unique_ptr<WorkerPool> worker_pool;            // 会话后台任务（解码前后处理）
     std::atomic<bool> initialized;
     
 public:
@@ -25,17 +29,30 @@ public:
     bool is_initialized() const;
     float get_sample_rate() const;
     
-    // Create a new VAD instance for each session
-    std::unique_ptr<sherpa_onnx::cxx::VoiceActivityDetector> create_vad() const;
+    // 获取服务器配置（仅在初始化后有效）
+    const ServerConfig& get_config() const;
+    
+    // 为会话创建VAD流，source为会话的音频环形缓冲区，on_event在判决状态变化时调用
+    std::unique_ptr<VADStream> create_vad_stream(const AudioRingBuffer* source, 
+                                                 VADService::EventCallback on_event) const;
     
     // 新增方法：获取共享ASR引擎
     SharedASREngine* get_shared_asr() const;
     
-    // 新增方法：获取VAD池
-    VADPool* get_vad_pool() const;
+    // 获取共享VAD服务
+    VADService* get_vad_service() const;
+    
+    // 整段录音的识别（ONESHOT优先级）：超过segment_threshold_samples时先用VAD切分，
+    // 多个语音段并行解码后按顺序拼接，否则整段提交。on_complete在解码线程中执行；
+    // VAD未检测到语音时返回false且不回调，共享ASR引擎不可用时抛出异常
+    bool decode_recording(std::vector<float> samples, size_t segment_threshold_samples, uint32_t result_fields,
+                          SegmentedDecode::JoinCallback on_complete, const std::string& log_id) const;
+    
+    // 获取工作线程池
+    WorkerPool* get_worker_pool() const;
     
-    // 新增方法：释放VAD实例
-    void release_vad(std::unique_ptr<sherpa_onnx::cxx::VoiceActivityDetector> vad) const;
+    // 获取模型池统计信息（只读原子计数，不争用解码队列锁）
+    ModelPoolManager::SystemStats get_system_stats() const;
     
     // 获取模型管理器的直接访问（用于高级用法）
     ModelManager* get_model_manager() const;
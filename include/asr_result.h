@@ -1,9 +1,21 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <json/json.h>
 
+// 结果中的可选字段，text、finished、idx总是返回。
+// 连接时未请求的字段既不从解码结果中取出，也不序列化
+enum ResultField : uint32_t {
+    RESULT_FIELD_LANG = 1 << 0,
+    RESULT_FIELD_EMOTION = 1 << 1,
+    RESULT_FIELD_EVENT = 1 << 2,
+    RESULT_FIELD_TIMESTAMPS = 1 << 3,
+    RESULT_FIELD_TOKENS = 1 << 4,
+    RESULT_FIELDS_ALL = (1 << 5) - 1
+};
+
 struct ASRResult {
     std::string text;
     bool finished;
@@ -2,41 +2,91 @@
 
 #include "asr_engine.h"
 #include "asr_result.h"
+#include "audio_budget.h"
+#include "audio_ring_buffer.h"
+#include "result_writer.h"
+#include "trace.h"
+#include "vad_service.h"
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
 #include <string>
 #include <vector>
 #include <memory>
-#include <thread>
-#include <queue>
+#include <map>
+#include <cstdint>
 #include <mutex>
-#include <condition_variable>
 #include <atomic>
 #include <chrono>
 
 typedef websocketpp::server<websocketpp::config::asio> server;
 typedef websocketpp::connection_hdl connection_hdl;
 
-class ASRSession {
+class ASRSession : public std::enable_shared_from_this<ASRSession> {
 private:
     ASREngine* engine;
     connection_hdl hdl;
     server* ws_server;
     std::string client_id;
     std::atomic<bool> running;
-    std::thread processing_thread;
     
-    std::queue<std::vector<float>> audio_queue;
-    std::mutex audio_mutex;
-    std::condition_variable audio_cv;
+    // 音频处理不再占用独立线程：新音频到达时把处理任务投递到共享工作线程池，
+    // processing_scheduled保证同一会话同时最多只有一个处理任务，从而保持音频顺序
+    std::atomic<bool> processing_scheduled{false};
+    std::atomic<bool> vad_event_pending{false};
+    static const int max_steps_per_task = 64;
     
-    std::unique_ptr<sherpa_onnx::cxx::VoiceActivityDetector> vad;
+    // 会话音频保存在单生产者/单消费者环形缓冲区中：I/O线程写入，处理任务读取。
+    // 以下位置均为环形缓冲区中的绝对样本序号，仅由处理任务访问：
+    // [utterance_begin, buffered_end)为当前句（静音时为保留的上下文）
+    std::unique_ptr<AudioRingBuffer> audio_ring;
+    uint64_t utterance_begin = 0;
+    uint64_t buffered_end = 0;
+    static const size_t process_step_samples = 2048;
+    
+    // 未处理音频的预算（按16位PCM字节计）：I/O线程写入前计入buffered_bytes并申请全局预算，
+    // 处理任务消费后归还。overflow_reported仅由I/O线程访问，一次连续溢出只通知客户端一次
+    AudioOverflowPolicy overflow_policy = AudioOverflowPolicy::REJECT;
+    size_t max_buffered_bytes = 0;
+    std::atomic<size_t> buffered_bytes{0};
+    bool overflow_reported = false;
+    
+    // VAD流从audio_ring读取窗口，必须声明在audio_ring之后以先于它销毁。
+    // 静音时保留idle_context_samples个已判决样本，覆盖VAD检测到语音时的回看范围；
+    // 语音期间的音频在最终识别提交前一直保留，超过max_utterance_samples仍未切分时强制提交。
+    // final_end为已提交最终识别的音频终点
+    std::unique_ptr<VADStream> vad_stream;
+    size_t idle_context_samples = 0;
+    size_t max_utterance_samples = 0;
+    uint64_t final_end = 0;
     std::atomic<int> segment_id;
-    std::vector<float> buffer;
-    std::atomic<int> offset;
     std::atomic<bool> speech_started;
     std::chrono::steady_clock::time_point started_time;
-    static const int window_size = 512;
+    
+    // 增量部分识别状态：当前句前partial_commit_offset个样本的识别结果已缓存在
+    // partial_committed中，每次部分识别只解码其后的尾部音频。
+    // 部分识别和最终识别都异步完成，result_mutex同时保护状态与结果的发送，
+    // utterance_generation在每句结束时递增，用于丢弃过时的部分结果
+    bool incremental_partial;
+    size_t partial_window_samples;
+    std::mutex result_mutex;
+    size_t partial_commit_offset = 0;
+    RecognitionResult partial_committed;
+    bool partial_commit_in_flight = false;
+    int utterance_generation = 0;
+    
+    // 最终识别按提交顺序发送：先完成的后序结果暂存在completed_finals中，
+    // 仍有最终识别未发出时不发送部分结果，避免与前一句的最终结果交错
+    uint64_t finals_submitted = 0;
+    uint64_t next_final_to_send = 0;
+    struct PendingFinal {
+        RecognitionResult result;
+        std::chrono::steady_clock::time_point segment_time;  // VAD给出该语音段的时刻
+    };
+    std::map<uint64_t, PendingFinal> completed_finals;
+    
+    // 结果在result_mutex下发送，序列化缓冲区随会话复用
+    ResultFormat result_format;
+    ResultWriter result_writer;
     
     // ASR实例管理
     std::atomic<int> acquired_asr_instance{-1};
@@ -44,25 +94,50 @@ private:
     // Performance metrics
     std::atomic<size_t> processed_samples{0};
     std::atomic<size_t> processed_segments{0};
+    std::atomic<size_t> dropped_samples{0};
     std::chrono::steady_clock::time_point session_start_time;
     
+    // 延迟追踪轨道，未开启追踪时为0
+    uint32_t trace_track = 0;
+    uint64_t traced_vad_samples = 0;
+    
 public:
-    ASRSession(ASREngine* eng, connection_hdl h, server* srv, const std::string& id);
+    ASRSession(ASREngine* eng, connection_hdl h, server* srv, const std::string& id,
+               const ResultFormat& format = ResultFormat());
     ~ASRSession();
     
     void start();
     void stop();
-    void add_audio_data(const std::vector<uint8_t>& pcm_bytes);
+    void add_audio_data(const uint8_t* pcm_bytes, size_t num_bytes);
     
     std::string get_client_id() const;
     bool is_running() const;
+    uint32_t get_trace_track() const { return trace_track; }
 
 private:
-    void process_audio();
+    void schedule_processing();
+    void post_processing_task();
+    void process_pending_audio();
+    void process_samples(uint64_t step_end);
+    void release_utterance_until(uint64_t position);
+    void handle_overflow(size_t dropped, const char* reason);
+    // 复制当前句中[begin, end)范围的样本（相对utterance_begin）
+    std::vector<float> copy_utterance(size_t begin, size_t end) const {
+        std::vector<float> samples(end - begin);
+        audio_ring->copy_to(utterance_begin + begin, samples.size(), samples.data());
+        return samples;
+    }
+    size_t utterance_size() const { return static_cast<size_t>(buffered_end - utterance_begin); }
     // Legacy methods - deprecated
     // void perform_recognition(bool is_final);
     // void process_speech_segment(const sherpa_onnx::cxx::SpeechSegment& segment);
-    void process_speech_segment_shared(const sherpa_onnx::cxx::SpeechSegment& segment);
-    void perform_recognition_shared(bool is_final);
+    void process_speech_segment_shared(const VADSegment& segment);
+    void on_final_result(uint64_t sequence, std::chrono::steady_clock::time_point segment_time,
+                         RecognitionResult result);
+    void submit_partial_recognition();
+    void on_partial_prefix_committed(int generation, size_t commit_end, RecognitionResult result);
+    void on_partial_result(int generation, size_t tail_start, RecognitionResult prefix, RecognitionResult tail);
+    size_t find_partial_cut_point() const;
+    void reset_partial_state();
     void send_result(const ASRResult& result);
 };
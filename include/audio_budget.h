@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+
+// 会话音频缓冲超出预算时的处理方式
+enum class AudioOverflowPolicy {
+    DROP_OLDEST = 0,    // 丢弃最早缓冲的音频，为新帧腾出空间
+    REJECT = 1,         // 丢弃新到的帧
+    CLOSE = 2           // 以1013 (Try Again Later) 关闭连接
+};
+
+// 名称为drop_oldest、reject、close，无法识别时返回false
+bool parse_audio_overflow_policy(const std::string& name, AudioOverflowPolicy& policy);
+const char* audio_overflow_policy_name(AudioOverflowPolicy policy);
+
+// 全部会话共享的音频缓冲预算，按收到的16位PCM字节计。
+// 会话缓冲音频前申请，音频被处理或丢弃后归还；limit为0表示不限制
+class AudioMemoryBudget {
+private:
+    std::atomic<size_t> used{0};
+    std::atomic<size_t> limit{0};
+
+public:
+    static AudioMemoryBudget& instance();
+
+    void set_limit(size_t bytes) { limit.store(bytes, std::memory_order_relaxed); }
+    size_t get_limit() const { return limit.load(std::memory_order_relaxed); }
+    size_t get_used() const { return used.load(std::memory_order_relaxed); }
+
+    // 超出预算时不申请并返回false
+    bool try_acquire(size_t bytes);
+    void release(size_t bytes);
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// 音频接入 - 把客户端发送的16位小端PCM直接从消息负载转换为浮点样本，
+// 写入会话的目标缓冲区，不经过中间拷贝。
+// 转换核按CPU能力在运行时选择：AVX2 > SSE2 > 标量
+namespace audio_ingest {
+
+// 转换num_samples个样本，src为原始字节（无对齐要求），dst需能容纳num_samples个float
+void convert_pcm16le(const uint8_t* src, size_t num_samples, float* dst);
+
+// 将num_bytes字节PCM追加到dst末尾，末尾不足一个样本的字节被忽略，返回追加的样本数
+size_t append_pcm16le(const void* data, size_t num_bytes, std::vector<float>& dst);
+
+// 解析16位PCM WAV（RIFF/WAVE），多声道取平均下混为单声道后转换为浮点样本写入samples。
+// 采样率必须等于expected_rate（不做重采样），失败时error给出原因
+bool decode_wav(const uint8_t* data, size_t size, int expected_rate, 
+                std::vector<float>& samples, std::string& error);
+
+// 读取并解析WAV文件，同decode_wav
+bool load_wav_file(const std::string& path, int expected_rate, 
+                   std::vector<float>& samples, std::string& error);
+
+// 当前使用的转换核名称："avx2"、"sse2"或"scalar"
+const char* get_active_kernel();
+
+// 各转换核的直接入口，供基准测试对比；CPU不支持的核返回false且不写入dst
+bool convert_pcm16le_scalar(const uint8_t* src, size_t num_samples, float* dst);
+bool convert_pcm16le_sse2(const uint8_t* src, size_t num_samples, float* dst);
+bool convert_pcm16le_avx2(const uint8_t* src, size_t num_samples, float* dst);
+
+} // namespace audio_ingest
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "audio_ingest.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+#include <algorithm>
+
+// 单生产者/单消费者音频环形缓冲区。
+// 位置使用单调递增的绝对样本序号，消费者通过release_until释放不再需要的历史样本，
+// 在此之前的样本一直保留，可作为VAD窗口和解码区间反复读取。
+// 存储区只有一份（容量个样本），每个样本只写一次；读取的区间跨越存储区末尾时
+// 才复制到调用方的临时缓冲区拼接，每写满一圈最多发生一次
+class AudioRingBuffer {
+private:
+    static constexpr size_t cache_line_size = 64;
+    
+    struct AlignedDelete {
+        void operator()(float* ptr) const {
+            ::operator delete[](ptr, std::align_val_t(cache_line_size));
+        }
+    };
+    
+    const size_t capacity_;
+    std::unique_ptr<float[], AlignedDelete> storage;
+    
+    // 生产者与消费者的位置分别独占缓存行，避免伪共享
+    alignas(cache_line_size) std::atomic<uint64_t> write_pos{0};
+    uint64_t cached_read_pos = 0;         // 生产者持有的read_pos快照
+    alignas(cache_line_size) std::atomic<uint64_t> read_pos{0};
+    
+    // 写入[pos, pos + count)之前由调用方保证空间足够，fill负责填充连续的目标区
+    template <typename Fill>
+    void write_slots(uint64_t pos, size_t count, Fill fill) {
+        size_t slot = static_cast<size_t>(pos % capacity_);
+        size_t first = std::min(count, capacity_ - slot);
+        
+        fill(storage.get() + slot, 0, first);
+        if (first < count) {
+            fill(storage.get(), first, count - first);
+        }
+    }
+    
+    size_t reserve_for_write(size_t count) {
+        uint64_t pos = write_pos.load(std::memory_order_relaxed);
+        if (pos + count - cached_read_pos > capacity_) {
+            cached_read_pos = read_pos.load(std::memory_order_acquire);
+        }
+        return std::min<size_t>(count, capacity_ - static_cast<size_t>(pos - cached_read_pos));
+    }
+    
+public:
+    // 存储区不清零：只读取已写入的样本，未写入的页面在首次写入前不占用物理内存，
+    // 空闲会话的常驻内存因此只随实际收到的音频增长
+    explicit AudioRingBuffer(size_t capacity)
+        : capacity_(capacity),
+          storage(static_cast<float*>(::operator new[](capacity * sizeof(float), 
+                                                       std::align_val_t(cache_line_size)))) {}
+    
+    AudioRingBuffer(const AudioRingBuffer&) = delete;
+    AudioRingBuffer& operator=(const AudioRingBuffer&) = delete;
+    
+    // ---- 生产者 ----
+    
+    // 剩余空间能否容纳num_samples个样本；调用方据此整帧接收或整帧丢弃
+    bool can_write(size_t num_samples) {
+        return reserve_for_write(num_samples) == num_samples;
+    }
+    
+    // 把16位小端PCM直接转换写入缓冲区，返回写入的样本数；空间不足时只写入能容纳的部分
+    size_t write_pcm16le(const uint8_t* pcm_bytes, size_t num_samples) {
+        size_t count = reserve_for_write(num_samples);
+        if (count == 0) return 0;
+        
+        uint64_t pos = write_pos.load(std::memory_order_relaxed);
+        write_slots(pos, count, [pcm_bytes](float* dst, size_t offset, size_t n) {
+            audio_ingest::convert_pcm16le(pcm_bytes + offset * 2, n, dst);
+        });
+        write_pos.store(pos + count, std::memory_order_release);
+        return count;
+    }
+    
+    size_t write(const float* samples, size_t num_samples) {
+        size_t count = reserve_for_write(num_samples);
+        if (count == 0) return 0;
+        
+        uint64_t pos = write_pos.load(std::memory_order_relaxed);
+        write_slots(pos, count, [samples](float* dst, size_t offset, size_t n) {
+            std::memcpy(dst, samples + offset, n * sizeof(float));
+        });
+        write_pos.store(pos + count, std::memory_order_release);
+        return count;
+    }
+    
+    // ---- 消费者 ----
+    
+    // 已写入样本的结束位置
+    uint64_t end() const { return write_pos.load(std::memory_order_acquire); }
+    
+    // 仍保留的最早样本位置
+    uint64_t begin() const { return read_pos.load(std::memory_order_relaxed); }
+    
+    // 把[pos, pos + count)复制到dst，区间须未释放且已写入
+    void copy_to(uint64_t pos, size_t count, float* dst) const {
+        size_t slot = static_cast<size_t>(pos % capacity_);
+        size_t first = std::min(count, capacity_ - slot);
+        std::memcpy(dst, storage.get() + slot, first * sizeof(float));
+        if (first < count) {
+            std::memcpy(dst + first, storage.get(), (count - first) * sizeof(float));
+        }
+    }
+    
+    // [pos, pos + count)的连续视图：不跨越存储区末尾时直接指向缓冲区，否则复制到scratch。
+    // 返回的指针在scratch下次修改或区间释放前有效
+    const float* view(uint64_t pos, size_t count, std::vector<float>& scratch) const {
+        size_t slot = static_cast<size_t>(pos % capacity_);
+        if (count <= capacity_ - slot) return storage.get() + slot;
+        scratch.resize(count);
+        copy_to(pos, count, scratch.data());
+        return scratch.data();
+    }
+    
+    // 释放pos之前的样本，生产者随后可以覆盖这部分空间
+    void release_until(uint64_t pos) {
+        read_pos.store(pos, std::memory_order_release);
+    }
+    
+    size_t capacity() const { return capacity_; }
+};
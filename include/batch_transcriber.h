@@ -0,0 +1,64 @@
+#pragma once
+
+#include "asr_engine.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// 前向声明
+class ServerConfig;
+
+// 离线批量转写 - 不启动网络服务，直接复用ASREngine、共享VAD和SharedASREngine。
+// 每个文件在工作线程上读取并用VAD切分成语音段，所有文件的语音段进入同一个解码队列，
+// 由调度器组成满批次并分布到全部识别器副本；同时处理的文件数由jobs限制以控制内存。
+// 每个文件完成后立即向输出追加一行JSON并刷新，中断后可用resume跳过已写入的文件
+class BatchTranscriber {
+private:
+    struct FileJob;
+
+    ASREngine asr_engine;
+    std::unique_ptr<ServerConfig> config_;
+
+    std::ofstream output;
+    std::mutex output_mutex;
+
+    // 同时处理的文件数
+    size_t max_in_flight = 1;
+    size_t in_flight = 0;
+    std::mutex flight_mutex;
+    std::condition_variable flight_cv;
+
+    // 统计
+    std::atomic<size_t> files_done{0};
+    std::atomic<size_t> files_failed{0};
+    std::atomic<uint64_t> audio_samples{0};
+    std::atomic<size_t> segments_decoded{0};
+
+    // 展开输入为WAV文件列表：单个文件、目录（递归查找*.wav，按路径排序）或列表文件
+    bool collect_inputs(std::vector<std::string>& files) const;
+
+    // 读取已有输出中记录过的文件；最后一行不完整时ends_with_newline为false
+    std::unordered_set<std::string> load_completed(bool& ends_with_newline) const;
+
+    void process_file(const std::string& path);
+    void finish_file(const std::shared_ptr<FileJob>& job, RecognitionResult joined,
+                     size_t failed_segments, size_t total_segments);
+    void write_error(const std::string& path, const std::string& error);
+    void write_line(const std::string& line);
+    void release_slot();
+
+public:
+    explicit BatchTranscriber(const ServerConfig& config);
+    ~BatchTranscriber();
+
+    bool initialize();
+
+    // 转写全部输入并输出汇总，返回进程退出码（有文件失败时为1）
+    int run();
+};
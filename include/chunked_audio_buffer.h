@@ -0,0 +1,110 @@
+#pragma once
+
+#include "audio_ingest.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <vector>
+
+// 分段录音缓冲区。样本按段追加，已写入的样本不会因扩容被重新分配和复制；
+// 第一段按预估的录音长度预留，写满后每次新增chunk_samples个样本的一段。
+// take()取出连续样本：只有一段时直接移交，多段时边拼接边释放已复制的段，
+// 峰值内存约为录音长度加一段。非线程安全，由调用方加锁
+class ChunkedAudioBuffer {
+private:
+    std::deque<std::vector<float>> chunks;
+    size_t chunk_samples;
+    size_t expected_samples = 0;
+    size_t total_samples = 0;
+
+    std::vector<float>& writable_chunk() {
+        if (chunks.empty() || chunks.back().size() == chunks.back().capacity()) {
+            chunks.emplace_back();
+            chunks.back().reserve(chunks.size() == 1 ? std::max(expected_samples, chunk_samples) : chunk_samples);
+        }
+        return chunks.back();
+    }
+
+public:
+    explicit ChunkedAudioBuffer(size_t chunk_size) : chunk_samples(std::max<size_t>(chunk_size, 1)) {}
+
+    // 清空并按预估长度重新预留第一段（实际分配推迟到第一次写入）
+    void reset(size_t expected) {
+        chunks.clear();
+        expected_samples = expected;
+        total_samples = 0;
+    }
+
+    size_t size() const { return total_samples; }
+    bool empty() const { return total_samples == 0; }
+
+    // 已分配的样本容量，用于统计
+    size_t capacity() const {
+        size_t capacity = 0;
+        for (const auto& chunk : chunks) capacity += chunk.capacity();
+        return capacity;
+    }
+
+    // 把num_samples个16位小端PCM样本直接转换写入段尾，必要时开新段
+    void append_pcm16le(const uint8_t* pcm_bytes, size_t num_samples) {
+        while (num_samples > 0) {
+            std::vector<float>& chunk = writable_chunk();
+            size_t offset = chunk.size();
+            size_t count = std::min(num_samples, chunk.capacity() - offset);
+            chunk.resize(offset + count);
+            audio_ingest::convert_pcm16le(pcm_bytes, count, chunk.data() + offset);
+            pcm_bytes += count * 2;
+            num_samples -= count;
+            total_samples += count;
+        }
+    }
+
+    // 丢弃最早的count个样本：整段直接释放，只有第一段的剩余部分需要移动
+    void drop_front(size_t count) {
+        count = std::min(count, total_samples);
+        total_samples -= count;
+        while (count > 0 && !chunks.empty()) {
+            std::vector<float>& front = chunks.front();
+            if (count >= front.size()) {
+                count -= front.size();
+                chunks.pop_front();
+            } else {
+                front.erase(front.begin(), front.begin() + count);
+                count = 0;
+            }
+        }
+    }
+
+    // 把全部样本追加到dst并清空缓冲区，保留最后一段的容量供后续写入（边录边处理时避免反复分配）
+    void drain_into(std::vector<float>& dst) {
+        dst.reserve(dst.size() + total_samples);
+        while (!chunks.empty()) {
+            dst.insert(dst.end(), chunks.front().begin(), chunks.front().end());
+            if (chunks.size() == 1) {
+                chunks.front().clear();
+                break;
+            }
+            chunks.pop_front();
+        }
+        total_samples = 0;
+    }
+
+    // 取出全部样本并清空缓冲区
+    std::vector<float> take() {
+        std::vector<float> samples;
+        if (chunks.size() == 1) {
+            samples.swap(chunks.front());
+        } else if (!chunks.empty()) {
+            samples.reserve(total_samples);
+            while (!chunks.empty()) {
+                samples.insert(samples.end(), chunks.front().begin(), chunks.front().end());
+                chunks.pop_front();
+            }
+        }
+        chunks.clear();
+        total_samples = 0;
+        return samples;
+    }
+};
@@ -1,12 +1,18 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <iostream>
 #include <sstream>
+#include <streambuf>
 #include <string>
-#include <chrono>
-#include <iomanip>
-#include <thread>
-#include <mutex>
+#include <string_view>
+
+// 编译期最低日志级别（0=DEBUG, 1=INFO, 2=WARN, 3=ERROR），低于该级别的LOG_*宏
+// 连同消息表达式一起被编译器消除，由CMake缓存变量ASR_LOG_MIN_LEVEL设置
+#ifndef ASR_LOG_MIN_LEVEL
+#define ASR_LOG_MIN_LEVEL 0
+#endif
 
 enum class LogLevel {
     DEBUG = 0,
@@ -15,83 +21,86 @@ enum class LogLevel {
     ERROR = 3
 };
 
+// 异步日志。调用线程先做级别判断，通过后才把消息格式化到线程本地的固定缓冲区
+// （不分配内存），记录复制进无锁环形队列后立即返回；后台线程负责时间戳、线程ID
+// 的格式化并批量写到stdout。队列满时DEBUG/INFO记录被丢弃并计数（后台线程随后输出
+// 丢弃条数），WARN/ERROR记录等待队列腾出空间。
+// 进程退出时（exit/atexit）剩余记录会被写出
 class Logger {
-private:
-    static LogLevel current_level;
-    static std::mutex log_mutex;
-    
-    static std::string get_timestamp() {
-        auto now = std::chrono::system_clock::now();
-        auto time_t = std::chrono::system_clock::to_time_t(now);
-        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now.time_since_epoch()) % 1000;
-        
-        std::stringstream ss;
-        ss << std::put_time(std::localtime(&time_t), "%Y-%m-%d %H:%M:%S");
-        ss << "." << std::setfill('0') << std::setw(3) << ms.count();
-        return ss.str();
-    }
-    
-    static std::string get_thread_id() {
-        std::stringstream ss;
-        ss << std::this_thread::get_id();
-        return ss.str();
-    }
-    
-    static std::string level_to_string(LogLevel level) {
-        switch (level) {
-            case LogLevel::DEBUG: return "DEBUG";
-            case LogLevel::INFO:  return "INFO ";
-            case LogLevel::WARN:  return "WARN ";
-            case LogLevel::ERROR: return "ERROR";
-            default: return "UNKNOWN";
+public:
+    static const size_t kMaxMessageSize = 1024;   // 超出部分截断
+
+    // 写入固定数组的streambuf，写满后丢弃剩余字符
+    class LineBuffer : public std::streambuf {
+    private:
+        char data[kMaxMessageSize];
+        bool truncated = false;
+
+    protected:
+        int_type overflow(int_type ch) override {
+            truncated = true;
+            return traits_type::not_eof(ch);
         }
-    }
-    
+
+    public:
+        LineBuffer() { reset(); }
+        void reset() {
+            setp(data, data + sizeof(data));
+            truncated = false;
+        }
+        std::string_view view() const { return std::string_view(pbase(), static_cast<size_t>(pptr() - pbase())); }
+        bool is_truncated() const { return truncated; }
+    };
+
+    // 一条日志的格式化上下文：借用当前线程的行缓冲区，析构时归还。
+    // 消息表达式中再次打日志时使用下一层缓冲区
+    class Line {
+    public:
+        struct Slot;
+
+    private:
+        Slot* slot;
+
+    public:
+        Line();
+        ~Line();
+        Line(const Line&) = delete;
+        Line& operator=(const Line&) = delete;
+
+        std::ostream& stream();
+        const LineBuffer& buffer() const;
+    };
+
+private:
+    static std::atomic<int> current_level;
+
 public:
     static void set_level(LogLevel level) {
-        current_level = level;
+        current_level.store(static_cast<int>(level), std::memory_order_relaxed);
     }
-    
-    static void log(LogLevel level, const std::string& client_id, 
-                   const std::string& file, int line, const std::string& message) {
-        if (level < current_level) return;
-        
-        std::lock_guard<std::mutex> lock(log_mutex);
-        std::cout << "[" << get_timestamp() << "] "
-                  << "[" << level_to_string(level) << "] "
-                  << "[" << get_thread_id() << "] "
-                  << "[" << client_id << "] "
-                  << "[" << file << ":" << line << "] "
-                  << message << std::endl;
+    static bool is_enabled(LogLevel level) {
+        return static_cast<int>(level) >= current_level.load(std::memory_order_relaxed);
     }
-};
 
-// Convenience macros
-#define LOG_DEBUG(client_id, msg) \
-    do { \
-        std::stringstream ss; \
-        ss << msg; \
-        Logger::log(LogLevel::DEBUG, client_id, __FILE__, __LINE__, ss.str()); \
-    } while(0)
+    // 把格式化好的一行放入队列
+    static void commit(LogLevel level, std::string_view client_id, const char* file, int line, const Line& message);
+    static void log(LogLevel level, std::string_view client_id, const char* file, int line, std::string_view message);
 
-#define LOG_INFO(client_id, msg) \
-    do { \
-        std::stringstream ss; \
-        ss << msg; \
-        Logger::log(LogLevel::INFO, client_id, __FILE__, __LINE__, ss.str()); \
-    } while(0)
+    // 阻塞到调用前提交的记录全部写出
+    static void flush();
+};
 
-#define LOG_WARN(client_id, msg) \
+#define ASR_LOG(level, client_id, msg) \
     do { \
-        std::stringstream ss; \
-        ss << msg; \
-        Logger::log(LogLevel::WARN, client_id, __FILE__, __LINE__, ss.str()); \
+        if (static_cast<int>(level) >= ASR_LOG_MIN_LEVEL && Logger::is_enabled(level)) { \
+            Logger::Line log_line_; \
+            log_line_.stream() << msg; \
+            Logger::commit(level, client_id, __FILE__, __LINE__, log_line_); \
+        } \
     } while(0)
 
-#define LOG_ERROR(client_id, msg) \
-    do { \
-        std::stringstream ss; \
-        ss << msg; \
-        Logger::log(LogLevel::ERROR, client_id, __FILE__, __LINE__, ss.str()); \
-    } while(0)
+// Convenience macros
+#define LOG_DEBUG(client_id, msg) ASR_LOG(LogLevel::DEBUG, client_id, msg)
+#define LOG_INFO(client_id, msg)  ASR_LOG(LogLevel::INFO, client_id, msg)
+#define LOG_WARN(client_id, msg)  ASR_LOG(LogLevel::WARN, client_id, msg)
+#define LOG_ERROR(client_id, msg) ASR_LOG(LogLevel::ERROR, client_id, msg)
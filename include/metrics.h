@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Prometheus文本格式的运行指标。
+// 更新全部是relaxed原子操作，抓取时只读取这些原子变量，不获取任何业务锁；
+// 各桶之间不是同一时刻的快照，抓取结果允许有一次观测的偏差
+namespace metrics {
+
+class Counter {
+private:
+    std::atomic<uint64_t> value{0};
+
+public:
+    void inc(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// 固定桶直方图，bounds为递增的桶上界（不含+Inf）
+class Histogram {
+private:
+    std::vector<double> bounds;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets;   // bounds.size() + 1个，最后一个是+Inf
+    std::atomic<double> sum{0.0};
+
+public:
+    explicit Histogram(std::vector<double> upper_bounds);
+
+    void observe(double value);
+    void observe_since(std::chrono::steady_clock::time_point start) {
+        observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+
+    friend class ExpositionWriter;
+};
+
+// 常用的桶划分（秒）
+std::vector<double> latency_buckets();
+std::vector<double> backlog_buckets();
+std::vector<double> lock_wait_buckets();
+
+// 滚动窗口占用统计：由单个采样线程按固定周期写入，任意线程无锁读取。
+// 每个槽位覆盖slot_ms毫秒，保留最近max_window_seconds秒；读取时与写入并发的槽位会被跳过
+class OccupancyWindow {
+public:
+    struct Summary {
+        double busy_fraction = 0.0;   // 窗口内busy采样的平均值
+        double average_queue = 0.0;
+        uint64_t max_queue = 0;
+        uint64_t samples = 0;
+    };
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> index{~uint64_t(0)};
+        std::atomic<uint64_t> samples{0};
+        std::atomic<uint64_t> busy_ppm{0};     // busy比例 x 1e6 之和
+        std::atomic<uint64_t> queue_sum{0};
+        std::atomic<uint64_t> queue_max{0};
+    };
+
+    const std::chrono::steady_clock::time_point origin;
+    const int slot_ms;
+    const size_t num_slots;
+    std::unique_ptr<Slot[]> slots;
+
+    uint64_t slot_index(std::chrono::steady_clock::time_point now) const;
+
+public:
+    explicit OccupancyWindow(int slot_ms = 100, int max_window_seconds = 60);
+
+    // 仅限单个写线程调用
+    void record(std::chrono::steady_clock::time_point now, double busy_fraction, uint64_t queue_length);
+    Summary summarize(std::chrono::steady_clock::time_point now, int window_seconds) const;
+};
+
+// 文本格式输出
+class ExpositionWriter {
+private:
+    std::string out;
+
+public:
+    // 每个指标族输出一次HELP/TYPE，type为counter、gauge或histogram
+    void family(const std::string& name, const std::string& help, const std::string& type);
+    // labels形如 priority="final"，为空时不带标签
+    void sample(const std::string& name, const std::string& labels, double value);
+    void histogram(const std::string& name, const std::string& labels, const Histogram& histogram);
+
+    const std::string& str() const { return out; }
+};
+
+} // namespace metrics
+
+// 全进程共享的服务指标，热点路径直接更新
+struct ServerMetrics {
+    // 解码各阶段耗时，下标为DecodeStage
+    enum DecodeStage { ACQUIRE_WAIT = 0, CREATE_STREAMS = 1, DECODE = 2, GET_RESULTS = 3, NUM_DECODE_STAGES = 4 };
+    metrics::Histogram decode_stage_seconds[NUM_DECODE_STAGES];
+    metrics::Histogram queue_lock_wait_seconds;      // 提交请求时获取解码队列锁的等待
+    metrics::Counter decode_busy_microseconds;       // 副本租借期间累计的占用时间
+    metrics::Histogram decode_batch_size;
+    metrics::Histogram decode_queue_wait_seconds[3]; // 按DecodePriority：入队到开始解码
+    metrics::Histogram partial_latency_seconds;      // 部分识别请求：入队到解码完成
+
+    // 流式会话
+    metrics::Histogram vad_to_final_seconds;         // 语音段结束判决到最终结果发送
+    metrics::Histogram session_backlog_seconds;      // 处理任务开始时会话待处理的音频时长
+
+    metrics::Counter frames_received;
+    metrics::Counter bytes_received;
+    metrics::Counter samples_dropped;
+    metrics::Counter final_samples_truncated;        // 最终识别因语音段开头已不在缓冲区而缺失的样本数
+    metrics::Counter audio_overflow_events[3];       // 按AudioOverflowPolicy：会话音频缓冲超出预算的次数
+    metrics::Counter segments_detected;
+    metrics::Counter partial_results_sent;
+    metrics::Counter final_results_sent;
+    metrics::Counter oneshot_results_sent;
+    metrics::Counter http_results_sent;
+
+    ServerMetrics();
+
+    static ServerMetrics& instance();
+
+    // 输出以上全部指标
+    void write(metrics::ExpositionWriter& writer) const;
+};
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "asr_result.h"
+#include "metrics.h"
+#include "vad_service.h"
 #include <sherpa-onnx/c-api/cxx-api.h>
 #include <memory>
 #include <mutex>
@@ -9,6 +12,11 @@
 #include <string>
 #include <vector>
 #include <chrono>
+#include <deque>
+#include <future>
+#include <functional>
+#include <thread>
+#include <unordered_map>
 
 // 前向声明
 class ServerConfig;
@@ -37,60 +45,178 @@ public:
     bool is_initialized() const;
 };
 
-// VAD池管理器 - 管理VAD实例的复用
-class VADPool {
+// ASR识别器副本池 - 持有N个OfflineRecognizer副本，提供租借/归还语义
+// share_weights开启时所有副本共享同一份模型权重（ONNX Runtime的Run是线程安全的），
+// 池只负责限制并发解码数；关闭时每个副本独立加载模型
+class RecognizerPool {
+public:
+    // 租约 - 析构时自动归还副本
+    class Lease {
+    private:
+        RecognizerPool* pool = nullptr;
+        int replica_id = -1;
+        
+    public:
+        Lease() = default;
+        Lease(RecognizerPool* p, int id) : pool(p), replica_id(id) {}
+        Lease(Lease&& other) noexcept : pool(other.pool), replica_id(other.replica_id) {
+            other.pool = nullptr;
+            other.replica_id = -1;
+        }
+        Lease& operator=(Lease&& other) noexcept;
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+        ~Lease() { reset(); }
+        
+        explicit operator bool() const { return pool != nullptr; }
+        int id() const { return replica_id; }
+        const sherpa_onnx::cxx::OfflineRecognizer* get() const;
+        const sherpa_onnx::cxx::OfflineRecognizer* operator->() const { return get(); }
+        void reset();
+    };
+    
 private:
-    std::queue<std::unique_ptr<sherpa_onnx::cxx::VoiceActivityDetector>> vad_pool;
-    std::mutex pool_mutex;
+    std::vector<std::shared_ptr<sherpa_onnx::cxx::OfflineRecognizer>> replicas;
+    std::vector<int> free_replicas;
+    mutable std::mutex pool_mutex;
     std::condition_variable pool_cv;
-    std::string model_directory;
-    float sample_rate;
-    std::atomic<size_t> total_instances{0};
-    std::atomic<size_t> available_instances{0};
-    const size_t max_instances;
-    const size_t min_instances;
-    sherpa_onnx::cxx::VadModelConfig vad_config;
+    std::chrono::milliseconds acquire_timeout{5000};
+    bool share_weights = true;
+    std::atomic<bool> initialized{false};
+    std::atomic<size_t> acquire_timeouts{0};
+    std::atomic<size_t> total_count{0};
+    std::atomic<size_t> in_use_count{0};
     
-    std::unique_ptr<sherpa_onnx::cxx::VoiceActivityDetector> create_vad_instance();
+    void release(int replica_id);
     
 public:
-    VADPool(const std::string& model_dir, const ServerConfig& config);
-    ~VADPool();
-    
-    // 获取VAD实例（如果池为空会创建新实例或等待）
-    std::unique_ptr<sherpa_onnx::cxx::VoiceActivityDetector> acquire(std::chrono::milliseconds timeout = std::chrono::milliseconds(5000));
+    RecognizerPool();
+    ~RecognizerPool();
     
-    // 归还VAD实例到池中
-    void release(std::unique_ptr<sherpa_onnx::cxx::VoiceActivityDetector> vad);
+    bool initialize(const std::string& model_dir, const ServerConfig& config);
+    bool is_initialized() const { return initialized.load(); }
     
-    // 预热池 - 预先创建最小数量的实例
-    bool initialize();
+    // 租借一个副本，超时返回空租约
+    Lease acquire(std::chrono::milliseconds timeout);
+    // 使用配置中的acquire_timeout_ms
+    Lease acquire() { return acquire(acquire_timeout); }
     
     // 获取池状态
-    size_t get_total_instances() const { return total_instances.load(); }
-    size_t get_available_instances() const { return available_instances.load(); }
-    size_t get_active_instances() const { return total_instances.load() - available_instances.load(); }
+    size_t get_total_instances() const;
+    size_t get_available_instances() const;
+    size_t get_in_use_instances() const;
+    size_t get_acquire_timeouts() const { return acquire_timeouts.load(); }
+    bool is_sharing_weights() const { return share_weights; }
+};
+
+// 识别结果 - 解码队列通过future返回给调用方
+struct RecognitionResult {
+    bool ok = false;                      // 解码是否成功
+    std::string text;
+    std::string language;
+    std::string emotion;
+    std::string event;
+    std::vector<float> timestamps;
+    std::vector<std::string> tokens;
+    bool superseded = false;              // 部分识别请求在开始解码前被同一会话的新请求取代
+    // 所在批次的解码区间与批大小，供延迟追踪使用；未进入解码时为默认值
+    std::chrono::steady_clock::time_point decode_start;
+    std::chrono::steady_clock::time_point decode_end;
+    size_t batch_size = 0;
 };
 
-// 共享ASR引擎管理器 - 管理单个ASR实例的线程安全访问
+// 将src拼接到dst之后，src的时间戳偏移offset_seconds（分段解码结果的合并）
+void append_recognition(RecognitionResult& dst, RecognitionResult&& src, float offset_seconds);
+
+// 解码优先级 - 调度器按此顺序组批：最终结果 > 一句话识别 > 部分结果
+enum class DecodePriority {
+    FINAL = 0,
+    ONESHOT = 1,
+    PARTIAL = 2
+};
+
+// 共享ASR引擎管理器 - 跨会话动态批处理解码
+// 所有会话的识别请求进入同一个队列，调度线程在批处理窗口内
+// (最多batch_size个请求或batch_timeout)收集请求并一次性批量Decode。
+// 每个识别器副本对应一个调度线程，N个批次可以并行解码。
+// 组批时按DecodePriority从高到低取请求；带coalesce_key的部分识别请求
+// 在开始解码前会被同key的新请求取代，过时的部分结果不会占用解码器
 class SharedASREngine {
+public:
+    typedef std::function<void(RecognitionResult)> ResultCallback;
+    
 private:
-    std::unique_ptr<sherpa_onnx::cxx::OfflineRecognizer> recognizer;
+    static const size_t kNumPriorities = 3;
+    
+    struct DecodeRequest {
+        const float* samples = nullptr;   // 指向owned_samples或调用方持有的数据
+        size_t sample_count = 0;
+        std::vector<float> owned_samples;
+        DecodePriority priority = DecodePriority::FINAL;
+        std::string coalesce_key;
+        std::promise<RecognitionResult> promise;
+        ResultCallback callback;          // 非空时通过回调而不是promise返回结果
+        uint32_t result_fields = RESULT_FIELDS_ALL;  // 需要从解码结果中取出的可选字段
+        std::chrono::steady_clock::time_point enqueue_time;
+        
+        void complete(RecognitionResult result);
+    };
+    
+    RecognizerPool* recognizer_pool = nullptr;
     mutable std::mutex engine_mutex;
     std::atomic<bool> initialized{false};
-    std::string model_directory;
-    float sample_rate;
+    float sample_rate = 16000;
     std::atomic<size_t> active_recognitions{0};
     
+    // 按优先级分级的批处理解码队列
+    std::deque<std::unique_ptr<DecodeRequest>> pending_requests[kNumPriorities];
+    std::unordered_map<std::string, DecodeRequest*> pending_partials;  // coalesce_key -> 排队中的请求
+    std::atomic<size_t> pending_count{0};  // 在queue_mutex下修改，原子类型供统计无锁读取
+    mutable std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    std::vector<std::thread> dispatcher_threads;
+    std::atomic<bool> running{false};
+    size_t max_batch_size = 8;
+    std::chrono::milliseconds batch_timeout{10};
+    std::atomic<size_t> total_batches{0};
+    std::atomic<size_t> total_batched_requests{0};
+    std::atomic<size_t> superseded_requests{0};
+    // 最近批次占用副本时长的指数滑动平均(微秒)，调度线程并发更新时允许丢失个别样本
+    std::atomic<uint64_t> batch_duration_ewma_us{0};
+    
+    // 解码器占用采样：采样线程每sample_interval读取一次副本占用与队列长度
+    metrics::OccupancyWindow occupancy;
+    std::thread sampler_thread;
+    static constexpr std::chrono::milliseconds sample_interval{10};
+    
+    void enqueue(std::unique_ptr<DecodeRequest> request);
+    std::chrono::steady_clock::time_point oldest_enqueue_time() const;
+    void dispatch_loop();
+    void decode_batch(std::vector<std::unique_ptr<DecodeRequest>>& batch);
+    void sample_loop();
+    void shutdown();
+    
 public:
     SharedASREngine();
     ~SharedASREngine();
     
-    bool initialize(const std::string& model_dir, const ServerConfig& config);
+    bool initialize(RecognizerPool* pool, const ServerConfig& config);
     bool is_initialized() const { return initialized.load(); }
     float get_sample_rate() const { return sample_rate; }
     
-    // 线程安全的识别接口
+    // 异步识别接口 - 调用方必须保证samples在future就绪前有效
+    std::future<RecognitionResult> submit(const float* samples, size_t sample_count,
+                                          DecodePriority priority = DecodePriority::FINAL);
+    // 异步识别接口 - 队列接管音频数据的所有权
+    std::future<RecognitionResult> submit(std::vector<float> samples,
+                                          DecodePriority priority = DecodePriority::FINAL);
+    // 回调式识别接口 - 回调在解码线程中执行；coalesce_key非空时，同key且尚未
+    // 开始解码的旧请求会以superseded结果提前完成。result_fields为ResultField位掩码
+    void submit_async(std::vector<float> samples, DecodePriority priority, 
+                      ResultCallback callback, const std::string& coalesce_key = "",
+                      uint32_t result_fields = RESULT_FIELDS_ALL);
+    
+    // 线程安全的同步识别接口（内部通过批处理队列完成）
     std::string recognize(const float* samples, size_t sample_count);
     std::string recognize_with_metadata(const float* samples, size_t sample_count, 
                                       std::string& language, std::string& emotion, 
@@ -98,13 +224,61 @@ public:
     
     // 获取统计信息
     size_t get_active_recognitions() const { return active_recognitions.load(); }
+    size_t get_queue_length() const;
+    size_t get_queue_length(DecodePriority priority) const;
+    size_t get_superseded_requests() const { return superseded_requests.load(); }
+    float get_average_batch_size() const;
+    
+    // 新请求预计的排队解码时间(秒)：排队请求按批大小分批，由所有副本并行处理，
+    // 每批耗时取最近批次的滑动平均。只读原子变量，供握手时的准入控制使用
+    double estimate_backlog_seconds() const;
+    
+    // 最近window_seconds秒（最长60秒）内识别器副本的忙碌比例与解码队列长度
+    metrics::OccupancyWindow::Summary get_occupancy(int window_seconds) const;
+};
+
+// 分段解码：各语音段作为独立请求提交，分布到多个批次/识别器副本并行解码，
+// 全部完成且不再追加新段(seal)后按顺序拼接，时间戳加上语音段起点。
+// 拼接回调在最后完成的解码线程（或调用seal的线程）上执行一次，
+// 任一段解码失败时拼接结果的ok为false，failed_segments给出失败的段数
+class SegmentedDecode : public std::enable_shared_from_this<SegmentedDecode> {
+public:
+    typedef std::function<void(RecognitionResult joined, size_t failed_segments, size_t total_segments)> JoinCallback;
+    
+private:
+    SharedASREngine* shared_asr;
+    DecodePriority priority;
+    uint32_t result_fields;
+    JoinCallback on_joined;
+    
+    mutable std::mutex mutex;
+    std::vector<RecognitionResult> results;
+    std::vector<float> offsets;             // 各段在录音中的起点(秒)
+    size_t completed = 0;
+    bool sealed = false;
+    std::atomic<bool> cancelled{false};
+    
+    void complete_segment(size_t index, RecognitionResult result);
+    void join();
+    
+public:
+    SegmentedDecode(SharedASREngine* asr, DecodePriority decode_priority, uint32_t fields, JoinCallback callback);
+    
+    // 提交一个语音段，offset_seconds为其在录音中的起点；提交失败时该段按解码失败计
+    void submit(std::vector<float> samples, float offset_seconds);
+    // 不再追加新段，此前的段已全部完成时在调用线程上拼接
+    void seal();
+    // 录音被丢弃，拼接回调不再执行
+    void cancel() { cancelled.store(true); }
+    size_t size() const;
 };
 
 // 模型池管理器 - 统一管理所有模型资源
 class ModelPoolManager {
 private:
+    std::unique_ptr<RecognizerPool> recognizer_pool;
     std::unique_ptr<SharedASREngine> asr_engine;
-    std::unique_ptr<VADPool> vad_pool;
+    std::unique_ptr<VADService> vad_service;
     mutable std::mutex stats_mutex;
     std::atomic<size_t> total_sessions{0};
     std::atomic<size_t> peak_concurrent_sessions{0};
@@ -119,8 +293,11 @@ public:
     // 获取共享ASR引擎
     SharedASREngine* get_asr_engine() { return asr_engine.get(); }
     
-    // 获取VAD池
-    VADPool* get_vad_pool() { return vad_pool.get(); }
+    // 获取ASR识别器副本池
+    RecognizerPool* get_recognizer_pool() { return recognizer_pool.get(); }
+    
+    // 获取共享VAD服务
+    VADService* get_vad_service() { return vad_service.get(); }
     
     // 会话生命周期管理
     void session_started();
@@ -132,10 +309,13 @@ public:
         size_t peak_concurrent_sessions;
         size_t current_active_sessions;
         size_t asr_active_recognitions;
-        size_t vad_total_instances;
-        size_t vad_available_instances;
-        size_t vad_active_instances;
-        float memory_efficiency_ratio; // active_instances / total_instances
+        size_t asr_total_replicas;
+        size_t asr_in_use_replicas;
+        size_t asr_queue_length;
+        float asr_average_batch_size;
+        size_t vad_active_streams;
+        bool vad_batched;
+        float vad_average_batch_size;
     };
     
     SystemStats get_system_stats() const;
@@ -148,11 +328,13 @@ private:
     std::unique_ptr<VADModelPool> vad_pool;
     std::atomic<bool> initialized{false};
     
-    // 向后兼容：保留共享ASR引擎的引用
-    std::unique_ptr<SharedASREngine> shared_asr;
+    // 向后兼容：借用ModelPoolManager的识别器副本池，不再单独加载模型
+    ModelPoolManager* pool_manager;
+    std::unordered_map<int, RecognizerPool::Lease> leases;
+    std::mutex leases_mutex;
     
 public:
-    explicit ModelManager(int asr_pool_size = 2); // 参数保留但不使用
+    explicit ModelManager(ModelPoolManager* manager);
     ~ModelManager();
     
     bool initialize(const std::string& model_dir, const ServerConfig& config);
@@ -170,9 +352,9 @@ public:
     
     // 替代PoolStats的简化统计
     struct LegacyStats {
-        size_t total_instances = 1;      // 共享ASR只有1个实例
-        size_t available_instances = 1;  // 总是可用
-        size_t in_use_instances = 0;     // 共享模式下无需跟踪
+        size_t total_instances = 0;      // ASR副本总数
+        size_t available_instances = 0;  // 空闲副本数
+        size_t in_use_instances = 0;     // 正在解码的副本数
     };
     LegacyStats get_asr_pool_stats() const;
 };
@@ -2,10 +2,14 @@
 
 #include "asr_engine.h"
 #include "asr_result.h"
+#include "audio_budget.h"
+#include "chunked_audio_buffer.h"
+#include "result_writer.h"
 #include <websocketpp/config/asio_no_tls.hpp>
 #include <websocketpp/server.hpp>
 #include <string>
 #include <vector>
+#include <cstdint>
 #include <memory>
 #include <mutex>
 #include <atomic>
@@ -14,7 +18,7 @@
 typedef websocketpp::server<websocketpp::config::asio> server;
 typedef websocketpp::connection_hdl connection_hdl;
 
-class OneShotASRSession {
+class OneShotASRSession : public std::enable_shared_from_this<OneShotASRSession> {
 private:
     ASREngine* engine;
     connection_hdl hdl;
@@ -23,9 +27,22 @@ private:
     std::atomic<bool> running;
     std::atomic<bool> recording;
     
-    // 音频缓冲区
-    std::vector<float> audio_buffer;
+    // 音频缓冲区：按start命令的duration_hint（或配置的预估时长）预留，之后分段增长；
+    // recorded_samples为本次录音收到的样本数（含被drop_oldest丢弃的），用于最大时长检查
+    ChunkedAudioBuffer audio_buffer;
     std::mutex audio_mutex;
+    size_t recorded_samples = 0;
+    size_t max_recording_samples = 0;
+    size_t expected_recording_samples = 0;
+    size_t segment_threshold_samples = 0;   // 超过该长度的录音经VAD分段并行解码，0表示不分段
+    static constexpr float chunk_duration_s = 5.0f;
+    
+    // 录音缓冲预算（按16位PCM字节计）：buffered_bytes为已申请的全局预算，在audio_mutex下维护；
+    // overflow_reported仅由I/O线程访问，一次连续溢出只通知客户端一次
+    AudioOverflowPolicy overflow_policy = AudioOverflowPolicy::REJECT;
+    size_t max_buffered_bytes = 0;
+    size_t buffered_bytes = 0;
+    bool overflow_reported = false;
     
     // 会话状态
     enum class SessionState {
@@ -40,23 +57,57 @@ private:
     std::chrono::steady_clock::time_point session_start_time;
     std::chrono::steady_clock::time_point recording_start_time;
     
+    ResultFormat result_format;
+    ResultWriter result_writer;
+    
+    // 边录边解码：录音期间在工作线程上把新音频送入VAD，结束的语音段立即提交解码，
+    // stop后只需结束最后一段。分段器的创建、送入音频和销毁都在工作线程上进行；
+    // vad_mutex保护分段器和当前录音的分段解码（先于audio_mutex加锁），I/O线程不获取它：
+    // start或放弃录音时只递增live_generation，属于旧录音的分段器由工作线程销毁
+    bool decode_while_recording = false;
+    std::unique_ptr<VADSegmenter> segmenter;
+    std::shared_ptr<SegmentedDecode> live_decode;
+    uint64_t segmenter_generation = 0;      // segmenter所属的录音
+    uint64_t processed_generation = 0;      // 已开始识别的录音，不再为其创建分段器
+    std::vector<float> vad_pending;
+    std::mutex vad_mutex;
+    std::atomic<uint64_t> live_generation{0};
+    std::atomic<bool> live_vad{false};
+    std::atomic<bool> vad_scheduled{false};
+    
 public:
-    OneShotASRSession(ASREngine* eng, connection_hdl h, server* srv, const std::string& id);
+    OneShotASRSession(ASREngine* eng, connection_hdl h, server* srv, const std::string& id,
+                      const ResultFormat& format = ResultFormat());
     ~OneShotASRSession();
     
     void start();
     void stop();
     void handle_message(const std::string& message);
-    void add_audio_data(const std::vector<uint8_t>& pcm_bytes);
+    void add_audio_data(const uint8_t* pcm_bytes, size_t num_bytes);
     
     std::string get_client_id() const;
     bool is_running() const;
     bool is_recording() const;
 
 private:
-    void start_recording();
+    void start_recording(size_t expected_samples);
+    void release_buffered_audio();
+    void handle_overflow(AudioOverflowPolicy action, size_t dropped, const char* reason);
     void stop_recording_and_process();
-    void process_complete_audio();
+    void process_complete_audio(uint64_t generation);
+    // 整段识别与边录边解码共用的拼接回调：任一语音段失败时发送错误
+    SegmentedDecode::JoinCallback make_join_callback();
+    void on_segments_joined(RecognitionResult joined, size_t failed_segments, size_t total_segments);
+    
+    // 边录边解码
+    void setup_live_decode(uint64_t generation);
+    void schedule_vad();
+    void feed_vad_locked();                 // 需持有vad_mutex
+    void submit_finished_segments_locked(); // 需持有vad_mutex
+    void release_stale_decode_locked();     // 需持有vad_mutex
+    std::shared_ptr<SegmentedDecode> finish_live_decode_locked();  // 需持有vad_mutex
+    void discard_live_decode();
+    void on_recognition_complete(RecognitionResult result);
     void send_result(const ASRResult& result);
     void send_error(const std::string& error_message);
     void send_status(const std::string& status);
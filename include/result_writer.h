@@ -0,0 +1,49 @@
+#pragma once
+
+#include "asr_result.h"
+#include <cstdint>
+#include <string>
+
+// 连接建立时协商的结果格式
+struct ResultFormat {
+    bool binary = false;        // 结果以二进制帧发送（控制消息仍为JSON文本帧）
+    uint32_t fields = RESULT_FIELDS_ALL;  // ResultField位掩码，由URI参数fields指定
+};
+
+// 解析逗号分隔的字段列表（如"text,timestamps"），text/finished/idx总是包含，
+// "all"表示全部字段。无法识别的名称追加到unknown（逗号分隔）
+uint32_t parse_result_fields(const std::string& list, std::string* unknown = nullptr);
+
+// 识别结果序列化：直接写入可复用的缓冲区，不经过Json::Value树。
+// JSON为紧凑格式，字段名、类型和键顺序与ASRResult::to_json()经jsoncpp输出的结果一致，
+// 时间戳为float的最短往返形式（数值转换为float后与jsoncpp输出相同）；
+// 二进制格式供高频客户端使用，连接时通过WebSocket子协议kBinarySubprotocol协商，
+// 布局见README“二进制结果帧”。返回的引用在下一次write之前有效
+class ResultWriter {
+public:
+    static constexpr const char* kBinarySubprotocol = "asr.binary.v1";
+    static const uint8_t kBinaryVersion = 1;
+
+    // 二进制帧flags
+    enum BinaryFlags : uint8_t {
+        FLAG_FINISHED = 1 << 0,
+        FLAG_ONESHOT = 1 << 1       // OneShot结果，对应JSON中的"type":"result"
+    };
+
+    ResultWriter() { buffer.reserve(512); }
+
+    // 只写出fields中的可选字段；type非空时附加"type"字段（OneShot结果）
+    const std::string& write_json(const ASRResult& result, uint32_t fields = RESULT_FIELDS_ALL,
+                                  const char* type = nullptr);
+    // 二进制布局固定，未请求的字段写为空
+    const std::string& write_binary(const ASRResult& result, uint8_t extra_flags = 0);
+
+private:
+    std::string buffer;
+
+    void append_json_string(const std::string& value);
+    void append_json_float(float value);
+    void append_u16(uint16_t value);
+    void append_u32(uint32_t value);
+    void append_short_string(const std::string& value);
+};
@@ -14,9 +14,12 @@ enum class RunEnvironment {
 class ServerConfig {
 public:
     struct ASRConfig {
-        int pool_size = 2;                    // ASR模型池大小
+        int pool_size = 2;                    // ASR识别器副本数（可并行解码的批次数）
+        bool share_weights = true;            // 副本间共享模型权重
         int num_threads = 2;                  // ASR线程数
         int acquire_timeout_ms = 5000;        // 获取ASR实例超时时间(ms)
+        int batch_size = 8;                   // 批处理解码最大流数
+        int batch_timeout_ms = 10;            // 批处理收集窗口(ms)
         std::string model_name = "sherpa-onnx-sense-voice-zh-en-ja-ko-yue-2024-07-17";
         bool use_itn = true;                  // 是否使用ITN(逆文本归一化)
         std::string language = "auto";        // 语言设置
@@ -30,42 +33,76 @@ public:
         float max_speech_duration = 8.0f;    // 最大语音时长(秒)
         float sample_rate = 16000.0f;         // 采样率
         int window_size = 100;                // VAD窗口大小
+        bool batched = true;                  // 共享silero模型，多个会话的窗口合并推理
+        int max_batch_size = 128;             // 每轮批量推理的最大窗口数
+        int num_threads = 1;                  // VAD推理线程数
         bool debug = false;                   // 调试模式
     };
     
-    struct VADPoolConfig {
-        size_t min_pool_size = 2;             // VAD池最小大小
-        size_t max_pool_size = 10;            // VAD池最大大小
-        int acquire_timeout_ms = 5000;        // 获取VAD实例超时时间(ms)
-    };
-    
     struct ServerSettings {
         int port = 8000;                      // 服务器端口
         std::string models_root = "./assets"; // 模型根目录
         std::string log_level = "INFO";       // 日志级别
-        int max_connections = 100;            // 最大连接数
+        int max_connections = 100;            // 最大连接数，超出时握手以503拒绝
+        int max_decode_backlog_ms = 0;        // 预估解码积压超过该值时拒绝新连接(0表示不限制)
         int connection_timeout_s = 300;       // 连接超时时间(秒)
+        int worker_threads = 0;               // 工作线程数(0表示使用CPU核数)
+        int io_threads = 1;                   // WebSocket I/O线程数
+    };
+    
+    struct StreamingConfig {
+        bool incremental_partial = true;      // 增量部分识别（缓存已稳定前缀，只解码尾部）
+        float partial_window_s = 3.0f;        // 部分识别单次解码的最大尾部时长(秒)
+    };
+    
+    struct OneShotConfig {
+        float max_duration_s = 120.0f;        // 单次录音的最大时长(秒)，超出时返回错误
+        float expected_duration_s = 10.0f;    // start命令未给出duration_hint时预留的录音时长(秒)
+        float segment_threshold_s = 20.0f;    // 超过该时长的录音先经VAD分段再并行解码(秒，0表示不分段)
+        bool decode_while_recording = false;  // 录音期间对新音频做VAD并立即解码结束的语音段
     };
     
     struct PerformanceConfig {
         bool enable_memory_optimization = true;  // 启用内存优化
-        size_t max_audio_buffer_size = 1024 * 1024; // 最大音频缓冲区大小(字节)
+        size_t max_audio_buffer_size = 4 * 1024 * 1024;  // 每个会话缓冲的音频上限(字节，按16位PCM计)
+        size_t max_total_audio_buffer_size = 256 * 1024 * 1024;  // 所有会话合计的音频缓冲上限(字节，0表示不限制)
+        std::string audio_overflow_policy = "reject";  // 超出上限时：drop_oldest、reject或close
         int gc_interval_s = 60;               // 垃圾回收间隔(秒)
         bool enable_performance_logging = false; // 启用性能日志
     };
+    
+    struct TracingConfig {
+        bool enabled = false;                 // 记录单句延迟追踪事件
+        int buffer_events = 262144;           // 内存环形缓冲区可容纳的事件数
+        std::string output_prefix = "./asr_trace"; // SIGUSR1导出文件前缀，实际文件名追加时间戳
+    };
+    
+    // 离线批量转写：input非空时不启动WebSocket服务器，转写完成后退出
+    struct TranscribeConfig {
+        std::string input;                    // WAV文件、目录（递归查找*.wav）或每行一个路径的列表文件
+        std::string output = "transcripts.jsonl"; // 结果文件，每个音频文件一行JSON
+        int jobs = 0;                         // 同时处理的文件数(0表示ASR批大小×副本数×2)
+        bool resume = false;                  // 跳过输出文件中已有结果的文件并追加写入
+    };
 
 private:
     ASRConfig asr_config_;
     VADConfig vad_config_;
-    VADPoolConfig vad_pool_config_;
     ServerSettings server_settings_;
+    StreamingConfig streaming_config_;
+    OneShotConfig oneshot_config_;
     PerformanceConfig performance_config_;
+    TracingConfig tracing_config_;
+    TranscribeConfig transcribe_config_;
     
     RunEnvironment run_env_ = RunEnvironment::AUTO;
 
     // 从环境变量读取整数值
     int get_env_int(const char* name, int default_value) const;
     
+    // 从环境变量读取非负大小（字节数），超出int范围的值同样有效，负数按无效处理
+    size_t get_env_size(const char* name, size_t default_value) const;
+    
     // 从环境变量读取浮点数值
     float get_env_float(const char* name, float default_value) const;
     
@@ -93,16 +130,22 @@ public:
     // 访问器
     const ASRConfig& get_asr_config() const { return asr_config_; }
     const VADConfig& get_vad_config() const { return vad_config_; }
-    const VADPoolConfig& get_vad_pool_config() const { return vad_pool_config_; }
     const ServerSettings& get_server_settings() const { return server_settings_; }
+    const StreamingConfig& get_streaming_config() const { return streaming_config_; }
+    const OneShotConfig& get_oneshot_config() const { return oneshot_config_; }
     const PerformanceConfig& get_performance_config() const { return performance_config_; }
+    const TracingConfig& get_tracing_config() const { return tracing_config_; }
+    const TranscribeConfig& get_transcribe_config() const { return transcribe_config_; }
     
     // 修改器（用于命令行参数覆盖）
     ASRConfig& get_asr_config() { return asr_config_; }
     VADConfig& get_vad_config() { return vad_config_; }
-    VADPoolConfig& get_vad_pool_config() { return vad_pool_config_; }
     ServerSettings& get_server_settings() { return server_settings_; }
+    StreamingConfig& get_streaming_config() { return streaming_config_; }
+    OneShotConfig& get_oneshot_config() { return oneshot_config_; }
     PerformanceConfig& get_performance_config() { return performance_config_; }
+    TracingConfig& get_tracing_config() { return tracing_config_; }
+    TranscribeConfig& get_transcribe_config() { return transcribe_config_; }
     
     // 静态方法：打印帮助信息
     static void print_usage(const char* program_name);
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// 单句延迟追踪：按会话记录带时间戳的事件，保存在固定大小的内存环形缓冲区中，
+// 按需（GET /trace）或收到SIGUSR1时导出为Chrome trace JSON（chrome://tracing、Perfetto可直接打开）。
+// 每个会话对应一个轨道（trace中的一个进程），会话内按Lane分成几条线程行。
+// 未开启追踪时会话拿到的轨道号为0，所有记录函数在入口处直接返回
+namespace tracing {
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+// 会话内的行
+enum class Lane : uint8_t {
+    IO = 1,           // on_message收到音频帧
+    PROCESSING = 2,   // 工作线程上的VAD、语音段处理与结果发送
+    DECODE = 3        // 解码排队与批量解码，同一会话可能有多个请求重叠，导出为异步事件
+};
+
+class Tracer {
+private:
+    // 环形缓冲区的一个槽位，seq为奇数表示正在写入，读者据此丢弃被并发覆盖的事件
+    struct Event {
+        std::atomic<uint64_t> seq{0};
+        std::atomic<const char*> name{nullptr};   // 只接受字符串字面量
+        std::atomic<uint64_t> ts_us{0};
+        std::atomic<uint64_t> dur_us{0};
+        std::atomic<uint32_t> track{0};
+        std::atomic<uint8_t> lane{0};
+        std::atomic<char> phase{0};               // 'X'区间、'i'瞬时
+        std::atomic<int64_t> arg{0};
+    };
+
+    // 轨道名称：只保留最近kMaxTrackNames个会话的名称，名称被覆盖的轨道导出时只显示编号
+    static const size_t kMaxTrackNames = 4096;
+    struct TrackName {
+        uint32_t track = 0;
+        std::string name;
+    };
+
+    std::atomic<bool> enabled{false};
+    TimePoint origin;
+    size_t capacity = 0;
+    std::unique_ptr<Event[]> events;
+    std::atomic<uint64_t> head{0};
+    std::atomic<uint32_t> next_track{1};
+    std::unique_ptr<TrackName[]> track_names;
+    std::mutex track_names_mutex;
+
+    // SIGUSR1导出：信号处理函数只设置标志，由导出线程写文件
+    std::string output_path;
+    std::atomic<bool> dump_requested{false};
+    std::atomic<bool> running{false};
+    std::thread dump_thread;
+
+    Tracer() = default;
+    void record(uint32_t track, Lane lane, char phase, const char* name,
+                TimePoint start, TimePoint end, int64_t arg);
+    void dump_loop();
+
+public:
+    ~Tracer();
+
+    static Tracer& instance();
+
+    // 开启追踪，buffer_events为环形缓冲区可容纳的事件数
+    void start(size_t buffer_events, const std::string& path);
+    void stop();
+    bool is_enabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // 为会话分配轨道，未开启追踪时返回0
+    uint32_t register_track(const std::string& name);
+
+    void instant(uint32_t track, Lane lane, const char* name, int64_t arg = 0) {
+        if (track == 0) return;
+        TimePoint now = std::chrono::steady_clock::now();
+        record(track, lane, 'i', name, now, now, arg);
+    }
+    void span(uint32_t track, Lane lane, const char* name, TimePoint start, TimePoint end, int64_t arg = 0) {
+        if (track == 0) return;
+        record(track, lane, 'X', name, start, end, arg);
+    }
+
+    // 导出缓冲区中仍保留的全部事件
+    std::string to_chrome_json();
+    bool write_file(const std::string& path);
+
+    // 异步信号安全：只设置标志
+    void request_dump() { dump_requested.store(true, std::memory_order_relaxed); }
+};
+
+// 作用域区间：构造时记下开始时间，析构时记录
+class ScopedSpan {
+private:
+    uint32_t track;
+    Lane lane;
+    const char* name;
+    TimePoint start;
+
+public:
+    ScopedSpan(uint32_t t, Lane l, const char* n) : track(t), lane(l), name(n) {
+        if (track != 0) start = std::chrono::steady_clock::now();
+    }
+    ~ScopedSpan() {
+        if (track != 0) Tracer::instance().span(track, lane, name, start, std::chrono::steady_clock::now(), arg);
+    }
+    ScopedSpan(const ScopedSpan&) = delete;
+    ScopedSpan& operator=(const ScopedSpan&) = delete;
+
+    int64_t arg = 0;
+};
+
+} // namespace tracing
@@ -0,0 +1,135 @@
+#pragma once
+
+#include "audio_ring_buffer.h"
+#include <sherpa-onnx/c-api/cxx-api.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstdint>
+
+// 前向声明
+class ServerConfig;
+
+// 已结束的语音段，[begin, end)为音频源中的绝对样本位置
+struct VADSegment {
+    uint64_t begin = 0;
+    uint64_t end = 0;
+};
+
+// 单个会话的VAD流。音频由会话的环形缓冲区提供，流只保存推理状态和分段结果。
+// 会话通过advance_to告知可读的音频终点；[get_processed_samples() - 上下文, end)
+// 范围内的音频在判决完成前必须保持未释放
+class VADStream {
+public:
+    virtual ~VADStream() = default;
+
+    // 音频源中[0, end)已可读，按窗口送入VAD（批处理实现中异步判决）
+    virtual void advance_to(uint64_t end) = 0;
+
+    // 已完成判决的样本数
+    virtual uint64_t get_processed_samples() const = 0;
+
+    // 最近一个窗口是否处于语音中
+    virtual bool is_detected() const = 0;
+
+    // 取出一个已结束的语音段
+    virtual bool pop_segment(VADSegment& segment) = 0;
+};
+
+// 独立的VAD分段器：样本直接送入（不经过环形缓冲区），在调用线程上推理，供一句话识别分段。
+// 位置相对送入的第一个样本；非线程安全
+class VADSegmenter {
+public:
+    virtual ~VADSegmenter() = default;
+
+    // 送入后续样本
+    virtual void accept(const float* samples, size_t count) = 0;
+
+    // 输入结束，未结束的语音段作为最后一段输出
+    virtual void flush() = 0;
+
+    // 取出一个已结束的语音段，samples非空时移出该段的样本
+    virtual bool pop_segment(VADSegment& segment, std::vector<float>* samples = nullptr) = 0;
+};
+
+// VAD服务 - 所有会话共享。
+// 批处理模式下silero模型只加载一次，每个流只保留循环状态，调度线程每轮把
+// 各流的待判决窗口拼成一个batch推理；模型加载失败或编译时没有ONNX Runtime
+// 时回退为每个流独立的sherpa-onnx VoiceActivityDetector。两种模式都没有实例数上限。
+// 分段器同样共用批处理模型（只保存自己的循环状态）；回退模式下分段器从空闲池借用
+// sherpa-onnx VAD，用完Reset后归还，模型只在池为空时加载
+class VADService {
+public:
+    // 判决状态变化（检测到语音、语音结束）时在调度线程上调用
+    typedef std::function<void()> EventCallback;
+
+private:
+    struct StreamState;
+    class BatchedStream;
+    class SherpaStream;
+    class SileroBatchModel;
+    class BatchedSegmenter;
+    class SherpaSegmenter;
+
+    sherpa_onnx::cxx::VadModelConfig sherpa_config;
+    float sherpa_buffer_seconds = 30.0f;
+    int sample_rate = 16000;
+    int window_size = 512;
+    size_t max_batch_size = 128;
+
+    // 批处理模式
+    std::unique_ptr<SileroBatchModel> batch_model;
+    std::deque<std::shared_ptr<StreamState>> pending_streams;
+    std::mutex pending_mutex;
+    std::condition_variable pending_cv;
+    std::thread dispatcher;
+    bool stopping = false;
+
+    // 统计
+    std::atomic<size_t> active_streams{0};
+    std::atomic<size_t> total_batches{0};
+    std::atomic<size_t> total_windows{0};
+    std::atomic<bool> initialized{false};
+
+    // 回退模式下分段器的空闲sherpa-onnx VAD
+    std::vector<sherpa_onnx::cxx::VoiceActivityDetector> idle_detectors;
+    std::mutex detectors_mutex;
+
+    void enqueue(std::shared_ptr<StreamState> state);
+    void dispatcher_loop();
+    void run_batch(std::vector<std::shared_ptr<StreamState>>& batch);
+
+public:
+    VADService();
+    ~VADService();
+
+    VADService(const VADService&) = delete;
+    VADService& operator=(const VADService&) = delete;
+
+    bool initialize(const std::string& model_dir, const ServerConfig& config);
+    void shutdown();
+
+    // 为会话创建VAD流，source在流销毁前必须有效
+    std::unique_ptr<VADStream> create_stream(const AudioRingBuffer* source, EventCallback on_event);
+
+    // 创建独立的分段器，失败时返回nullptr。keep_samples为false时pop_segment不输出样本
+    // （只需要位置的调用方不必保留音频）；回退模式下池为空时会加载模型
+    std::unique_ptr<VADSegmenter> create_segmenter(bool keep_samples = true);
+
+    // 对一段完整录音做离线分段：在调用线程上运行一个独立的分段器，
+    // 语音段按时间顺序追加到segments（位置相对samples起点），单段不超过最大语音时长
+    bool segment_offline(const float* samples, size_t count, std::vector<VADSegment>& segments);
+
+    // 状态查询
+    bool is_initialized() const { return initialized.load(); }
+    bool is_batched() const { return batch_model != nullptr; }
+    int get_window_size() const { return window_size; }
+    size_t get_active_streams() const { return active_streams.load(); }
+    float get_average_batch_size() const;
+};
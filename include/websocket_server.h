@@ -10,8 +10,10 @@
 #include <memory>
 #include <unordered_map>
 #include <mutex>
+#include <shared_mutex>
 #include <atomic>
 #include <thread>
+#include <vector>
 
 // 前向声明
 class ServerConfig;
@@ -23,17 +25,32 @@ typedef websocketpp::connection_hdl connection_hdl;
 class WebSocketASRServer {
 private:
     server ws_server;
+    // 处理中的POST /transcribe请求数，计入连接数上限。解码回调持有的请求可能在asr_engine
+    // 析构、清空队列时才释放，必须声明在asr_engine之前以晚于它销毁
+    std::atomic<size_t> http_in_flight{0};
     ASREngine asr_engine;
     ConnectionManager connection_manager;
-    std::unordered_map<std::string, std::unique_ptr<ASRSession>> sessions;
-    std::unordered_map<std::string, std::unique_ptr<OneShotASRSession>> oneshot_sessions;
-    std::mutex sessions_mutex;
-    std::mutex oneshot_sessions_mutex;
+    std::unordered_map<std::string, std::shared_ptr<ASRSession>> sessions;
+    std::unordered_map<std::string, std::shared_ptr<OneShotASRSession>> oneshot_sessions;
+    // 多个I/O线程并发查找会话，写入只发生在连接建立/关闭时
+    std::shared_mutex sessions_mutex;
+    std::shared_mutex oneshot_sessions_mutex;
     std::unique_ptr<ServerConfig> config_;
     std::atomic<size_t> total_connections{0};
     std::atomic<size_t> active_sessions{0};
     std::atomic<size_t> active_oneshot_sessions{0};
     
+    // 准入控制：握手阶段因连接数上限或解码积压被拒绝的连接数
+    std::atomic<size_t> rejected_connection_limit{0};
+    std::atomic<size_t> rejected_decode_backlog{0};
+    // POST /transcribe被拒绝的请求数，另含全局音频预算不足
+    std::atomic<size_t> http_rejected_connection_limit{0};
+    std::atomic<size_t> http_rejected_decode_backlog{0};
+    std::atomic<size_t> http_rejected_audio_budget{0};
+    
+    // I/O线程：多个线程运行同一个io_service，websocketpp为每个连接使用strand保证顺序
+    std::vector<std::thread> io_threads;
+    
     // Performance monitoring
     std::thread monitor_thread;
     std::atomic<bool> monitoring{false};
@@ -54,8 +71,27 @@ private:
     void on_open(connection_hdl hdl);
     void on_close(connection_hdl hdl);
     void on_message(connection_hdl hdl, message_ptr msg);
+    void bind_message_handler(connection_hdl hdl, server::message_handler handler);
+    void handle_streaming_message(ASRSession& session, const std::string& client_id, message_ptr msg);
+    void handle_oneshot_message(OneShotASRSession& session, const std::string& client_id, message_ptr msg);
+    void on_http(connection_hdl hdl);
+    bool on_validate(connection_hdl hdl);
+    
+    // 连接数（含处理中的HTTP请求）或预估解码积压超限时设置503响应并返回false，
+    // http_request区分拒绝计入的指标
+    bool admit_connection(server::connection_ptr con, bool http_request);
+    
+    // POST /transcribe：请求体为WAV或16位PCM，响应推迟到解码完成后发送
+    void handle_transcribe(connection_hdl hdl, server::connection_ptr con);
+    
+    // Prometheus文本格式的指标，只读取原子计数
+    std::string render_metrics();
+    
+    std::shared_ptr<ASRSession> find_session(const std::string& client_id);
+    std::shared_ptr<OneShotASRSession> find_oneshot_session(const std::string& client_id);
     
     // Helper methods to determine session type based on URI
     bool is_oneshot_endpoint(connection_hdl hdl);
     std::string get_endpoint_path(connection_hdl hdl);
+    ResultFormat get_result_format(connection_hdl hdl);
 };
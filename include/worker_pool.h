@@ -0,0 +1,45 @@
+#pragma once
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+// 固定大小的工作线程池 - 承载不应在WebSocket I/O线程上执行的任务
+class WorkerPool {
+public:
+    typedef std::function<void()> Task;
+    
+private:
+    std::vector<std::thread> threads;
+    std::deque<Task> tasks;
+    mutable std::mutex tasks_mutex;
+    std::condition_variable tasks_cv;
+    bool stopping = false;
+    std::atomic<size_t> queued_tasks{0};      // tasks.size()的无锁副本，供统计读取
+    std::atomic<size_t> completed_tasks{0};
+    
+    void worker_loop();
+    
+public:
+    // num_threads为0时使用硬件并发数
+    explicit WorkerPool(size_t num_threads = 0);
+    ~WorkerPool();
+    
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+    
+    // 提交任务，池关闭后提交的任务被丢弃
+    void post(Task task);
+    
+    // 停止接收新任务，执行完已排队的任务后退出所有线程
+    void shutdown();
+    
+    // 获取池状态
+    size_t get_thread_count() const { return threads.size(); }
+    size_t get_queue_length() const { return queued_tasks.load(std::memory_order_relaxed); }
+    size_t get_completed_tasks() const { return completed_tasks.load(); }
+};
@@ -1,6 +1,8 @@
 #include "websocket_server.h"
+#include "batch_transcriber.h"
 #include "server_config.h"
 #include "logger.h"
+#include "trace.h"
 #include <iostream>
 #include <string>
 #include <signal.h>
@@ -18,6 +20,11 @@ void signal_handler(int sig) {
     exit(0);
 }
 
+// SIGUSR1：导出延迟追踪，实际写文件由追踪导出线程完成
+void trace_dump_handler(int) {
+    tracing::Tracer::instance().request_dump();
+}
+
 int main(int argc, char* argv[]) {
     // 创建配置管理器
     ServerConfig config;
@@ -47,11 +54,33 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
-    LOG_INFO("SERVER", "Starting WebSocket ASR Server...");
-    
     // 打印当前配置
     config.print_config();
     
+    const auto& tracing_config = config.get_tracing_config();
+    if (tracing_config.enabled) {
+        tracing::Tracer::instance().start(static_cast<size_t>(tracing_config.buffer_events), 
+                                          tracing_config.output_prefix);
+        signal(SIGUSR1, trace_dump_handler);
+    }
+    
+    // 离线批量转写：不启动WebSocket服务器，转写完成后退出
+    if (!config.get_transcribe_config().input.empty()) {
+        try {
+            BatchTranscriber transcriber(config);
+            if (!transcriber.initialize()) {
+                LOG_ERROR("TRANSCRIBE", "Failed to initialize batch transcriber");
+                return 1;
+            }
+            return transcriber.run();
+        } catch (const exception& e) {
+            LOG_ERROR("TRANSCRIBE", "Transcription error: " << e.what());
+            return 1;
+        }
+    }
+    
+    LOG_INFO("SERVER", "Starting WebSocket ASR Server...");
+    
     try {
         WebSocketASRServer server(config);
         g_server = &server;
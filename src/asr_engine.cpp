@@ -1,11 +1,24 @@
 #include "asr_engine.h"
 #include "server_config.h"
 #include "logger.h"
+#include <algorithm>
 #include <exception>
+#include <stdexcept>
 
 ASREngine::ASREngine() : initialized(false) {}
 
-ASREngine::~ASREngine() {}
+ASREngine::~ASREngine() {
+    // 先停止VAD调度线程，它的回调会向工作线程池投递任务
+    if (pool_manager && pool_manager->get_vad_service()) {
+        pool_manager->get_vad_service()->shutdown();
+    }
+    // 再停止工作线程，避免任务访问已销毁的模型
+    if (worker_pool) {
+        worker_pool->shutdown();
+    }
+    // ModelManager持有的租约必须在识别器副本池销毁前归还
+    model_manager.reset();
+}
 
 bool ASREngine::initialize(const std::string& model_dir, const ServerConfig& config) {
     if (initialized.load()) {
@@ -14,6 +27,8 @@ bool ASREngine::initialize(const std::string& model_dir, const ServerConfig& con
     }
     
     try {
+        this->config = std::make_unique<ServerConfig>(config);
+        
         // 使用新的ModelPoolManager而不是旧的ModelManager
         pool_manager = std::make_unique<ModelPoolManager>();
         
@@ -22,16 +37,19 @@ bool ASREngine::initialize(const std::string& model_dir, const ServerConfig& con
             return false;
         }
         
-        // 保留向后兼容性，仍然创建ModelManager以供旧代码使用
-        const auto& asr_config = config.get_asr_config();
-        model_manager = std::make_unique<ModelManager>(asr_config.pool_size);
+        // 保留向后兼容性，ModelManager复用pool_manager的识别器副本
+        model_manager = std::make_unique<ModelManager>(pool_manager.get());
         if (!model_manager->initialize(model_dir, config)) {
             LOG_ERROR("ENGINE", "Failed to initialize legacy model manager");
             return false;
         }
         
+        worker_pool = std::make_unique<WorkerPool>(
+            static_cast<size_t>(config.get_server_settings().worker_threads));
+        
         initialized = true;
-        LOG_INFO("ENGINE", "ASR engine initialized with shared ASR model and dynamic VAD pool");
+        LOG_INFO("ENGINE", "ASR engine initialized with " 
+                 << config.get_asr_config().pool_size << " ASR replicas and shared VAD service");
         return true;
         
     } catch (const std::exception& e) {
@@ -51,29 +69,18 @@ float ASREngine::get_sample_rate() const {
     return model_manager->get_sample_rate();
 }
 
-std::unique_ptr<sherpa_onnx::cxx::VoiceActivityDetector> ASREngine::create_vad() const {
-    if (!initialized.load()) {
-        LOG_ERROR("ENGINE", "ASR engine not initialized");
+const ServerConfig& ASREngine::get_config() const {
+    return *config;
+}
+
+std::unique_ptr<VADStream> ASREngine::create_vad_stream(const AudioRingBuffer* source, 
+                                                       VADService::EventCallback on_event) const {
+    VADService* vad_service = get_vad_service();
+    if (!vad_service) {
+        LOG_ERROR("ENGINE", "VAD service not available");
         return nullptr;
     }
-    
-    // 优先使用新的pool_manager
-    if (pool_manager) {
-        auto vad = pool_manager->get_vad_pool()->acquire(std::chrono::milliseconds(3000));
-        if (!vad) {
-            LOG_WARN("ENGINE", "Failed to acquire VAD from pool, falling back to legacy creation");
-        } else {
-            return vad;
-        }
-    }
-    
-    // 向后兼容：使用旧的model_manager
-    if (model_manager) {
-        return model_manager->create_vad_instance();
-    }
-    
-    LOG_ERROR("ENGINE", "No VAD creation method available");
-    return nullptr;
+    return vad_service->create_stream(source, std::move(on_event));
 }
 
 // 新增方法：获取共享ASR引擎
@@ -84,19 +91,69 @@ SharedASREngine* ASREngine::get_shared_asr() const {
     return pool_manager->get_asr_engine();
 }
 
-// 新增方法：获取VAD池
-VADPool* ASREngine::get_vad_pool() const {
+// 获取共享VAD服务
+VADService* ASREngine::get_vad_service() const {
     if (!initialized.load() || !pool_manager) {
         return nullptr;
     }
-    return pool_manager->get_vad_pool();
+    return pool_manager->get_vad_service();
+}
+
+bool ASREngine::decode_recording(std::vector<float> samples, size_t segment_threshold_samples, uint32_t result_fields,
+                                 SegmentedDecode::JoinCallback on_complete, const std::string& log_id) const {
+    SharedASREngine* shared_asr = get_shared_asr();
+    if (!shared_asr || !shared_asr->is_initialized()) {
+        throw std::runtime_error("Shared ASR engine not available");
+    }
+    
+    // 长录音先用VAD切分，各语音段分布到多个批次/识别器副本并行解码，
+    // 避免单个超长请求独占一个识别器并按录音长度分配解码内存
+    VADService* vad_service = get_vad_service();
+    if (segment_threshold_samples > 0 && samples.size() > segment_threshold_samples && vad_service) {
+        std::vector<VADSegment> segments;
+        if (vad_service->segment_offline(samples.data(), samples.size(), segments)) {
+            if (segments.empty()) {
+                LOG_INFO(log_id, "No speech detected in " << samples.size() << " samples");
+                return false;
+            }
+            if (segments.size() > 1) {
+                const float sample_rate = get_sample_rate();
+                LOG_INFO(log_id, "Decoding " << samples.size() << " samples as " << segments.size() << " speech segments");
+                
+                auto decode = std::make_shared<SegmentedDecode>(shared_asr, DecodePriority::ONESHOT, 
+                                                                result_fields, std::move(on_complete));
+                for (const auto& segment : segments) {
+                    size_t begin = std::min<size_t>(segment.begin, samples.size());
+                    size_t end = std::min<size_t>(segment.end, samples.size());
+                    decode->submit(std::vector<float>(samples.begin() + begin, samples.begin() + end),
+                                   segment.begin / sample_rate);
+                }
+                decode->seal();
+                return true;
+            }
+        } else {
+            LOG_WARN(log_id, "VAD segmentation failed, decoding recording as a whole");
+        }
+    }
+    
+    // 整段提交，结果在解码线程中回调
+    shared_asr->submit_async(std::move(samples), DecodePriority::ONESHOT,
+        [on_complete = std::move(on_complete)](RecognitionResult result) {
+            size_t failed = result.ok ? 0 : 1;
+            on_complete(std::move(result), failed, 1);
+        }, "", result_fields);
+    return true;
+}
+
+WorkerPool* ASREngine::get_worker_pool() const {
+    return worker_pool.get();
 }
 
-// 新增方法：释放VAD实例
-void ASREngine::release_vad(std::unique_ptr<sherpa_onnx::cxx::VoiceActivityDetector> vad) const {
-    if (pool_manager) {
-        pool_manager->get_vad_pool()->release(std::move(vad));
+ModelPoolManager::SystemStats ASREngine::get_system_stats() const {
+    if (!pool_manager) {
+        return ModelPoolManager::SystemStats{};
     }
+    return pool_manager->get_system_stats();
 }
 
 ModelManager* ASREngine::get_model_manager() const {
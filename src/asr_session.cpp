@@ -1,21 +1,44 @@
 #include "asr_session.h"
+#include "audio_ingest.h"
+#include "server_config.h"
 #include "logger.h"
-#include <json/json.h>
+#include "metrics.h"
 #include <cstdint>
+#include <limits>
+#include <algorithm>
 
 using namespace sherpa_onnx::cxx;
 
-ASRSession::ASRSession(ASREngine* eng, connection_hdl h, server* srv, const std::string& id) 
+ASRSession::ASRSession(ASREngine* eng, connection_hdl h, server* srv, const std::string& id,
+                       const ResultFormat& format) 
     : engine(eng), hdl(h), ws_server(srv), client_id(id), running(true), 
-      segment_id(0), offset(0), speech_started(false),
-      session_start_time(std::chrono::steady_clock::now()) {
+      segment_id(0), speech_started(false), result_format(format),
+      session_start_time(std::chrono::steady_clock::now()),
+      trace_track(tracing::Tracer::instance().register_track(id)) {
     
-    // Create a dedicated VAD instance for this session
-    vad = engine->create_vad();
-    if (!vad) {
-        LOG_ERROR(client_id, "Failed to create VAD for session");
-        running = false;
-    }
+    const auto& streaming_config = engine->get_config().get_streaming_config();
+    incremental_partial = streaming_config.incremental_partial;
+    partial_window_samples = static_cast<size_t>(
+        streaming_config.partial_window_s * engine->get_sample_rate());
+    
+    // VAD检测到语音时向前回看两个窗口加最小语音时长，静音时至少保留这么多上下文
+    size_t sample_rate = static_cast<size_t>(engine->get_sample_rate());
+    size_t vad_window = engine->get_vad_service() ? 
+        static_cast<size_t>(engine->get_vad_service()->get_window_size()) : 512;
+    const auto& vad_config = engine->get_config().get_vad_config();
+    size_t min_speech_samples = static_cast<size_t>(vad_config.min_speech_duration * sample_rate);
+    size_t max_speech_samples = static_cast<size_t>(vad_config.max_speech_duration * sample_rate);
+    idle_context_samples = std::max(10 * vad_window, 3 * vad_window + min_speech_samples);
+    
+    // 一句话从保留的上下文开始，VAD按最大语音时长切分时语音段还包含回看范围和判决窗口，
+    // 这段音频在最终识别提交前都不能释放；环形缓冲区另留2秒容纳VAD尚未判决的积压
+    max_utterance_samples = idle_context_samples + max_speech_samples + 
+                            3 * vad_window + min_speech_samples;
+    audio_ring = std::make_unique<AudioRingBuffer>(max_utterance_samples + 2 * sample_rate);
+    
+    const auto& performance_config = engine->get_config().get_performance_config();
+    max_buffered_bytes = performance_config.max_audio_buffer_size;
+    parse_audio_overflow_policy(performance_config.audio_overflow_policy, overflow_policy);
 }
 
 ASRSession::~ASRSession() {
@@ -24,51 +47,103 @@ ASRSession::~ASRSession() {
         std::chrono::steady_clock::now() - session_start_time).count();
     LOG_INFO(client_id, "Session ended. Duration: " << session_duration 
              << "s, Processed samples: " << processed_samples.load() 
-             << ", Segments: " << processed_segments.load());
+             << ", Segments: " << processed_segments.load()
+             << ", Dropped samples: " << dropped_samples.load());
+    AudioMemoryBudget::instance().release(buffered_bytes.load());
 }
 
 void ASRSession::start() {
-    if (!vad || !running) {
+    // VAD流从共享服务创建，判决状态变化时唤醒处理任务
+    std::weak_ptr<ASRSession> weak_self = shared_from_this();
+    vad_stream = engine->create_vad_stream(audio_ring.get(), [weak_self]() {
+        if (auto self = weak_self.lock()) {
+            tracing::Tracer::instance().instant(self->trace_track, tracing::Lane::PROCESSING, "vad_event");
+            self->vad_event_pending = true;
+            self->schedule_processing();
+        }
+    });
+    
+    if (!vad_stream) {
         LOG_ERROR(client_id, "Cannot start session - VAD not available");
+        running = false;
         return;
     }
     LOG_INFO(client_id, "Starting ASR session");
-    processing_thread = std::thread(&ASRSession::process_audio, this);
 }
 
 void ASRSession::stop() {
     if (running.exchange(false)) {
+        // 已投递的处理任务检查running后直接退出，无需等待
         LOG_INFO(client_id, "Stopping ASR session");
-        audio_cv.notify_all();
-        if (processing_thread.joinable()) {
-            processing_thread.join();
-        }
     }
 }
 
-void ASRSession::add_audio_data(const std::vector<uint8_t>& pcm_bytes) {
+void ASRSession::add_audio_data(const uint8_t* pcm_bytes, size_t num_bytes) {
     if (!running) return;
     
-    // Convert PCM bytes to float samples
-    std::vector<float> samples;
-    samples.reserve(pcm_bytes.size() / 2);
+    size_t num_samples = num_bytes / 2;
+    size_t frame_bytes = num_samples * 2;
     
-    for (size_t i = 0; i < pcm_bytes.size(); i += 2) {
-        if (i + 1 < pcm_bytes.size()) {
-            int16_t sample = static_cast<int16_t>(pcm_bytes[i] | (pcm_bytes[i + 1] << 8));
-            samples.push_back(static_cast<float>(sample) / 32768.0f);
-        }
+    // 未处理的音频超出会话预算、环形缓冲区或全局预算时按溢出策略整帧处理，不接收半帧，
+    // 避免VAD和解码器看到从帧中间截断的音频。VAD必须按顺序读取音频，已缓冲的旧音频
+    // 无法跳过，drop_oldest在流式会话中与reject相同，丢弃新到的帧
+    const char* overflow_reason = nullptr;
+    if (buffered_bytes.load() + frame_bytes > max_buffered_bytes) {
+        overflow_reason = "session";
+    } else if (!audio_ring->can_write(num_samples)) {
+        // 当前句过长且处理任务跟不上
+        overflow_reason = "ring";
+    } else if (!AudioMemoryBudget::instance().try_acquire(frame_bytes)) {
+        overflow_reason = "global";
     }
+    if (overflow_reason) {
+        handle_overflow(num_samples, overflow_reason);
+        return;
+    }
+    overflow_reported = false;
     
-    processed_samples += samples.size();
+    // Convert PCM bytes to float samples，直接写入环形缓冲区（上面已确认空间足够）。
+    // 先计入buffered_bytes，处理任务看到新样本时计数一定已包含它们
+    buffered_bytes += frame_bytes;
+    size_t written = audio_ring->write_pcm16le(pcm_bytes, num_samples);
+    processed_samples += written;
+    LOG_DEBUG(client_id, "Added " << written << " audio samples to ring buffer");
     
-    {
-        std::lock_guard<std::mutex> lock(audio_mutex);
-        audio_queue.push(std::move(samples));
+    // 与process_pending_audio中的栅栏配对：处理任务清除调度标志后一定能看到本次写入
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    schedule_processing();
+}
+
+void ASRSession::handle_overflow(size_t dropped, const char* reason) {
+    AudioOverflowPolicy action = overflow_policy == AudioOverflowPolicy::CLOSE ? 
+        AudioOverflowPolicy::CLOSE : AudioOverflowPolicy::REJECT;
+    ServerMetrics& metrics = ServerMetrics::instance();
+    metrics.audio_overflow_events[static_cast<size_t>(action)].inc();
+    metrics.samples_dropped.inc(dropped);
+    dropped_samples += dropped;
+    
+    if (action == AudioOverflowPolicy::CLOSE) {
+        LOG_WARN(client_id, "Audio buffer overflow (" << reason << "), closing connection");
+        stop();
+        try {
+            ws_server->close(hdl, websocketpp::close::status::try_again_later, "audio buffer overflow");
+        } catch (const std::exception& e) {
+            LOG_ERROR(client_id, "Error closing connection: " << e.what());
+        }
+        return;
     }
-    audio_cv.notify_one();
     
-    LOG_DEBUG(client_id, "Added " << samples.size() << " audio samples to queue");
+    if (overflow_reported) return;
+    overflow_reported = true;
+    LOG_WARN(client_id, "Audio buffer overflow (" << reason << "), dropping incoming audio");
+    try {
+        std::string notice = std::string("{\"action\":\"") + audio_overflow_policy_name(action) +
+            "\",\"dropped_samples\":" + std::to_string(dropped) +
+            ",\"reason\":\"" + reason + "\",\"type\":\"overflow\"}";
+        ws_server->send(hdl, notice, websocketpp::frame::opcode::text);
+    } catch (const std::exception& e) {
+        LOG_ERROR(client_id, "Error sending overflow notice: " << e.what());
+    }
 }
 
 std::string ASRSession::get_client_id() const { 
@@ -79,178 +154,373 @@ bool ASRSession::is_running() const {
     return running.load(); 
 }
 
-void ASRSession::process_audio() {
-    if (!vad) {
-        LOG_ERROR(client_id, "VAD not available for processing");
-        return;
-    }
+void ASRSession::schedule_processing() {
+    if (!running || processing_scheduled.exchange(true)) return;
+    post_processing_task();
+}
+
+void ASRSession::post_processing_task() {
+    tracing::Tracer::instance().instant(trace_track, tracing::Lane::IO, "enqueue");
+    std::weak_ptr<ASRSession> weak_self = shared_from_this();
+    engine->get_worker_pool()->post([weak_self]() {
+        if (auto self = weak_self.lock()) {
+            self->process_pending_audio();
+        }
+    });
+}
+
+// 在工作线程上处理环形缓冲区中的新音频，每步最多process_step_samples个样本。
+// 没有新音频时先清除调度标志再复查写入位置，与add_audio_data配合不会丢失唤醒；
+// 单个任务最多处理max_steps_per_task步，积压较多时重新投递，避免一个会话长期占用工作线程
+void ASRSession::process_pending_audio() {
+    if (!vad_stream) return;
     
-    LOG_INFO(client_id, "ASR session processing started");
+    tracing::ScopedSpan task_span(trace_track, tracing::Lane::PROCESSING, "process_audio");
+    task_span.arg = static_cast<int64_t>(audio_ring->end() - buffered_end);
+    ServerMetrics::instance().session_backlog_seconds.observe(
+        (audio_ring->end() - buffered_end) / engine->get_sample_rate());
     
-    while (running) {
-        std::vector<float> samples;
+    for (int steps = 0; running; ++steps) {
+        uint64_t available = audio_ring->end();
+        if (buffered_end == available) {
+            // 没有新音频，但VAD的批量判决结果可能刚刚到达
+            if (vad_event_pending.exchange(false)) {
+                try {
+                    process_samples(buffered_end);
+                } catch (const std::exception& e) {
+                    LOG_ERROR(client_id, "Error processing VAD event: " << e.what());
+                }
+                continue;
+            }
+            processing_scheduled.store(false);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if ((audio_ring->end() == available && !vad_event_pending.load()) || 
+                processing_scheduled.exchange(true)) {
+                return;
+            }
+            continue;
+        }
         
-        // Wait for audio data
-        {
-            std::unique_lock<std::mutex> lock(audio_mutex);
-            audio_cv.wait(lock, [this] { return !audio_queue.empty() || !running; });
-            
-            if (!running) break;
-            if (audio_queue.empty()) continue;
-            
-            samples = std::move(audio_queue.front());
-            audio_queue.pop();
+        if (steps >= max_steps_per_task) {
+            post_processing_task();
+            return;
         }
         
         try {
-            // Add samples to buffer
-            buffer.insert(buffer.end(), samples.begin(), samples.end());
-            
-            // Process VAD in windows
-            int current_offset = offset.load();
-            while (current_offset + window_size < static_cast<int>(buffer.size())) {
-                vad->AcceptWaveform(buffer.data() + current_offset, window_size);
-                if (!speech_started.load() && vad->IsDetected()) {
-                    speech_started = true;
-                    started_time = std::chrono::steady_clock::now();
-                    LOG_DEBUG(client_id, "Speech detected, starting recognition");
-                }
-                current_offset += window_size;
-                offset = current_offset;
-            }
-            
-            // Clean up buffer when not speaking
-            if (!speech_started.load()) {
-                if (buffer.size() > 10 * window_size) {
-                    int new_offset = current_offset - (buffer.size() - 10 * window_size);
-                    buffer = std::vector<float>(buffer.end() - 10 * window_size, buffer.end());
-                    offset = new_offset;
-                }
-            }
-            
-            // Periodic inference during speech (every 0.2 seconds)
-            auto current_time = std::chrono::steady_clock::now();
-            float elapsed_seconds = std::chrono::duration_cast<std::chrono::milliseconds>(
-                current_time - started_time).count() / 1000.0f;
-            
-            if (speech_started.load() && elapsed_seconds > 0.2) {
-                perform_recognition_shared(false);
-                started_time = std::chrono::steady_clock::now();
-            }
-            
-            // Process completed speech segments from VAD
-            while (!vad->IsEmpty()) {
-                auto segment = vad->Front();
-                vad->Pop();
-                
-                process_speech_segment_shared(segment);
-                
-                // Reset state after processing a complete segment
-                buffer.clear();
-                offset = 0;
-                speech_started = false;
-            }
-            
+            process_samples(std::min<uint64_t>(available, buffered_end + process_step_samples));
         } catch (const std::exception& e) {
             LOG_ERROR(client_id, "Error processing audio: " << e.what());
         }
     }
+}
+
+void ASRSession::process_samples(uint64_t step_end) {
+    size_t consumed_bytes = static_cast<size_t>(step_end - buffered_end) * 2;
+    if (consumed_bytes > 0) {
+        buffered_bytes -= consumed_bytes;
+        AudioMemoryBudget::instance().release(consumed_bytes);
+    }
+    buffered_end = step_end;
+    
+    // 送入VAD；批处理模式下判决异步完成，状态变化时通过回调再次调度本任务
+    vad_stream->advance_to(buffered_end);
+    if (trace_track != 0 && vad_stream->get_processed_samples() > traced_vad_samples) {
+        traced_vad_samples = vad_stream->get_processed_samples();
+        tracing::Tracer::instance().instant(trace_track, tracing::Lane::PROCESSING, "vad_windows",
+                                            static_cast<int64_t>(traced_vad_samples));
+    }
+    if (!speech_started.load() && vad_stream->is_detected()) {
+        speech_started = true;
+        started_time = std::chrono::steady_clock::now();
+        tracing::Tracer::instance().instant(trace_track, tracing::Lane::PROCESSING, "speech_start");
+        LOG_DEBUG(client_id, "Speech detected, starting recognition");
+    }
+    
+    // Process completed speech segments from VAD，先于下面的缓冲区清理，避免释放已判决语音段的音频
+    VADSegment segment;
+    while (vad_stream->pop_segment(segment)) {
+        ServerMetrics::instance().segments_detected.inc();
+        tracing::Tracer::instance().instant(trace_track, tracing::Lane::PROCESSING, "segment_pop",
+                                            static_cast<int64_t>(segment.end - segment.begin));
+        // 先作废本句尚未发出的部分结果，再提交最终识别
+        reset_partial_state();
+        process_speech_segment_shared(segment);
+        
+        // Reset state after processing a complete segment，语音段之后的音频保留给下一句
+        release_utterance_until(std::max(utterance_begin, segment.end));
+        speech_started = false;
+    }
     
-    LOG_INFO(client_id, "ASR session processing ended");
+    uint64_t processed = vad_stream->get_processed_samples();
+    if (!speech_started.load()) {
+        // Clean up buffer when not speaking，尚未判决的音频和回看上下文不能释放
+        if (processed > utterance_begin + idle_context_samples) {
+            release_utterance_until(processed - idle_context_samples);
+        }
+    } else if (processed > utterance_begin + max_utterance_samples) {
+        // 语音中途不释放音频；VAD超过最大语音时长仍未切分时（如sherpa回退实现），
+        // 把已判决的部分作为一句提交最终识别，其后的语音继续作为新的一句
+        LOG_WARN(client_id, "Speech exceeds max utterance length without a VAD cut, forcing a final result");
+        reset_partial_state();
+        process_speech_segment_shared(VADSegment{utterance_begin, processed});
+        release_utterance_until(processed);
+    }
+    
+    // Periodic inference during speech (every 0.2 seconds)
+    auto current_time = std::chrono::steady_clock::now();
+    float elapsed_seconds = std::chrono::duration_cast<std::chrono::milliseconds>(
+        current_time - started_time).count() / 1000.0f;
+    
+    if (speech_started.load() && elapsed_seconds > 0.2) {
+        submit_partial_recognition();
+        started_time = std::chrono::steady_clock::now();
+    }
 }
 
-// 优化版本：使用共享ASR引擎处理语音段
-void ASRSession::process_speech_segment_shared(const SpeechSegment& segment) {
+// 当前句起点前移到position并把之前的空间归还给生产者。
+// 静音期间部分识别状态已在上一句结束时重置，这里不再加锁
+void ASRSession::release_utterance_until(uint64_t position) {
+    utterance_begin = position;
+    audio_ring->release_until(position);
+}
+
+// 优化版本：使用共享ASR引擎处理语音段。
+// 异步提交，工作线程不等待解码，结果由on_final_result按提交顺序发送
+void ASRSession::process_speech_segment_shared(const VADSegment& segment) {
     SharedASREngine* shared_asr = engine->get_shared_asr();
     if (!shared_asr || !shared_asr->is_initialized()) {
         LOG_ERROR(client_id, "Shared ASR engine not available");
         return;
     }
     
+    // 语音段音频直接从环形缓冲区取出。强制提交过的部分已经识别，从utterance_begin接着取；
+    // 否则语音段开头不应早于保留的音频，出现时说明缓冲区大小不足，记录被截掉的样本数
+    uint64_t begin = std::max(segment.begin, utterance_begin);
+    if (segment.begin < utterance_begin && utterance_begin > final_end) {
+        size_t truncated = static_cast<size_t>(utterance_begin - std::max(segment.begin, final_end));
+        LOG_WARN(client_id, "Speech segment starts before retained audio, final result misses "
+                 << truncated << " samples");
+        ServerMetrics::instance().final_samples_truncated.inc(truncated);
+    }
+    final_end = std::max(final_end, segment.end);
+    if (begin >= segment.end) {
+        LOG_WARN(client_id, "Speech segment no longer in audio buffer, skipping");
+        return;
+    }
+    std::vector<float> samples(static_cast<size_t>(segment.end - begin));
+    audio_ring->copy_to(begin, samples.size(), samples.data());
+    
+    uint64_t sequence;
+    {
+        std::lock_guard<std::mutex> lock(result_mutex);
+        sequence = finals_submitted++;
+    }
+    auto segment_time = std::chrono::steady_clock::now();
+    
+    std::weak_ptr<ASRSession> weak_self = shared_from_this();
     try {
-        std::string language, emotion, event;
-        std::vector<float> timestamps;
-        std::vector<std::string> tokens;
-        
-        // 使用共享ASR引擎进行识别，无需获取/释放实例
-        std::string text = shared_asr->recognize_with_metadata(
-            segment.samples.data(), segment.samples.size(),
-            language, emotion, event, timestamps, tokens);
+        // 提交到共享ASR引擎的批处理队列，与其他会话的语音段一起解码
+        shared_asr->submit_async(std::move(samples), DecodePriority::FINAL,
+            [weak_self, sequence, segment_time](RecognitionResult result) {
+                if (auto self = weak_self.lock()) {
+                    self->on_final_result(sequence, segment_time, std::move(result));
+                }
+            }, "", result_format.fields);
+    } catch (const std::exception& e) {
+        LOG_ERROR(client_id, "Error processing speech segment with shared ASR: " << e.what());
+        on_final_result(sequence, segment_time, RecognitionResult{});
+    }
+}
+
+void ASRSession::on_final_result(uint64_t sequence, std::chrono::steady_clock::time_point segment_time,
+                                 RecognitionResult result) {
+    if (trace_track != 0 && result.batch_size > 0) {
+        tracing::Tracer& tracer = tracing::Tracer::instance();
+        tracer.span(trace_track, tracing::Lane::DECODE, "final_queue_wait", segment_time, result.decode_start);
+        tracer.span(trace_track, tracing::Lane::DECODE, "final_decode", result.decode_start, result.decode_end,
+                    static_cast<int64_t>(result.batch_size));
+    }
+    
+    std::lock_guard<std::mutex> lock(result_mutex);
+    completed_finals.emplace(sequence, PendingFinal{std::move(result), segment_time});
+    
+    while (!completed_finals.empty() && completed_finals.begin()->first == next_final_to_send) {
+        RecognitionResult final_result = std::move(completed_finals.begin()->second.result);
+        segment_time = completed_finals.begin()->second.segment_time;
+        completed_finals.erase(completed_finals.begin());
+        next_final_to_send++;
         
-        if (!text.empty()) {
-            int current_segment_id = segment_id.fetch_add(1);
-            processed_segments++;
-            
-            LOG_INFO(client_id, "Recognition result [" << current_segment_id << "]: " << text);
-            
-            ASRResult asr_result;
-            asr_result.text = text;
-            asr_result.finished = true;
-            asr_result.idx = current_segment_id;
-            asr_result.lang = language;
-            asr_result.emotion = emotion;
-            asr_result.event = event;
-            asr_result.timestamps = timestamps;
-            asr_result.tokens = tokens;
-            
-            send_result(asr_result);
+        if (!final_result.ok) {
+            LOG_WARN(client_id, "Failed to decode speech segment");
+            continue;
         }
+        if (final_result.text.empty()) continue;
         
-    } catch (const std::exception& e) {
-        LOG_ERROR(client_id, "Error processing speech segment with shared ASR: " << e.what());
+        int current_segment_id = segment_id.fetch_add(1);
+        processed_segments++;
+        
+        LOG_INFO(client_id, "Recognition result [" << current_segment_id << "]: " << final_result.text);
+        
+        ASRResult asr_result;
+        asr_result.text = std::move(final_result.text);
+        asr_result.finished = true;
+        asr_result.idx = current_segment_id;
+        asr_result.lang = std::move(final_result.language);
+        asr_result.emotion = std::move(final_result.emotion);
+        asr_result.event = std::move(final_result.event);
+        asr_result.timestamps = std::move(final_result.timestamps);
+        asr_result.tokens = std::move(final_result.tokens);
+        
+        send_result(asr_result);
+        ServerMetrics::instance().final_results_sent.inc();
+        ServerMetrics::instance().vad_to_final_seconds.observe_since(segment_time);
+        tracing::Tracer::instance().span(trace_track, tracing::Lane::DECODE, "segment_to_final",
+                                         segment_time, std::chrono::steady_clock::now(), current_segment_id);
     }
 }
 
-// 优化版本：使用共享ASR引擎进行实时识别
-void ASRSession::perform_recognition_shared(bool is_final) {
+// 异步提交部分识别：优先级最低，同一会话排队中的旧请求会被新请求取代。
+// 增量模式下尾部超过窗口时，在静音点切分并把前半部分单独识别一次后缓存，
+// 每次部分识别的解码量因此不超过partial_window_samples，与话语总长度无关
+void ASRSession::submit_partial_recognition() {
     SharedASREngine* shared_asr = engine->get_shared_asr();
     if (!shared_asr || !shared_asr->is_initialized()) {
         LOG_ERROR(client_id, "Shared ASR engine not available");
         return;
     }
     
-    try {
-        std::string language, emotion, event;
-        std::vector<float> timestamps;
-        std::vector<std::string> tokens;
-        
-        // 使用共享ASR引擎进行识别，获取完整元数据
-        std::string text = shared_asr->recognize_with_metadata(
-            buffer.data(), buffer.size(),
-            language, emotion, event, timestamps, tokens);
-        
-        if (!text.empty()) {
-            ASRResult asr_result;
-            asr_result.text = text;
-            asr_result.finished = is_final;
-            asr_result.idx = segment_id.load();
-            asr_result.lang = language;
-            asr_result.emotion = emotion;
-            asr_result.event = event;
-            asr_result.timestamps = timestamps;
-            asr_result.tokens = tokens;
-            
-            send_result(asr_result);
-            
-            if (is_final) {
-                LOG_INFO(client_id, "Final result [" << segment_id.load() << "]: " << text);
-                segment_id++;
-            } else {
-                LOG_DEBUG(client_id, "Partial result [" << segment_id.load() << "]: " << text);
+    size_t tail_start = 0;
+    size_t commit_end = 0;
+    RecognitionResult prefix;
+    int generation;
+    {
+        std::lock_guard<std::mutex> lock(result_mutex);
+        generation = utterance_generation;
+        if (incremental_partial) {
+            if (!partial_commit_in_flight && 
+                utterance_size() - partial_commit_offset > partial_window_samples) {
+                commit_end = find_partial_cut_point();
+                partial_commit_in_flight = true;
             }
+            tail_start = partial_commit_offset;
+            prefix = partial_committed;
         }
+    }
+    
+    std::weak_ptr<ASRSession> weak_self = shared_from_this();
+    
+    try {
+        if (commit_end > 0) {
+            std::vector<float> committed_audio = copy_utterance(tail_start, commit_end);
+            shared_asr->submit_async(std::move(committed_audio), DecodePriority::PARTIAL,
+                [weak_self, generation, commit_end](RecognitionResult result) {
+                    if (auto self = weak_self.lock()) {
+                        self->on_partial_prefix_committed(generation, commit_end, std::move(result));
+                    }
+                }, "", result_format.fields);
+        }
+        
+        std::vector<float> tail_audio = copy_utterance(tail_start, utterance_size());
+        shared_asr->submit_async(std::move(tail_audio), DecodePriority::PARTIAL,
+            [weak_self, generation, tail_start, prefix = std::move(prefix)](RecognitionResult result) mutable {
+                if (auto self = weak_self.lock()) {
+                    self->on_partial_result(generation, tail_start, std::move(prefix), std::move(result));
+                }
+            }, client_id, result_format.fields);
         
     } catch (const std::exception& e) {
         LOG_ERROR(client_id, "Error in shared recognition: " << e.what());
     }
 }
 
+void ASRSession::on_partial_prefix_committed(int generation, size_t commit_end, RecognitionResult result) {
+    std::lock_guard<std::mutex> lock(result_mutex);
+    if (generation != utterance_generation) return;
+    
+    if (!result.ok) {
+        // 不推进提交位置，下一次部分识别重新切分并提交这段前缀
+        LOG_WARN(client_id, "Failed to decode partial prefix, will retry on the next partial");
+        partial_commit_in_flight = false;
+        return;
+    }
+    append_recognition(partial_committed, std::move(result), 
+                       partial_commit_offset / engine->get_sample_rate());
+    partial_commit_offset = commit_end;
+    partial_commit_in_flight = false;
+    LOG_DEBUG(client_id, "Committed partial prefix up to sample " << commit_end);
+}
+
+void ASRSession::on_partial_result(int generation, size_t tail_start, 
+                                   RecognitionResult prefix, RecognitionResult tail) {
+    if (tail.superseded || !tail.ok) return;
+    tracing::Tracer::instance().span(trace_track, tracing::Lane::DECODE, "partial_decode", 
+                                     tail.decode_start, tail.decode_end, static_cast<int64_t>(tail.batch_size));
+    
+    // 持锁发送，保证本句的最终结果发出后不会再出现它的部分结果
+    std::lock_guard<std::mutex> lock(result_mutex);
+    if (generation != utterance_generation) return;
+    if (next_final_to_send != finals_submitted) return;
+    
+    append_recognition(prefix, std::move(tail), tail_start / engine->get_sample_rate());
+    if (prefix.text.empty()) return;
+    
+    ASRResult asr_result;
+    asr_result.text = std::move(prefix.text);
+    asr_result.finished = false;
+    asr_result.idx = segment_id.load();
+    asr_result.lang = std::move(prefix.language);
+    asr_result.emotion = std::move(prefix.emotion);
+    asr_result.event = std::move(prefix.event);
+    asr_result.timestamps = std::move(prefix.timestamps);
+    asr_result.tokens = std::move(prefix.tokens);
+    
+    send_result(asr_result);
+    ServerMetrics::instance().partial_results_sent.inc();
+    LOG_DEBUG(client_id, "Partial result [" << asr_result.idx << "]: " << asr_result.text);
+}
+
+// 在尾部窗口的[1/4, 3/4]区间内寻找能量最低的20ms帧作为切分点，减少切断字词
+size_t ASRSession::find_partial_cut_point() const {
+    const size_t frame = static_cast<size_t>(engine->get_sample_rate() / 50);
+    const size_t search_begin = utterance_size() - partial_window_samples * 3 / 4;
+    const size_t search_end = utterance_size() - partial_window_samples / 4;
+    std::vector<float> scratch;
+    const float* window = audio_ring->view(utterance_begin + search_begin, search_end - search_begin, scratch);
+    
+    size_t best_cut = search_begin;
+    float best_energy = std::numeric_limits<float>::max();
+    for (size_t start = search_begin; start + frame <= search_end; start += frame) {
+        float energy = 0.0f;
+        for (size_t i = start - search_begin; i < start - search_begin + frame; ++i) {
+            energy += window[i] * window[i];
+        }
+        if (energy < best_energy) {
+            best_energy = energy;
+            best_cut = start + frame / 2;
+        }
+    }
+    return best_cut;
+}
+
+void ASRSession::reset_partial_state() {
+    std::lock_guard<std::mutex> lock(result_mutex);
+    utterance_generation++;
+    partial_commit_offset = 0;
+    partial_committed = RecognitionResult{};
+    partial_commit_in_flight = false;
+}
+
 void ASRSession::send_result(const ASRResult& result) {
+    tracing::ScopedSpan send_span(trace_track, tracing::Lane::PROCESSING, "send_result");
+    send_span.arg = result.finished ? 1 : 0;
     try {
-        Json::Value json_result = result.to_json();
-        Json::StreamWriterBuilder builder;
-        std::string json_string = Json::writeString(builder, json_result);
-        ws_server->send(hdl, json_string, websocketpp::frame::opcode::text);
+        if (result_format.binary) {
+            const std::string& frame = result_writer.write_binary(result);
+            ws_server->send(hdl, frame.data(), frame.size(), websocketpp::frame::opcode::binary);
+        } else {
+            const std::string& json_string = result_writer.write_json(result, result_format.fields);
+            ws_server->send(hdl, json_string.data(), json_string.size(), websocketpp::frame::opcode::text);
+        }
         LOG_DEBUG(client_id, "Sent result: " << (result.finished ? "final" : "partial"));
     } catch (const std::exception& e) {
         LOG_ERROR(client_id, "Error sending result: " << e.what());
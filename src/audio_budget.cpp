@@ -0,0 +1,46 @@
+#include "audio_budget.h"
+
+bool parse_audio_overflow_policy(const std::string& name, AudioOverflowPolicy& policy) {
+    if (name == "drop_oldest") {
+        policy = AudioOverflowPolicy::DROP_OLDEST;
+    } else if (name == "reject") {
+        policy = AudioOverflowPolicy::REJECT;
+    } else if (name == "close") {
+        policy = AudioOverflowPolicy::CLOSE;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+const char* audio_overflow_policy_name(AudioOverflowPolicy policy) {
+    switch (policy) {
+        case AudioOverflowPolicy::DROP_OLDEST: return "drop_oldest";
+        case AudioOverflowPolicy::REJECT: return "reject";
+        case AudioOverflowPolicy::CLOSE: return "close";
+    }
+    return "unknown";
+}
+
+AudioMemoryBudget& AudioMemoryBudget::instance() {
+    static AudioMemoryBudget budget;
+    return budget;
+}
+
+bool AudioMemoryBudget::try_acquire(size_t bytes) {
+    size_t max_bytes = limit.load(std::memory_order_relaxed);
+    if (max_bytes == 0) {
+        used.fetch_add(bytes, std::memory_order_relaxed);
+        return true;
+    }
+
+    size_t current = used.load(std::memory_order_relaxed);
+    do {
+        if (current + bytes > max_bytes) return false;
+    } while (!used.compare_exchange_weak(current, current + bytes, std::memory_order_relaxed));
+    return true;
+}
+
+void AudioMemoryBudget::release(size_t bytes) {
+    used.fetch_sub(bytes, std::memory_order_relaxed);
+}
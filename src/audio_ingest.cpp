@@ -0,0 +1,206 @@
+#include "audio_ingest.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define AUDIO_INGEST_X86 1
+#include <immintrin.h>
+#endif
+
+namespace audio_ingest {
+
+namespace {
+
+constexpr float kScale = 1.0f / 32768.0f;
+
+inline void convert_scalar_tail(const uint8_t* src, size_t begin, size_t end, float* dst) {
+    for (size_t i = begin; i < end; ++i) {
+        int16_t sample = static_cast<int16_t>(src[i * 2] | (src[i * 2 + 1] << 8));
+        dst[i] = static_cast<float>(sample) * kScale;
+    }
+}
+
+#ifdef AUDIO_INGEST_X86
+
+// SSE2是x86-64的基线指令集，每次处理8个样本
+void convert_sse2(const uint8_t* src, size_t num_samples, float* dst) {
+    const __m128 scale = _mm_set1_ps(kScale);
+    size_t i = 0;
+    for (; i + 8 <= num_samples; i += 8) {
+        __m128i pcm = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        // 把int16放到int32的高16位再算术右移，完成符号扩展
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(pcm, pcm), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(pcm, pcm), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    convert_scalar_tail(src, i, num_samples, dst);
+}
+
+// AVX2每次处理16个样本
+__attribute__((target("avx2")))
+void convert_avx2(const uint8_t* src, size_t num_samples, float* dst) {
+    const __m256 scale = _mm256_set1_ps(kScale);
+    size_t i = 0;
+    for (; i + 16 <= num_samples; i += 16) {
+        __m128i pcm_lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        __m128i pcm_hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2 + 16));
+        __m256 lo = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(pcm_lo));
+        __m256 hi = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(pcm_hi));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(lo, scale));
+        _mm256_storeu_ps(dst + i + 8, _mm256_mul_ps(hi, scale));
+    }
+    convert_scalar_tail(src, i, num_samples, dst);
+}
+
+bool cpu_has_avx2() {
+    static const bool supported = __builtin_cpu_supports("avx2");
+    return supported;
+}
+
+#endif
+
+void convert_scalar(const uint8_t* src, size_t num_samples, float* dst) {
+    convert_scalar_tail(src, 0, num_samples, dst);
+}
+
+typedef void (*ConvertKernel)(const uint8_t*, size_t, float*);
+
+struct KernelSelection {
+    ConvertKernel kernel;
+    const char* name;
+};
+
+const KernelSelection& select_kernel() {
+    static const KernelSelection selection = []() -> KernelSelection {
+#ifdef AUDIO_INGEST_X86
+        if (cpu_has_avx2()) return {convert_avx2, "avx2"};
+        return {convert_sse2, "sse2"};
+#else
+        return {convert_scalar, "scalar"};
+#endif
+    }();
+    return selection;
+}
+
+} // namespace
+
+void convert_pcm16le(const uint8_t* src, size_t num_samples, float* dst) {
+    select_kernel().kernel(src, num_samples, dst);
+}
+
+size_t append_pcm16le(const void* data, size_t num_bytes, std::vector<float>& dst) {
+    size_t num_samples = num_bytes / 2;
+    if (num_samples == 0) return 0;
+    
+    size_t old_size = dst.size();
+    dst.resize(old_size + num_samples);
+    convert_pcm16le(static_cast<const uint8_t*>(data), num_samples, dst.data() + old_size);
+    return num_samples;
+}
+
+bool decode_wav(const uint8_t* data, size_t size, int expected_rate, 
+                std::vector<float>& samples, std::string& error) {
+    auto u16 = [data](size_t off) { return static_cast<uint32_t>(data[off] | (data[off + 1] << 8)); };
+    auto u32 = [&u16](size_t off) { return u16(off) | (u16(off + 2) << 16); };
+
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0) {
+        error = "not a RIFF/WAVE file";
+        return false;
+    }
+
+    uint32_t format = 0, channels = 0, rate = 0, bits = 0;
+    size_t pcm_offset = 0, pcm_bytes = 0;
+    bool has_data = false;
+    for (size_t off = 12; off + 8 <= size;) {
+        uint32_t chunk_size = u32(off + 4);
+        size_t body = off + 8;
+        if (std::memcmp(data + off, "fmt ", 4) == 0 && body + 16 <= size) {
+            format = u16(body);
+            channels = u16(body + 2);
+            rate = u32(body + 4);
+            bits = u16(body + 14);
+            // WAVE_FORMAT_EXTENSIBLE: 子格式GUID的前两个字节为实际格式
+            if (format == 0xFFFE && chunk_size >= 26 && body + 26 <= size) format = u16(body + 24);
+        } else if (std::memcmp(data + off, "data", 4) == 0) {
+            pcm_offset = body;
+            pcm_bytes = std::min<size_t>(chunk_size, size - body);
+            has_data = true;
+            break;
+        }
+        off = body + chunk_size + (chunk_size & 1);
+    }
+
+    if (format != 1 || bits != 16 || channels == 0) {
+        error = "only 16-bit PCM WAV is supported";
+        return false;
+    }
+    if (static_cast<int>(rate) != expected_rate) {
+        error = "sample rate " + std::to_string(rate) + " Hz does not match " + std::to_string(expected_rate) + " Hz";
+        return false;
+    }
+    if (!has_data) {
+        error = "missing data chunk";
+        return false;
+    }
+
+    size_t frames = pcm_bytes / (2 * channels);
+    samples.resize(frames);
+    if (channels == 1) {
+        convert_pcm16le(data + pcm_offset, frames, samples.data());
+        return true;
+    }
+    for (size_t i = 0; i < frames; ++i) {
+        int sum = 0;
+        for (uint32_t c = 0; c < channels; ++c) {
+            sum += static_cast<int16_t>(u16(pcm_offset + (i * channels + c) * 2));
+        }
+        samples[i] = static_cast<float>(sum) / static_cast<float>(channels) * kScale;
+    }
+    return true;
+}
+
+bool load_wav_file(const std::string& path, int expected_rate, 
+                   std::vector<float>& samples, std::string& error) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "cannot open file";
+        return false;
+    }
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    return decode_wav(reinterpret_cast<const uint8_t*>(data.data()), data.size(), expected_rate, samples, error);
+}
+
+const char* get_active_kernel() {
+    return select_kernel().name;
+}
+
+bool convert_pcm16le_scalar(const uint8_t* src, size_t num_samples, float* dst) {
+    convert_scalar(src, num_samples, dst);
+    return true;
+}
+
+bool convert_pcm16le_sse2(const uint8_t* src, size_t num_samples, float* dst) {
+#ifdef AUDIO_INGEST_X86
+    convert_sse2(src, num_samples, dst);
+    return true;
+#else
+    (void)src; (void)num_samples; (void)dst;
+    return false;
+#endif
+}
+
+bool convert_pcm16le_avx2(const uint8_t* src, size_t num_samples, float* dst) {
+#ifdef AUDIO_INGEST_X86
+    if (!cpu_has_avx2()) return false;
+    convert_avx2(src, num_samples, dst);
+    return true;
+#else
+    (void)src; (void)num_samples; (void)dst;
+    return false;
+#endif
+}
+
+} // namespace audio_ingest
@@ -0,0 +1,334 @@
+#include "batch_transcriber.h"
+#include "audio_ingest.h"
+#include "server_config.h"
+#include "logger.h"
+#include <json/json.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+// 单个文件的转写状态，语音段的提交与拼接由SegmentedDecode完成
+struct BatchTranscriber::FileJob {
+    std::string path;
+    size_t num_samples = 0;
+    std::string error;                  // 提交途中出错时由拼接回调写出
+    std::chrono::steady_clock::time_point start_time;
+};
+
+namespace {
+
+bool has_wav_extension(const fs::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return std::tolower(c); });
+    return ext == ".wav";
+}
+
+std::string trim(const std::string& value) {
+    size_t begin = value.find_first_not_of(" \t\r\n");
+    if (begin == std::string::npos) return "";
+    size_t end = value.find_last_not_of(" \t\r\n");
+    return value.substr(begin, end - begin + 1);
+}
+
+} // namespace
+
+BatchTranscriber::BatchTranscriber(const ServerConfig& config)
+    : config_(std::make_unique<ServerConfig>(config)) {}
+
+BatchTranscriber::~BatchTranscriber() {
+    // 等待已提交的文件完成，避免回调访问已销毁的成员
+    std::unique_lock<std::mutex> lock(flight_mutex);
+    flight_cv.wait(lock, [this]() { return in_flight == 0; });
+}
+
+bool BatchTranscriber::initialize() {
+    LOG_INFO("TRANSCRIBE", "Initializing ASR engine...");
+    const auto& server_settings = config_->get_server_settings();
+    if (!asr_engine.initialize(server_settings.models_root, *config_)) {
+        LOG_ERROR("TRANSCRIBE", "Failed to initialize ASR engine");
+        return false;
+    }
+
+    const auto& asr_config = config_->get_asr_config();
+    int jobs = config_->get_transcribe_config().jobs;
+    max_in_flight = jobs > 0 ? static_cast<size_t>(jobs) :
+        static_cast<size_t>(std::max(1, asr_config.batch_size * asr_config.pool_size * 2));
+    return true;
+}
+
+bool BatchTranscriber::collect_inputs(std::vector<std::string>& files) const {
+    const std::string& input = config_->get_transcribe_config().input;
+    std::error_code ec;
+
+    if (fs::is_directory(input, ec)) {
+        for (fs::recursive_directory_iterator it(input, fs::directory_options::skip_permission_denied, ec), end;
+             !ec && it != end; it.increment(ec)) {
+            if (it->is_regular_file(ec) && has_wav_extension(it->path())) {
+                files.push_back(it->path().string());
+            }
+        }
+        if (ec) {
+            LOG_ERROR("TRANSCRIBE", "Error scanning " << input << ": " << ec.message());
+            return false;
+        }
+        std::sort(files.begin(), files.end());
+        return true;
+    }
+
+    if (!fs::is_regular_file(input, ec)) {
+        LOG_ERROR("TRANSCRIBE", "Input not found: " << input);
+        return false;
+    }
+
+    if (has_wav_extension(input)) {
+        files.push_back(input);
+        return true;
+    }
+
+    // 列表文件：每行一个路径，忽略空行和#开头的注释
+    std::ifstream list(input);
+    std::string line;
+    while (std::getline(list, line)) {
+        line = trim(line);
+        if (!line.empty() && line[0] != '#') files.push_back(line);
+    }
+    return true;
+}
+
+std::unordered_set<std::string> BatchTranscriber::load_completed(bool& ends_with_newline) const {
+    std::unordered_set<std::string> completed;
+    ends_with_newline = true;
+
+    std::ifstream in(config_->get_transcribe_config().output, std::ios::binary);
+    if (!in) return completed;
+
+    Json::CharReaderBuilder builder;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    std::string line;
+    while (std::getline(in, line)) {
+        ends_with_newline = !in.eof();
+        // 被中断时写了一半的行无法解析，对应文件会重新转写；失败记录的文件也重新转写
+        Json::Value record;
+        if (reader->parse(line.data(), line.data() + line.size(), &record, nullptr) &&
+            record.isObject() && record["file"].isString() && !record.isMember("error")) {
+            completed.insert(record["file"].asString());
+        }
+    }
+    return completed;
+}
+
+int BatchTranscriber::run() {
+    if (!asr_engine.is_initialized()) {
+        LOG_ERROR("TRANSCRIBE", "ASR engine not initialized");
+        return 1;
+    }
+    WorkerPool* worker_pool = asr_engine.get_worker_pool();
+    if (!worker_pool) {
+        LOG_ERROR("TRANSCRIBE", "Worker pool not available");
+        return 1;
+    }
+
+    std::vector<std::string> files;
+    if (!collect_inputs(files)) return 1;
+
+    const auto& transcribe_config = config_->get_transcribe_config();
+    std::unordered_set<std::string> completed;
+    bool ends_with_newline = true;
+    if (transcribe_config.resume) {
+        completed = load_completed(ends_with_newline);
+    }
+
+    output.open(transcribe_config.output, transcribe_config.resume ? std::ios::app : std::ios::trunc);
+    if (!output) {
+        LOG_ERROR("TRANSCRIBE", "Cannot open output file: " << transcribe_config.output);
+        return 1;
+    }
+    if (!ends_with_newline) output << '\n';
+
+    size_t skipped = 0;
+    std::vector<std::string> pending;
+    pending.reserve(files.size());
+    for (auto& path : files) {
+        if (completed.count(path)) {
+            ++skipped;
+        } else {
+            pending.push_back(std::move(path));
+        }
+    }
+
+    LOG_INFO("TRANSCRIBE", "Transcribing " << pending.size() << " files (" << skipped
+             << " already done), " << max_in_flight << " in flight -> " << transcribe_config.output);
+
+    auto start_time = std::chrono::steady_clock::now();
+    auto last_report = start_time;
+    for (const auto& path : pending) {
+        {
+            std::unique_lock<std::mutex> lock(flight_mutex);
+            flight_cv.wait(lock, [this]() { return in_flight < max_in_flight; });
+            ++in_flight;
+        }
+        worker_pool->post([this, path]() { process_file(path); });
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - last_report >= std::chrono::seconds(10)) {
+            last_report = now;
+            LOG_INFO("TRANSCRIBE", "Progress: " << files_done.load() + files_failed.load() << "/" << pending.size());
+        }
+    }
+    {
+        std::unique_lock<std::mutex> lock(flight_mutex);
+        flight_cv.wait(lock, [this]() { return in_flight == 0; });
+    }
+
+    double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    double audio_s = audio_samples.load() / asr_engine.get_sample_rate();
+    double rtf = audio_s > 0.0 ? wall_s / audio_s : 0.0;
+
+    std::ostringstream summary;
+    summary << std::fixed << std::setprecision(3)
+            << "Files: " << files_done.load() << " ok, " << files_failed.load() << " failed, " << skipped << " skipped"
+            << " | Segments: " << segments_decoded.load()
+            << " | Audio: " << audio_s << "s | Wall: " << wall_s << "s"
+            << " | RTF: " << rtf << " (" << std::setprecision(1) << (rtf > 0.0 ? 1.0 / rtf : 0.0) << "x realtime)";
+    LOG_INFO("TRANSCRIBE", summary.str());
+
+    return files_failed.load() > 0 ? 1 : 0;
+}
+
+void BatchTranscriber::process_file(const std::string& path) {
+    std::shared_ptr<FileJob> job;
+    std::shared_ptr<SegmentedDecode> decode;
+    try {
+        job = std::make_shared<FileJob>();
+        job->path = path;
+        job->start_time = std::chrono::steady_clock::now();
+
+        std::vector<float> samples;
+        std::string error;
+        if (!audio_ingest::load_wav_file(path, static_cast<int>(asr_engine.get_sample_rate()), samples, error)) {
+            write_error(path, error);
+            return;
+        }
+        job->num_samples = samples.size();
+        audio_samples.fetch_add(samples.size());
+
+        // 按VAD切分，静音不参与解码；每段不超过最大语音时长，便于组成满批次。
+        // 分段共用VAD服务已加载的模型（回退模式下复用空闲实例），不按文件加载模型
+        std::vector<VADSegment> segments;
+        VADService* vad_service = asr_engine.get_vad_service();
+        if (!vad_service || !vad_service->segment_offline(samples.data(), samples.size(), segments)) {
+            LOG_WARN("TRANSCRIBE", "VAD segmentation failed for " << path << ", decoding as a whole");
+            segments.clear();
+            segments.push_back(VADSegment{0, samples.size()});
+        }
+
+        // 与/oneshot、/transcribe共用分段解码；结果拼接和写文件交给工作线程，不占用解码线程
+        WorkerPool* worker_pool = asr_engine.get_worker_pool();
+        decode = std::make_shared<SegmentedDecode>(asr_engine.get_shared_asr(), DecodePriority::ONESHOT,
+            RESULT_FIELDS_ALL,
+            [this, job, worker_pool](RecognitionResult joined, size_t failed_segments, size_t total_segments) {
+                worker_pool->post([this, job, joined, failed_segments, total_segments]() mutable {
+                    finish_file(job, std::move(joined), failed_segments, total_segments);
+                });
+            });
+
+        const float sample_rate = asr_engine.get_sample_rate();
+        for (const auto& segment : segments) {
+            size_t begin = std::min<size_t>(segment.begin, samples.size());
+            size_t end = std::min<size_t>(segment.end, samples.size());
+            decode->submit(std::vector<float>(samples.begin() + begin, samples.begin() + end),
+                           segment.begin / sample_rate);
+        }
+        decode->seal();
+    } catch (const std::exception& e) {
+        if (!decode) {
+            write_error(path, e.what());
+            return;
+        }
+        // 已提交的语音段仍会回调：记录错误后结束提交，由拼接回调写出错误，
+        // 保证每个文件只释放一次名额
+        job->error = e.what();
+        decode->seal();
+    }
+}
+
+void BatchTranscriber::finish_file(const std::shared_ptr<FileJob>& job, RecognitionResult joined,
+                                   size_t failed_segments, size_t total_segments) {
+    if (!job->error.empty()) {
+        write_error(job->path, job->error);
+        return;
+    }
+    segments_decoded.fetch_add(total_segments - failed_segments);
+
+    // 任一语音段失败都按失败记录，--transcribe-resume会重新转写该文件
+    if (failed_segments > 0) {
+        write_error(job->path, failed_segments == total_segments ? "recognition failed" :
+                    "recognition failed - " + std::to_string(failed_segments) + " of " + 
+                    std::to_string(total_segments) + " speech segments failed");
+        return;
+    }
+
+    const float sample_rate = asr_engine.get_sample_rate();
+    double elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - job->start_time).count();
+
+    Json::Value record;
+    record["file"] = job->path;
+    record["duration"] = job->num_samples / sample_rate;
+    record["text"] = joined.text;
+    record["lang"] = joined.language;
+    record["emotion"] = joined.emotion;
+    record["event"] = joined.event;
+    record["timestamps"] = Json::Value(Json::arrayValue);
+    for (float timestamp : joined.timestamps) {
+        record["timestamps"].append(timestamp);
+    }
+    record["tokens"] = Json::Value(Json::arrayValue);
+    for (const auto& token : joined.tokens) {
+        record["tokens"].append(token);
+    }
+    record["segments"] = static_cast<Json::UInt64>(total_segments);
+    record["elapsed"] = elapsed_s;
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    write_line(Json::writeString(builder, record));
+
+    files_done.fetch_add(1);
+    LOG_DEBUG("TRANSCRIBE", "Done " << job->path << ": " << total_segments << " segments in " << elapsed_s << "s");
+    release_slot();
+}
+
+void BatchTranscriber::write_error(const std::string& path, const std::string& error) {
+    LOG_WARN("TRANSCRIBE", "Failed " << path << ": " << error);
+
+    Json::Value record;
+    record["file"] = path;
+    record["error"] = error;
+
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    write_line(Json::writeString(builder, record));
+
+    files_failed.fetch_add(1);
+    release_slot();
+}
+
+void BatchTranscriber::write_line(const std::string& line) {
+    // 每行写完即刷新，进程被中断时输出中只可能有最后一行不完整
+    std::lock_guard<std::mutex> lock(output_mutex);
+    output << line << '\n';
+    output.flush();
+}
+
+void BatchTranscriber::release_slot() {
+    // 持锁通知：析构函数等到in_flight为0后即可销毁条件变量
+    std::lock_guard<std::mutex> lock(flight_mutex);
+    --in_flight;
+    flight_cv.notify_all();
+}
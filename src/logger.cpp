@@ -1,5 +1,325 @@
 #include "logger.h"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 // Static member definitions
-LogLevel Logger::current_level = LogLevel::INFO;
-std::mutex Logger::log_mutex;
+std::atomic<int> Logger::current_level{static_cast<int>(LogLevel::INFO)};
+
+namespace {
+
+const char* level_to_string(LogLevel level) {
+    switch (level) {
+        case LogLevel::DEBUG: return "DEBUG";
+        case LogLevel::INFO:  return "INFO ";
+        case LogLevel::WARN:  return "WARN ";
+        case LogLevel::ERROR: return "ERROR";
+        default: return "UNKNOWN";
+    }
+}
+
+// 队列中的一条记录，全部是定长字段，入队出队不分配内存
+struct Record {
+    LogLevel level;
+    std::chrono::system_clock::time_point time;
+    std::thread::id thread_id;
+    const char* file;          // __FILE__，静态存储
+    int line;
+    uint16_t client_length;
+    uint16_t message_length;
+    bool truncated;
+    char client_id[64];
+    char message[Logger::kMaxMessageSize];
+};
+
+// 多生产者单消费者的有界环形队列：每个槽位的sequence表明它属于哪一轮，
+// 生产者CAS抢占写入位置，写完后发布sequence；后台线程是唯一的消费者
+class AsyncBackend {
+private:
+    static const size_t kCapacity = 4096;   // 必须是2的幂
+
+    struct Slot {
+        std::atomic<size_t> sequence;
+        Record record;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<size_t> enqueue_pos{0};
+    size_t dequeue_pos = 0;                 // 仅后台线程访问
+    std::atomic<size_t> written{0};         // 已写出的记录数，供flush等待
+    std::atomic<size_t> dropped{0};
+
+    std::thread writer;
+    std::mutex wake_mutex;
+    std::condition_variable wake_cv;
+    std::atomic<bool> writer_waiting{false};
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> stopped{false};
+    std::mutex direct_mutex;                // 后台线程退出后直接同步写
+
+    // 后台线程的格式化状态
+    std::string out;
+    std::time_t cached_second = 0;
+    char cached_time[32] = {0};
+    std::unordered_map<std::thread::id, std::string> thread_names;
+
+    void format(const Record& record);
+    void write_out();
+    void writer_loop();
+    bool drain();
+
+public:
+    AsyncBackend();
+
+    bool push(LogLevel level, std::string_view client_id, const char* file, int line,
+              std::string_view message, bool truncated);
+    void write_direct(LogLevel level, std::string_view client_id, const char* file, int line,
+                      std::string_view message, bool truncated);
+    void flush();
+    void shutdown();
+    bool is_stopped() const { return stopped.load(std::memory_order_acquire); }
+};
+
+AsyncBackend::AsyncBackend() : slots(new Slot[kCapacity]) {
+    for (size_t i = 0; i < kCapacity; ++i) {
+        slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    out.reserve(64 * 1024);
+    writer = std::thread(&AsyncBackend::writer_loop, this);
+}
+
+bool AsyncBackend::push(LogLevel level, std::string_view client_id, const char* file, int line,
+                        std::string_view message, bool truncated) {
+    size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+    Slot* slot;
+    for (;;) {
+        slot = &slots[pos & (kCapacity - 1)];
+        size_t sequence = slot->sequence.load(std::memory_order_acquire);
+        intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+        if (diff == 0) {
+            if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            // 队列已满：DEBUG/INFO直接丢弃并计数，WARN/ERROR等待后台线程腾出空间
+            if (level < LogLevel::WARN || stopping.load(std::memory_order_relaxed)) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            wake_cv.notify_one();
+            std::this_thread::yield();
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        } else {
+            pos = enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    Record& record = slot->record;
+    record.level = level;
+    record.time = std::chrono::system_clock::now();
+    record.thread_id = std::this_thread::get_id();
+    record.file = file;
+    record.line = line;
+    record.client_length = static_cast<uint16_t>(std::min(client_id.size(), sizeof(record.client_id)));
+    std::memcpy(record.client_id, client_id.data(), record.client_length);
+    record.message_length = static_cast<uint16_t>(std::min(message.size(), sizeof(record.message)));
+    std::memcpy(record.message, message.data(), record.message_length);
+    record.truncated = truncated || message.size() > sizeof(record.message);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    if (writer_waiting.load(std::memory_order_relaxed)) {
+        wake_cv.notify_one();
+    }
+    return true;
+}
+
+void AsyncBackend::format(const Record& record) {
+    std::time_t seconds = std::chrono::system_clock::to_time_t(record.time);
+    if (seconds != cached_second) {
+        std::tm local_time{};
+        localtime_r(&seconds, &local_time);
+        std::strftime(cached_time, sizeof(cached_time), "%Y-%m-%d %H:%M:%S", &local_time);
+        cached_second = seconds;
+    }
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(record.time.time_since_epoch()).count() % 1000;
+
+    auto it = thread_names.find(record.thread_id);
+    if (it == thread_names.end()) {
+        std::ostringstream ss;
+        ss << record.thread_id;
+        it = thread_names.emplace(record.thread_id, ss.str()).first;
+    }
+
+    char prefix[64];
+    std::snprintf(prefix, sizeof(prefix), "[%s.%03d] [%s] [", cached_time, static_cast<int>(ms),
+                  level_to_string(record.level));
+    out += prefix;
+    out += it->second;
+    out += "] [";
+    out.append(record.client_id, record.client_length);
+    out += "] [";
+    out += record.file;
+    out += ":";
+    out += std::to_string(record.line);
+    out += "] ";
+    out.append(record.message, record.message_length);
+    if (record.truncated) out += "...[truncated]";
+    out += '\n';
+}
+
+void AsyncBackend::write_out() {
+    if (out.empty()) return;
+    std::fwrite(out.data(), 1, out.size(), stdout);
+    std::fflush(stdout);
+    out.clear();
+}
+
+// 取出当前所有可读记录并一次写出，返回是否取到记录
+bool AsyncBackend::drain() {
+    size_t count = 0;
+    for (;;) {
+        Slot& slot = slots[dequeue_pos & (kCapacity - 1)];
+        if (slot.sequence.load(std::memory_order_acquire) != dequeue_pos + 1) break;
+        format(slot.record);
+        slot.sequence.store(dequeue_pos + kCapacity, std::memory_order_release);
+        ++dequeue_pos;
+        ++count;
+        if (out.size() >= 60 * 1024) write_out();
+    }
+
+    size_t lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost > 0) {
+        out += "[LOGGER] " + std::to_string(lost) + " log records dropped, queue full\n";
+    }
+    write_out();
+    if (count > 0) written.fetch_add(count, std::memory_order_release);
+    return count > 0;
+}
+
+void AsyncBackend::writer_loop() {
+    while (!stopping.load(std::memory_order_acquire)) {
+        if (drain()) continue;
+
+        // 队列空：短暂等待，生产者看到writer_waiting时唤醒；即使错过唤醒最多延迟50ms
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        writer_waiting.store(true, std::memory_order_relaxed);
+        wake_cv.wait_for(lock, std::chrono::milliseconds(50));
+        writer_waiting.store(false, std::memory_order_relaxed);
+    }
+    drain();
+}
+
+void AsyncBackend::write_direct(LogLevel level, std::string_view client_id, const char* file, int line,
+                                std::string_view message, bool truncated) {
+    std::lock_guard<std::mutex> lock(direct_mutex);
+    Record record;
+    record.level = level;
+    record.time = std::chrono::system_clock::now();
+    record.thread_id = std::this_thread::get_id();
+    record.file = file;
+    record.line = line;
+    record.client_length = static_cast<uint16_t>(std::min(client_id.size(), sizeof(record.client_id)));
+    std::memcpy(record.client_id, client_id.data(), record.client_length);
+    record.message_length = static_cast<uint16_t>(std::min(message.size(), sizeof(record.message)));
+    std::memcpy(record.message, message.data(), record.message_length);
+    record.truncated = truncated || message.size() > sizeof(record.message);
+    format(record);
+    write_out();
+}
+
+void AsyncBackend::flush() {
+    size_t target = enqueue_pos.load(std::memory_order_acquire);
+    while (!is_stopped() && written.load(std::memory_order_acquire) < target) {
+        wake_cv.notify_one();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void AsyncBackend::shutdown() {
+    if (stopping.exchange(true)) return;
+    wake_cv.notify_one();
+    if (writer.joinable()) writer.join();
+    stopped.store(true, std::memory_order_release);
+}
+
+// 后端不析构：退出时由atexit停止后台线程并写出剩余记录，
+// 之后（包括其他静态对象析构时）的日志改为同步写出
+AsyncBackend& backend() {
+    static AsyncBackend* instance = [] {
+        auto* created = new AsyncBackend();
+        std::atexit([] { backend().shutdown(); });
+        return created;
+    }();
+    return *instance;
+}
+
+} // namespace
+
+struct Logger::Line::Slot {
+    LineBuffer buffer;
+    std::ostream stream{&buffer};
+};
+
+namespace {
+const int kMaxLineDepth = 4;
+thread_local std::unique_ptr<Logger::Line::Slot> line_slots[kMaxLineDepth];
+thread_local int line_depth = 0;
+}
+
+Logger::Line::Line() {
+    int depth = std::min(line_depth, kMaxLineDepth - 1);
+    ++line_depth;
+    if (!line_slots[depth]) {
+        // 每个线程每层只分配一次
+        line_slots[depth] = std::make_unique<Slot>();
+    }
+    slot = line_slots[depth].get();
+    slot->buffer.reset();
+    slot->stream.clear();
+    slot->stream.flags(std::ios_base::dec | std::ios_base::skipws);
+    slot->stream.precision(6);
+    slot->stream.width(0);
+    slot->stream.fill(' ');
+}
+
+Logger::Line::~Line() {
+    --line_depth;
+}
+
+std::ostream& Logger::Line::stream() {
+    return slot->stream;
+}
+
+const Logger::LineBuffer& Logger::Line::buffer() const {
+    return slot->buffer;
+}
+
+void Logger::commit(LogLevel level, std::string_view client_id, const char* file, int line, const Line& message) {
+    const LineBuffer& buffer = message.buffer();
+    AsyncBackend& async = backend();
+    if (async.is_stopped()) {
+        async.write_direct(level, client_id, file, line, buffer.view(), buffer.is_truncated());
+    } else {
+        async.push(level, client_id, file, line, buffer.view(), buffer.is_truncated());
+    }
+}
+
+void Logger::log(LogLevel level, std::string_view client_id, const char* file, int line, std::string_view message) {
+    if (!is_enabled(level)) return;
+    AsyncBackend& async = backend();
+    if (async.is_stopped()) {
+        async.write_direct(level, client_id, file, line, message, false);
+    } else {
+        async.push(level, client_id, file, line, message, false);
+    }
+}
+
+void Logger::flush() {
+    backend().flush();
+}
@@ -0,0 +1,211 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace metrics {
+
+Histogram::Histogram(std::vector<double> upper_bounds)
+    : bounds(std::move(upper_bounds)),
+      buckets(new std::atomic<uint64_t>[bounds.size() + 1]) {
+    for (size_t i = 0; i <= bounds.size(); ++i) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Histogram::observe(double value) {
+    // 桶数很少，线性查找比二分更快
+    size_t index = 0;
+    while (index < bounds.size() && value > bounds[index]) ++index;
+    buckets[index].fetch_add(1, std::memory_order_relaxed);
+
+    double current = sum.load(std::memory_order_relaxed);
+    while (!sum.compare_exchange_weak(current, current + value, std::memory_order_relaxed)) {
+    }
+}
+
+std::vector<double> latency_buckets() {
+    return {0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0};
+}
+
+std::vector<double> backlog_buckets() {
+    return {0.01, 0.05, 0.1, 0.25, 0.5, 1.0, 2.0, 5.0, 10.0};
+}
+
+std::vector<double> lock_wait_buckets() {
+    return {1e-6, 5e-6, 1e-5, 5e-5, 1e-4, 5e-4, 1e-3, 5e-3, 0.01, 0.05};
+}
+
+OccupancyWindow::OccupancyWindow(int slot_ms, int max_window_seconds)
+    : origin(std::chrono::steady_clock::now()),
+      slot_ms(slot_ms),
+      num_slots(static_cast<size_t>(max_window_seconds) * 1000 / slot_ms + 1),
+      slots(new Slot[num_slots]) {}
+
+uint64_t OccupancyWindow::slot_index(std::chrono::steady_clock::time_point now) const {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(now - origin).count() / slot_ms);
+}
+
+void OccupancyWindow::record(std::chrono::steady_clock::time_point now, double busy_fraction, uint64_t queue_length) {
+    uint64_t index = slot_index(now);
+    Slot& slot = slots[index % num_slots];
+    if (slot.index.load(std::memory_order_relaxed) != index) {
+        // 复用旧槽位：先作废索引，读者据此跳过正在重置的槽位
+        slot.index.store(~uint64_t(0), std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.samples.store(0, std::memory_order_relaxed);
+        slot.busy_ppm.store(0, std::memory_order_relaxed);
+        slot.queue_sum.store(0, std::memory_order_relaxed);
+        slot.queue_max.store(0, std::memory_order_relaxed);
+        slot.index.store(index, std::memory_order_release);
+    }
+    slot.samples.fetch_add(1, std::memory_order_relaxed);
+    slot.busy_ppm.fetch_add(static_cast<uint64_t>(busy_fraction * 1e6), std::memory_order_relaxed);
+    slot.queue_sum.fetch_add(queue_length, std::memory_order_relaxed);
+    if (queue_length > slot.queue_max.load(std::memory_order_relaxed)) {
+        slot.queue_max.store(queue_length, std::memory_order_relaxed);
+    }
+}
+
+OccupancyWindow::Summary OccupancyWindow::summarize(std::chrono::steady_clock::time_point now, int window_seconds) const {
+    Summary summary;
+    uint64_t current = slot_index(now);
+    uint64_t count = std::min<uint64_t>(num_slots, static_cast<uint64_t>(window_seconds) * 1000 / slot_ms);
+    uint64_t busy_ppm = 0, queue_sum = 0;
+    for (uint64_t i = 0; i < count && i <= current; ++i) {
+        uint64_t index = current - i;
+        const Slot& slot = slots[index % num_slots];
+        if (slot.index.load(std::memory_order_acquire) != index) continue;
+        uint64_t samples = slot.samples.load(std::memory_order_relaxed);
+        uint64_t busy = slot.busy_ppm.load(std::memory_order_relaxed);
+        uint64_t queue = slot.queue_sum.load(std::memory_order_relaxed);
+        uint64_t queue_max = slot.queue_max.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.index.load(std::memory_order_relaxed) != index) continue;
+        
+        summary.samples += samples;
+        busy_ppm += busy;
+        queue_sum += queue;
+        summary.max_queue = std::max(summary.max_queue, queue_max);
+    }
+    if (summary.samples > 0) {
+        summary.busy_fraction = busy_ppm / 1e6 / summary.samples;
+        summary.average_queue = static_cast<double>(queue_sum) / summary.samples;
+    }
+    return summary;
+}
+
+static std::string format_value(double value) {
+    if (std::isinf(value)) return value > 0 ? "+Inf" : "-Inf";
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+}
+
+void ExpositionWriter::family(const std::string& name, const std::string& help, const std::string& type) {
+    out += "# HELP " + name + " " + help + "\n";
+    out += "# TYPE " + name + " " + type + "\n";
+}
+
+void ExpositionWriter::sample(const std::string& name, const std::string& labels, double value) {
+    out += name;
+    if (!labels.empty()) out += "{" + labels + "}";
+    out += " " + format_value(value) + "\n";
+}
+
+void ExpositionWriter::histogram(const std::string& name, const std::string& labels, const Histogram& histogram) {
+    const std::string prefix = labels.empty() ? "" : labels + ",";
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i <= histogram.bounds.size(); ++i) {
+        cumulative += histogram.buckets[i].load(std::memory_order_relaxed);
+        std::string le = i < histogram.bounds.size() ? format_value(histogram.bounds[i]) : "+Inf";
+        sample(name + "_bucket", prefix + "le=\"" + le + "\"", static_cast<double>(cumulative));
+    }
+    // count取各桶之和，保证与+Inf桶一致
+    sample(name + "_sum", labels, histogram.sum.load(std::memory_order_relaxed));
+    sample(name + "_count", labels, static_cast<double>(cumulative));
+}
+
+} // namespace metrics
+
+ServerMetrics::ServerMetrics()
+    : decode_stage_seconds{metrics::Histogram(metrics::latency_buckets()),
+                           metrics::Histogram(metrics::latency_buckets()),
+                           metrics::Histogram(metrics::latency_buckets()),
+                           metrics::Histogram(metrics::latency_buckets())},
+      queue_lock_wait_seconds(metrics::lock_wait_buckets()),
+      decode_batch_size({1, 2, 4, 8, 16, 32, 64}),
+      decode_queue_wait_seconds{metrics::Histogram(metrics::latency_buckets()),
+                                metrics::Histogram(metrics::latency_buckets()),
+                                metrics::Histogram(metrics::latency_buckets())},
+      partial_latency_seconds(metrics::latency_buckets()),
+      vad_to_final_seconds(metrics::latency_buckets()),
+      session_backlog_seconds(metrics::backlog_buckets()) {}
+
+ServerMetrics& ServerMetrics::instance() {
+    static ServerMetrics metrics;
+    return metrics;
+}
+
+void ServerMetrics::write(metrics::ExpositionWriter& writer) const {
+    static const char* priority_labels[] = {"priority=\"final\"", "priority=\"oneshot\"", "priority=\"partial\""};
+
+    static const char* stage_labels[] = {"stage=\"acquire_wait\"", "stage=\"create_streams\"",
+                                         "stage=\"decode\"", "stage=\"get_results\""};
+
+    writer.family("asr_decode_stage_seconds", "Per-batch time spent waiting for a replica, creating streams, in Decode and extracting results", "histogram");
+    for (size_t i = 0; i < NUM_DECODE_STAGES; ++i) {
+        writer.histogram("asr_decode_stage_seconds", stage_labels[i], decode_stage_seconds[i]);
+    }
+
+    writer.family("asr_decode_queue_lock_wait_seconds", "Time to acquire the decode queue lock when submitting", "histogram");
+    writer.histogram("asr_decode_queue_lock_wait_seconds", "", queue_lock_wait_seconds);
+
+    writer.family("asr_decode_busy_seconds_total", "Replica time spent leased by decode batches", "counter");
+    writer.sample("asr_decode_busy_seconds_total", "", decode_busy_microseconds.get() / 1e6);
+
+    writer.family("asr_decode_batch_size", "Number of requests decoded together", "histogram");
+    writer.histogram("asr_decode_batch_size", "", decode_batch_size);
+
+    writer.family("asr_decode_queue_wait_seconds", "Time from enqueue to start of decode", "histogram");
+    for (size_t i = 0; i < 3; ++i) {
+        writer.histogram("asr_decode_queue_wait_seconds", priority_labels[i], decode_queue_wait_seconds[i]);
+    }
+
+    writer.family("asr_partial_decode_seconds", "Time from partial request enqueue to decoded result", "histogram");
+    writer.histogram("asr_partial_decode_seconds", "", partial_latency_seconds);
+
+    writer.family("asr_vad_to_final_seconds", "Time from VAD end-of-segment to final result sent", "histogram");
+    writer.histogram("asr_vad_to_final_seconds", "", vad_to_final_seconds);
+
+    writer.family("asr_session_backlog_seconds", "Unprocessed audio per streaming session when its processing task starts", "histogram");
+    writer.histogram("asr_session_backlog_seconds", "", session_backlog_seconds);
+
+    writer.family("asr_frames_received_total", "Binary audio frames received", "counter");
+    writer.sample("asr_frames_received_total", "", static_cast<double>(frames_received.get()));
+
+    writer.family("asr_bytes_received_total", "Audio payload bytes received", "counter");
+    writer.sample("asr_bytes_received_total", "", static_cast<double>(bytes_received.get()));
+
+    writer.family("asr_samples_dropped_total", "Audio samples dropped because a session buffer was full", "counter");
+    writer.sample("asr_samples_dropped_total", "", static_cast<double>(samples_dropped.get()));
+
+    writer.family("asr_final_samples_truncated_total", "Speech segment samples missing from final results because they had left the session buffer", "counter");
+    writer.sample("asr_final_samples_truncated_total", "", static_cast<double>(final_samples_truncated.get()));
+
+    static const char* overflow_labels[] = {"action=\"drop_oldest\"", "action=\"reject\"", "action=\"close\""};
+    writer.family("asr_audio_overflow_total", "Audio frames that exceeded a session or global buffer budget, by action taken", "counter");
+    for (size_t i = 0; i < 3; ++i) {
+        writer.sample("asr_audio_overflow_total", overflow_labels[i], static_cast<double>(audio_overflow_events[i].get()));
+    }
+
+    writer.family("asr_segments_total", "Speech segments detected by VAD", "counter");
+    writer.sample("asr_segments_total", "", static_cast<double>(segments_detected.get()));
+
+    writer.family("asr_results_sent_total", "Recognition results sent to clients", "counter");
+    writer.sample("asr_results_sent_total", "type=\"partial\"", static_cast<double>(partial_results_sent.get()));
+    writer.sample("asr_results_sent_total", "type=\"final\"", static_cast<double>(final_results_sent.get()));
+    writer.sample("asr_results_sent_total", "type=\"oneshot\"", static_cast<double>(oneshot_results_sent.get()));
+    writer.sample("asr_results_sent_total", "type=\"http\"", static_cast<double>(http_results_sent.get()));
+}
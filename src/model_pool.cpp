@@ -1,11 +1,108 @@
 #include "model_pool.h"
 #include "server_config.h"
 #include "logger.h"
+#include "metrics.h"
+#include <cctype>
 #include <chrono>
 #include <exception>
 
 using namespace sherpa_onnx::cxx;
 
+void append_recognition(RecognitionResult& dst, RecognitionResult&& src, float offset_seconds) {
+    if (!dst.text.empty() && !src.text.empty() &&
+        std::isalnum(static_cast<unsigned char>(dst.text.back())) &&
+        std::isalnum(static_cast<unsigned char>(src.text.front()))) {
+        dst.text += ' ';
+    }
+    dst.text += src.text;
+    
+    for (float timestamp : src.timestamps) {
+        dst.timestamps.push_back(timestamp + offset_seconds);
+    }
+    dst.tokens.insert(dst.tokens.end(), 
+                      std::make_move_iterator(src.tokens.begin()), 
+                      std::make_move_iterator(src.tokens.end()));
+    
+    if (!src.language.empty()) dst.language = std::move(src.language);
+    if (!src.emotion.empty()) dst.emotion = std::move(src.emotion);
+    if (!src.event.empty()) dst.event = std::move(src.event);
+}
+
+// SegmentedDecode 实现
+SegmentedDecode::SegmentedDecode(SharedASREngine* asr, DecodePriority decode_priority, uint32_t fields,
+                                 JoinCallback callback)
+    : shared_asr(asr), priority(decode_priority), result_fields(fields), on_joined(std::move(callback)) {}
+
+void SegmentedDecode::submit(std::vector<float> samples, float offset_seconds) {
+    size_t index;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        index = results.size();
+        results.emplace_back();
+        offsets.push_back(offset_seconds);
+    }
+    
+    // 回调持有本对象，直到所有已提交的段完成
+    auto self = shared_from_this();
+    try {
+        shared_asr->submit_async(std::move(samples), priority,
+            [self, index](RecognitionResult result) {
+                self->complete_segment(index, std::move(result));
+            }, "", result_fields);
+    } catch (const std::exception& e) {
+        LOG_ERROR("SHARED_ASR", "Failed to submit speech segment: " << e.what());
+        complete_segment(index, RecognitionResult{});
+    }
+}
+
+void SegmentedDecode::complete_segment(size_t index, RecognitionResult result) {
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        results[index] = std::move(result);
+        ++completed;
+        done = sealed && completed == results.size();
+    }
+    if (done) join();
+}
+
+void SegmentedDecode::seal() {
+    bool done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        sealed = true;
+        done = completed == results.size();
+    }
+    if (done) join();
+}
+
+size_t SegmentedDecode::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return results.size();
+}
+
+void SegmentedDecode::join() {
+    if (cancelled.load()) return;
+    
+    RecognitionResult joined;
+    size_t failed = 0;
+    size_t total;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        total = results.size();
+        for (size_t i = 0; i < total; ++i) {
+            RecognitionResult& part = results[i];
+            if (!part.ok) {
+                ++failed;
+                continue;
+            }
+            append_recognition(joined, std::move(part), offsets[i]);
+        }
+    }
+    joined.ok = failed == 0;
+    on_joined(std::move(joined), failed, total);
+}
+
 // VADModelPool 实现
 VADModelPool::VADModelPool() {}
 
@@ -83,20 +180,19 @@ bool VADModelPool::is_initialized() const {
 }
 
 // ModelManager 实现 - 向后兼容的接口
-ModelManager::ModelManager([[maybe_unused]] int asr_pool_size) {
-    // asr_pool_size 参数保留但不使用，因为现在使用共享ASR
-    shared_asr = std::make_unique<SharedASREngine>();
+ModelManager::ModelManager(ModelPoolManager* manager) : pool_manager(manager) {
     vad_pool = std::make_unique<VADModelPool>();
 }
 
 ModelManager::~ModelManager() {}
 
 bool ModelManager::initialize(const std::string& model_dir, const ServerConfig& config) {
-    LOG_INFO("MODEL_MANAGER", "Initializing legacy model manager (using shared ASR)");
+    LOG_INFO("MODEL_MANAGER", "Initializing legacy model manager (using shared recognizer pool)");
     
-    // 初始化共享ASR引擎
-    if (!shared_asr->initialize(model_dir, config)) {
-        LOG_ERROR("MODEL_MANAGER", "Failed to initialize shared ASR engine");
+    // 复用ModelPoolManager已加载的识别器副本
+    if (!pool_manager || !pool_manager->get_recognizer_pool() || 
+        !pool_manager->get_recognizer_pool()->is_initialized()) {
+        LOG_ERROR("MODEL_MANAGER", "Recognizer pool not available");
         return false;
     }
     
@@ -111,25 +207,32 @@ bool ModelManager::initialize(const std::string& model_dir, const ServerConfig&
     return true;
 }
 
-int ModelManager::acquire_asr_recognizer([[maybe_unused]] int timeout_ms) {
+int ModelManager::acquire_asr_recognizer(int timeout_ms) {
     if (!initialized.load()) {
         LOG_ERROR("MODEL_MANAGER", "Model manager not initialized");
         return -1;
     }
     
-    // 在共享模式下，总是返回固定ID 0，表示可以使用共享引擎
-    if (shared_asr && shared_asr->is_initialized()) {
-        LOG_DEBUG("MODEL_MANAGER", "Acquired shared ASR engine (ID: 0)");
-        return 0;
+    auto lease = pool_manager->get_recognizer_pool()->acquire(std::chrono::milliseconds(timeout_ms));
+    if (!lease) {
+        LOG_ERROR("MODEL_MANAGER", "Timeout acquiring ASR recognizer");
+        return -1;
     }
     
-    LOG_ERROR("MODEL_MANAGER", "Shared ASR engine not available");
-    return -1;
+    int instance_id = lease.id();
+    std::lock_guard<std::mutex> lock(leases_mutex);
+    leases[instance_id] = std::move(lease);
+    LOG_DEBUG("MODEL_MANAGER", "Acquired ASR recognizer (ID: " << instance_id << ")");
+    return instance_id;
 }
 
 void ModelManager::release_asr_recognizer(int instance_id) {
-    // 在共享模式下，释放操作是空操作
-    LOG_DEBUG("MODEL_MANAGER", "Released shared ASR engine (ID: " << instance_id << ")");
+    std::lock_guard<std::mutex> lock(leases_mutex);
+    if (leases.erase(instance_id) > 0) {
+        LOG_DEBUG("MODEL_MANAGER", "Released ASR recognizer (ID: " << instance_id << ")");
+    } else {
+        LOG_WARN("MODEL_MANAGER", "Release of unknown ASR recognizer (ID: " << instance_id << ")");
+    }
 }
 
 std::unique_ptr<VoiceActivityDetector> ModelManager::create_vad_instance() const {
@@ -142,8 +245,8 @@ std::unique_ptr<VoiceActivityDetector> ModelManager::create_vad_instance() const
 }
 
 float ModelManager::get_sample_rate() const {
-    if (shared_asr) {
-        return shared_asr->get_sample_rate();
+    if (pool_manager && pool_manager->get_asr_engine()) {
+        return pool_manager->get_asr_engine()->get_sample_rate();
     }
     return 16000; // 默认值
 }
@@ -155,33 +258,56 @@ bool ModelManager::is_initialized() const {
 ModelManager::LegacyStats ModelManager::get_asr_pool_stats() const {
     LegacyStats stats;
     if (initialized.load()) {
-        // 共享ASR模式下的统计信息
-        stats.total_instances = 1;
-        stats.available_instances = 1;
-        stats.in_use_instances = shared_asr ? shared_asr->get_active_recognitions() : 0;
+        RecognizerPool* pool = pool_manager->get_recognizer_pool();
+        stats.total_instances = pool->get_total_instances();
+        stats.available_instances = pool->get_available_instances();
+        stats.in_use_instances = pool->get_in_use_instances();
     }
     
     return stats;
 }
 
-// SharedASREngine 实现 - 共享ASR引擎，支持多客户端并发访问
-SharedASREngine::SharedASREngine() {}
+// RecognizerPool 实现 - ASR识别器副本的租借与归还
+RecognizerPool::Lease& RecognizerPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        reset();
+        pool = other.pool;
+        replica_id = other.replica_id;
+        other.pool = nullptr;
+        other.replica_id = -1;
+    }
+    return *this;
+}
 
-SharedASREngine::~SharedASREngine() {}
+const OfflineRecognizer* RecognizerPool::Lease::get() const {
+    return pool ? pool->replicas[replica_id].get() : nullptr;
+}
 
-bool SharedASREngine::initialize(const std::string& model_dir, const ServerConfig& config) {
-    std::lock_guard<std::mutex> lock(engine_mutex);
+void RecognizerPool::Lease::reset() {
+    if (pool) {
+        pool->release(replica_id);
+        pool = nullptr;
+        replica_id = -1;
+    }
+}
+
+RecognizerPool::RecognizerPool() {}
+
+RecognizerPool::~RecognizerPool() {}
+
+bool RecognizerPool::initialize(const std::string& model_dir, const ServerConfig& config) {
+    std::lock_guard<std::mutex> lock(pool_mutex);
     
     if (initialized.load()) {
-        LOG_WARN("SHARED_ASR", "Shared ASR engine already initialized");
+        LOG_WARN("ASR_POOL", "Recognizer pool already initialized");
         return true;
     }
     
-    model_directory = model_dir;
     const auto& asr_config = config.get_asr_config();
+    acquire_timeout = std::chrono::milliseconds(asr_config.acquire_timeout_ms);
+    share_weights = asr_config.share_weights;
     
     try {
-        // 配置共享ASR
         OfflineRecognizerConfig recognizer_config;
         recognizer_config.model_config.sense_voice.model = 
             model_dir + "/" + asr_config.model_name + "/model.onnx";
@@ -189,212 +315,453 @@ bool SharedASREngine::initialize(const std::string& model_dir, const ServerConfi
         recognizer_config.model_config.sense_voice.language = asr_config.language;
         recognizer_config.model_config.tokens = 
             model_dir + "/" + asr_config.model_name + "/tokens.txt";
-        
-        // 使用所有可用线程，因为是共享的
         recognizer_config.model_config.num_threads = asr_config.num_threads;
         recognizer_config.model_config.debug = asr_config.debug;
         
-        LOG_INFO("SHARED_ASR", "Creating shared ASR engine with " 
-                 << recognizer_config.model_config.num_threads << " threads");
+        LOG_INFO("ASR_POOL", "Creating " << asr_config.pool_size << " ASR replicas with " 
+                 << asr_config.num_threads << " threads each (shared weights: " 
+                 << (share_weights ? "yes" : "no") << ")");
         
-        auto recognizer_obj = OfflineRecognizer::Create(recognizer_config);
-        if (!recognizer_obj.Get()) {
-            LOG_ERROR("SHARED_ASR", "Failed to create shared ASR engine");
-            return false;
+        std::shared_ptr<OfflineRecognizer> shared_recognizer;
+        for (int i = 0; i < asr_config.pool_size; ++i) {
+            if (!share_weights || !shared_recognizer) {
+                auto recognizer_obj = OfflineRecognizer::Create(recognizer_config);
+                if (!recognizer_obj.Get()) {
+                    LOG_ERROR("ASR_POOL", "Failed to create ASR replica " << i);
+                    replicas.clear();
+                    return false;
+                }
+                shared_recognizer = std::make_shared<OfflineRecognizer>(std::move(recognizer_obj));
+            }
+            replicas.push_back(shared_recognizer);
+            free_replicas.push_back(i);
         }
         
-        recognizer = std::make_unique<OfflineRecognizer>(std::move(recognizer_obj));
-        sample_rate = 16000; // 设置采样率
-        
-        LOG_INFO("SHARED_ASR", "Shared ASR engine initialized successfully");
+        LOG_INFO("ASR_POOL", "Recognizer pool initialized with " << replicas.size() << " replicas");
+        total_count = replicas.size();
         initialized = true;
         return true;
         
     } catch (const std::exception& e) {
-        LOG_ERROR("SHARED_ASR", "Error initializing shared ASR engine: " << e.what());
+        LOG_ERROR("ASR_POOL", "Error initializing recognizer pool: " << e.what());
+        replicas.clear();
+        free_replicas.clear();
         return false;
     }
 }
 
-std::string SharedASREngine::recognize(const float* samples, size_t sample_count) {
-    if (!initialized.load()) {
-        LOG_ERROR("SHARED_ASR", "Shared ASR engine not initialized");
-        return "";
+RecognizerPool::Lease RecognizerPool::acquire(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(pool_mutex);
+    
+    if (!pool_cv.wait_for(lock, timeout, [this] { return !free_replicas.empty(); })) {
+        acquire_timeouts++;
+        LOG_WARN("ASR_POOL", "Timeout waiting for available ASR replica");
+        return Lease();
     }
     
-    // 线程安全的识别
+    int replica_id = free_replicas.back();
+    free_replicas.pop_back();
+    in_use_count.fetch_add(1, std::memory_order_relaxed);
+    return Lease(this, replica_id);
+}
+
+void RecognizerPool::release(int replica_id) {
+    {
+        std::lock_guard<std::mutex> lock(pool_mutex);
+        free_replicas.push_back(replica_id);
+        in_use_count.fetch_sub(1, std::memory_order_relaxed);
+    }
+    pool_cv.notify_one();
+}
+
+// 状态查询只读原子计数，不与解码线程争用pool_mutex
+size_t RecognizerPool::get_total_instances() const {
+    return total_count.load(std::memory_order_relaxed);
+}
+
+size_t RecognizerPool::get_available_instances() const {
+    return get_total_instances() - get_in_use_instances();
+}
+
+size_t RecognizerPool::get_in_use_instances() const {
+    return in_use_count.load(std::memory_order_relaxed);
+}
+
+// SharedASREngine 实现 - 共享ASR引擎，跨会话动态批处理解码
+SharedASREngine::SharedASREngine() {}
+
+SharedASREngine::~SharedASREngine() {
+    shutdown();
+}
+
+bool SharedASREngine::initialize(RecognizerPool* pool, const ServerConfig& config) {
     std::lock_guard<std::mutex> lock(engine_mutex);
-    active_recognitions++;
     
-    try {
-        OfflineStream stream = recognizer->CreateStream();
-        stream.AcceptWaveform(sample_rate, samples, sample_count);
-        recognizer->Decode(&stream);
-        
-        OfflineRecognizerResult result = recognizer->GetResult(&stream);
-        active_recognitions--;
-        
-        return result.text;
-        
-    } catch (const std::exception& e) {
+    if (initialized.load()) {
+        LOG_WARN("SHARED_ASR", "Shared ASR engine already initialized");
+        return true;
+    }
+    
+    if (!pool || !pool->is_initialized()) {
+        LOG_ERROR("SHARED_ASR", "Recognizer pool not initialized");
+        return false;
+    }
+    
+    recognizer_pool = pool;
+    sample_rate = 16000; // 设置采样率
+    
+    // 每个识别器副本启动一个批处理调度线程
+    const auto& asr_config = config.get_asr_config();
+    max_batch_size = static_cast<size_t>(asr_config.batch_size);
+    batch_timeout = std::chrono::milliseconds(asr_config.batch_timeout_ms);
+    running = true;
+    size_t num_dispatchers = recognizer_pool->get_total_instances();
+    for (size_t i = 0; i < num_dispatchers; ++i) {
+        dispatcher_threads.emplace_back(&SharedASREngine::dispatch_loop, this);
+    }
+    sampler_thread = std::thread(&SharedASREngine::sample_loop, this);
+    
+    LOG_INFO("SHARED_ASR", "Shared ASR engine initialized successfully (dispatchers: " << num_dispatchers
+             << ", batch size: " << max_batch_size << ", batch timeout: " << batch_timeout.count() << "ms)");
+    initialized = true;
+    return true;
+}
+
+void SharedASREngine::DecodeRequest::complete(RecognitionResult result) {
+    if (callback) {
+        try {
+            callback(std::move(result));
+        } catch (const std::exception& e) {
+            LOG_ERROR("SHARED_ASR", "Error in recognition callback: " << e.what());
+        }
+    } else {
+        promise.set_value(std::move(result));
+    }
+}
+
+void SharedASREngine::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        if (!running.exchange(false)) {
+            return;
+        }
+    }
+    queue_cv.notify_all();
+    for (auto& thread : dispatcher_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    dispatcher_threads.clear();
+    if (sampler_thread.joinable()) {
+        sampler_thread.join();
+    }
+    
+    // 未处理的请求返回失败结果，避免调用方永久阻塞；回调可能再次提交请求，解锁后再执行
+    std::vector<std::unique_ptr<DecodeRequest>> abandoned;
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        for (auto& queue : pending_requests) {
+            for (auto& request : queue) {
+                abandoned.push_back(std::move(request));
+            }
+            queue.clear();
+        }
+        pending_partials.clear();
+        pending_count = 0;
+    }
+    for (auto& request : abandoned) {
+        request->complete(RecognitionResult{});
         active_recognitions--;
-        LOG_ERROR("SHARED_ASR", "Error in recognition: " << e.what());
-        return "";
     }
 }
 
-std::string SharedASREngine::recognize_with_metadata(const float* samples, size_t sample_count, 
-                                                   std::string& language, std::string& emotion, 
-                                                   std::string& event, std::vector<float>& timestamps, std::vector<std::string>& tokens) {
+void SharedASREngine::enqueue(std::unique_ptr<DecodeRequest> request) {
     if (!initialized.load()) {
         LOG_ERROR("SHARED_ASR", "Shared ASR engine not initialized");
-        return "";
+        request->complete(RecognitionResult{});
+        return;
     }
     
-    // 线程安全的识别
-    std::lock_guard<std::mutex> lock(engine_mutex);
-    active_recognitions++;
-    
-    try {
-        OfflineStream stream = recognizer->CreateStream();
-        stream.AcceptWaveform(sample_rate, samples, sample_count);
-        recognizer->Decode(&stream);
-        
-        OfflineRecognizerResult result = recognizer->GetResult(&stream);
-        active_recognitions--;
-        
-        language = result.lang;
-        emotion = result.emotion;
-        event = result.event;
-        timestamps = result.timestamps;
-        tokens = result.tokens;
-        
-        return result.text;
+    request->enqueue_time = std::chrono::steady_clock::now();
+    std::unique_ptr<DecodeRequest> superseded;
+    std::unique_ptr<DecodeRequest> rejected;
+    {
+        std::unique_lock<std::mutex> lock(queue_mutex, std::defer_lock);
+        auto lock_start = std::chrono::steady_clock::now();
+        lock.lock();
+        ServerMetrics::instance().queue_lock_wait_seconds.observe_since(lock_start);
+        if (!running.load()) {
+            rejected = std::move(request);
+        } else if (!request->coalesce_key.empty()) {
+            // 同一会话尚未开始解码的部分识别请求直接在队列中原位替换。新请求沿用被替换请求的
+            // 入队时间：它占据的是原来的队列位置，组批超时和排队时间都应从原请求入队时算起
+            auto it = pending_partials.find(request->coalesce_key);
+            if (it != pending_partials.end()) {
+                request->enqueue_time = it->second->enqueue_time;
+                superseded = std::make_unique<DecodeRequest>(std::move(*it->second));
+                *it->second = std::move(*request);
+            } else {
+                pending_partials[request->coalesce_key] = request.get();
+            }
+        }
         
-    } catch (const std::exception& e) {
-        active_recognitions--;
-        LOG_ERROR("SHARED_ASR", "Error in recognition with metadata: " << e.what());
-        return "";
+        if (request && !superseded) {
+            pending_requests[static_cast<size_t>(request->priority)].push_back(std::move(request));
+            pending_count++;
+            active_recognitions++;
+        }
+    }
+    
+    // 回调是调用方的任意代码，可能再次提交请求，只在释放queue_mutex后执行
+    if (rejected) {
+        rejected->complete(RecognitionResult{});
+    } else if (superseded) {
+        superseded_requests++;
+        RecognitionResult result;
+        result.superseded = true;
+        superseded->complete(std::move(result));
+        LOG_DEBUG("SHARED_ASR", "Superseded pending request for " << superseded->coalesce_key);
+    } else {
+        queue_cv.notify_one();
     }
 }
 
-// VADPool 实现 - 动态VAD池管理
-VADPool::VADPool(const std::string& model_dir, const ServerConfig& config) 
-    : model_directory(model_dir), max_instances(20), min_instances(2) {
-    
-    const auto& vad_config_params = config.get_vad_config();
-    
-    // 配置VAD
-    vad_config.silero_vad.model = model_dir + "/silero_vad/silero_vad.onnx";
-    vad_config.silero_vad.threshold = vad_config_params.threshold;
-    vad_config.silero_vad.min_silence_duration = vad_config_params.min_silence_duration;
-    vad_config.silero_vad.min_speech_duration = vad_config_params.min_speech_duration;
-    vad_config.silero_vad.max_speech_duration = vad_config_params.max_speech_duration;
-    vad_config.sample_rate = vad_config_params.sample_rate;
-    sample_rate = vad_config_params.sample_rate;
+std::future<RecognitionResult> SharedASREngine::submit(const float* samples, size_t sample_count,
+                                                       DecodePriority priority) {
+    auto request = std::make_unique<DecodeRequest>();
+    request->samples = samples;
+    request->sample_count = sample_count;
+    request->priority = priority;
+    auto future = request->promise.get_future();
+    enqueue(std::move(request));
+    return future;
 }
 
-VADPool::~VADPool() {
-    std::lock_guard<std::mutex> lock(pool_mutex);
-    while (!vad_pool.empty()) {
-        vad_pool.pop();
+std::future<RecognitionResult> SharedASREngine::submit(std::vector<float> samples, 
+                                                       DecodePriority priority) {
+    auto request = std::make_unique<DecodeRequest>();
+    request->owned_samples = std::move(samples);
+    request->samples = request->owned_samples.data();
+    request->sample_count = request->owned_samples.size();
+    request->priority = priority;
+    auto future = request->promise.get_future();
+    enqueue(std::move(request));
+    return future;
+}
+
+void SharedASREngine::submit_async(std::vector<float> samples, DecodePriority priority,
+                                   ResultCallback callback, const std::string& coalesce_key,
+                                   uint32_t result_fields) {
+    auto request = std::make_unique<DecodeRequest>();
+    request->owned_samples = std::move(samples);
+    request->samples = request->owned_samples.data();
+    request->sample_count = request->owned_samples.size();
+    request->priority = priority;
+    request->coalesce_key = coalesce_key;
+    request->callback = std::move(callback);
+    request->result_fields = result_fields;
+    enqueue(std::move(request));
+}
+
+std::chrono::steady_clock::time_point SharedASREngine::oldest_enqueue_time() const {
+    auto oldest = std::chrono::steady_clock::time_point::max();
+    for (const auto& queue : pending_requests) {
+        if (!queue.empty() && queue.front()->enqueue_time < oldest) {
+            oldest = queue.front()->enqueue_time;
+        }
     }
+    return oldest;
 }
 
-std::unique_ptr<VoiceActivityDetector> VADPool::create_vad_instance() {
-    try {
-        auto vad_obj = VoiceActivityDetector::Create(vad_config, 100); // window_size = 100
-        if (!vad_obj.Get()) {
-            LOG_ERROR("VAD_POOL", "Failed to create VAD instance");
-            return nullptr;
+void SharedASREngine::dispatch_loop() {
+    std::vector<std::unique_ptr<DecodeRequest>> batch;
+    batch.reserve(max_batch_size);
+    
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this] { return pending_count > 0 || !running; });
+            if (!running) break;
+            
+            // 批处理窗口：从最早请求入队开始计时，凑满batch或超时即出发
+            auto deadline = oldest_enqueue_time() + batch_timeout;
+            queue_cv.wait_until(lock, deadline, [this] {
+                return pending_count >= max_batch_size || !running;
+            });
+            if (!running) break;
+            
+            // 按优先级从高到低组批
+            for (auto& queue : pending_requests) {
+                while (!queue.empty() && batch.size() < max_batch_size) {
+                    auto& request = queue.front();
+                    if (!request->coalesce_key.empty()) {
+                        pending_partials.erase(request->coalesce_key);
+                    }
+                    batch.push_back(std::move(request));
+                    queue.pop_front();
+                    pending_count--;
+                }
+            }
         }
         
-        return std::make_unique<VoiceActivityDetector>(std::move(vad_obj));
-        
-    } catch (const std::exception& e) {
-        LOG_ERROR("VAD_POOL", "Error creating VAD instance: " << e.what());
-        return nullptr;
+        decode_batch(batch);
+        batch.clear();
     }
 }
 
-std::unique_ptr<VoiceActivityDetector> VADPool::acquire(std::chrono::milliseconds timeout) {
-    std::unique_lock<std::mutex> lock(pool_mutex);
-    
-    // 如果池中有可用实例，直接返回
-    if (!vad_pool.empty()) {
-        auto vad = std::move(vad_pool.front());
-        vad_pool.pop();
-        available_instances--;
-        LOG_DEBUG("VAD_POOL", "Acquired VAD from pool, available: " << available_instances.load());
-        return vad;
-    }
-    
-    // 如果没达到最大实例数，创建新实例
-    if (total_instances.load() < max_instances) {
-        lock.unlock();
-        auto vad = create_vad_instance();
-        if (vad) {
-            total_instances++;
-            LOG_DEBUG("VAD_POOL", "Created new VAD instance, total: " << total_instances.load());
-            return vad;
+void SharedASREngine::decode_batch(std::vector<std::unique_ptr<DecodeRequest>>& batch) {
+    if (batch.empty()) return;
+    
+    std::vector<RecognitionResult> results(batch.size());
+    ServerMetrics& metrics = ServerMetrics::instance();
+    
+    // 租借一个识别器副本，超时则整批返回失败
+    auto acquire_start = std::chrono::steady_clock::now();
+    auto recognizer = recognizer_pool->acquire();
+    auto decode_start = std::chrono::steady_clock::now();
+    metrics.decode_stage_seconds[ServerMetrics::ACQUIRE_WAIT].observe(
+        std::chrono::duration<double>(decode_start - acquire_start).count());
+    if (!recognizer) {
+        LOG_ERROR("SHARED_ASR", "No ASR replica available, failing batch of " << batch.size());
+        for (auto& request : batch) {
+            request->complete(RecognitionResult{});
+            active_recognitions--;
         }
-        lock.lock();
+        return;
     }
     
-    // 等待可用实例
-    if (pool_cv.wait_for(lock, timeout, [this] { return !vad_pool.empty(); })) {
-        auto vad = std::move(vad_pool.front());
-        vad_pool.pop();
-        available_instances--;
-        LOG_DEBUG("VAD_POOL", "Acquired VAD after wait, available: " << available_instances.load());
-        return vad;
+    for (const auto& request : batch) {
+        metrics.decode_queue_wait_seconds[static_cast<size_t>(request->priority)].observe(
+            std::chrono::duration<double>(decode_start - request->enqueue_time).count());
     }
+    metrics.decode_batch_size.observe(static_cast<double>(batch.size()));
     
-    LOG_WARN("VAD_POOL", "Timeout waiting for available VAD instance");
-    return nullptr;
-}
-
-void VADPool::release(std::unique_ptr<VoiceActivityDetector> vad) {
-    if (!vad) return;
-    
-    std::lock_guard<std::mutex> lock(pool_mutex);
+    try {
+        std::vector<OfflineStream> streams;
+        streams.reserve(batch.size());
+        for (const auto& request : batch) {
+            OfflineStream stream = recognizer->CreateStream();
+            stream.AcceptWaveform(sample_rate, request->samples, 
+                                  static_cast<int32_t>(request->sample_count));
+            streams.push_back(std::move(stream));
+        }
+        
+        auto decode_call_start = std::chrono::steady_clock::now();
+        metrics.decode_stage_seconds[ServerMetrics::CREATE_STREAMS].observe(
+            std::chrono::duration<double>(decode_call_start - decode_start).count());
+        recognizer->Decode(streams.data(), static_cast<int32_t>(streams.size()));
+        auto results_start = std::chrono::steady_clock::now();
+        metrics.decode_stage_seconds[ServerMetrics::DECODE].observe(
+            std::chrono::duration<double>(results_start - decode_call_start).count());
+        
+        for (size_t i = 0; i < streams.size(); ++i) {
+            OfflineRecognizerResult result = recognizer->GetResult(&streams[i]);
+            const uint32_t fields = batch[i]->result_fields;
+            results[i].ok = true;
+            results[i].text = std::move(result.text);
+            if (fields & RESULT_FIELD_LANG) results[i].language = std::move(result.lang);
+            if (fields & RESULT_FIELD_EMOTION) results[i].emotion = std::move(result.emotion);
+            if (fields & RESULT_FIELD_EVENT) results[i].event = std::move(result.event);
+            if (fields & RESULT_FIELD_TIMESTAMPS) results[i].timestamps = std::move(result.timestamps);
+            if (fields & RESULT_FIELD_TOKENS) results[i].tokens = std::move(result.tokens);
+        }
+        metrics.decode_stage_seconds[ServerMetrics::GET_RESULTS].observe_since(results_start);
+        
+        total_batches++;
+        total_batched_requests += batch.size();
+        LOG_DEBUG("SHARED_ASR", "Decoded batch of " << batch.size() << " streams on replica " << recognizer.id());
+        
+    } catch (const std::exception& e) {
+        LOG_ERROR("SHARED_ASR", "Error in batch recognition: " << e.what());
+        results.assign(batch.size(), RecognitionResult{});
+    }
     
-    // 如果池满了，直接丢弃实例
-    if (vad_pool.size() >= max_instances) {
-        total_instances--;
-        LOG_DEBUG("VAD_POOL", "Pool full, discarding VAD instance, total: " << total_instances.load());
-        return;
+    // 尽早归还副本，再唤醒调用方
+    recognizer.reset();
+    
+    auto decode_end = std::chrono::steady_clock::now();
+    uint64_t busy_us = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(decode_end - decode_start).count());
+    metrics.decode_busy_microseconds.inc(busy_us);
+    uint64_t previous_us = batch_duration_ewma_us.load(std::memory_order_relaxed);
+    batch_duration_ewma_us.store(previous_us == 0 ? busy_us : (previous_us * 7 + busy_us) / 8,
+                                 std::memory_order_relaxed);
+    for (size_t i = 0; i < batch.size(); ++i) {
+        if (batch[i]->priority == DecodePriority::PARTIAL) {
+            metrics.partial_latency_seconds.observe(
+                std::chrono::duration<double>(decode_end - batch[i]->enqueue_time).count());
+        }
+        results[i].decode_start = decode_start;
+        results[i].decode_end = decode_end;
+        results[i].batch_size = batch.size();
+        batch[i]->complete(std::move(results[i]));
+        active_recognitions--;
     }
+}
+
+std::string SharedASREngine::recognize(const float* samples, size_t sample_count) {
+    return submit(samples, sample_count).get().text;
+}
+
+std::string SharedASREngine::recognize_with_metadata(const float* samples, size_t sample_count, 
+                                                   std::string& language, std::string& emotion, 
+                                                   std::string& event, std::vector<float>& timestamps, std::vector<std::string>& tokens) {
+    RecognitionResult result = submit(samples, sample_count).get();
     
-    vad_pool.push(std::move(vad));
-    available_instances++;
-    LOG_DEBUG("VAD_POOL", "Released VAD to pool, available: " << available_instances.load());
+    language = std::move(result.language);
+    emotion = std::move(result.emotion);
+    event = std::move(result.event);
+    timestamps = std::move(result.timestamps);
+    tokens = std::move(result.tokens);
     
-    pool_cv.notify_one();
+    return result.text;
 }
 
-bool VADPool::initialize() {
-    // 预热池 - 创建最小数量的实例
-    for (size_t i = 0; i < min_instances; ++i) {
-        auto vad = create_vad_instance();
-        if (!vad) {
-            LOG_ERROR("VAD_POOL", "Failed to create initial VAD instance " << i);
-            return false;
-        }
-        
-        std::lock_guard<std::mutex> lock(pool_mutex);
-        vad_pool.push(std::move(vad));
-        total_instances++;
-        available_instances++;
+size_t SharedASREngine::get_queue_length() const {
+    return pending_count.load(std::memory_order_relaxed);
+}
+
+size_t SharedASREngine::get_queue_length(DecodePriority priority) const {
+    std::lock_guard<std::mutex> lock(queue_mutex);
+    return pending_requests[static_cast<size_t>(priority)].size();
+}
+
+void SharedASREngine::sample_loop() {
+    while (running.load()) {
+        auto now = std::chrono::steady_clock::now();
+        size_t total = recognizer_pool->get_total_instances();
+        double busy = total > 0 ? static_cast<double>(recognizer_pool->get_in_use_instances()) / total : 0.0;
+        occupancy.record(now, busy, pending_count.load(std::memory_order_relaxed));
+        std::this_thread::sleep_until(now + sample_interval);
     }
+}
+
+metrics::OccupancyWindow::Summary SharedASREngine::get_occupancy(int window_seconds) const {
+    return occupancy.summarize(std::chrono::steady_clock::now(), window_seconds);
+}
+
+double SharedASREngine::estimate_backlog_seconds() const {
+    size_t pending = pending_count.load(std::memory_order_relaxed);
+    size_t replicas = recognizer_pool ? recognizer_pool->get_total_instances() : 0;
+    if (pending == 0 || replicas == 0) return 0.0;
     
-    LOG_INFO("VAD_POOL", "VAD pool initialized with " << min_instances << " instances");
-    return true;
+    size_t batches = (pending + max_batch_size - 1) / max_batch_size;
+    size_t rounds = (batches + replicas - 1) / replicas;
+    return rounds * batch_duration_ewma_us.load(std::memory_order_relaxed) / 1e6;
+}
+
+float SharedASREngine::get_average_batch_size() const {
+    size_t batches = total_batches.load();
+    if (batches == 0) return 0.0f;
+    return static_cast<float>(total_batched_requests.load()) / batches;
 }
 
 // ModelPoolManager 实现 - 统一管理ASR和VAD资源
 ModelPoolManager::ModelPoolManager() {
+    recognizer_pool = std::make_unique<RecognizerPool>();
     asr_engine = std::make_unique<SharedASREngine>();
+    vad_service = std::make_unique<VADService>();
 }
 
 ModelPoolManager::~ModelPoolManager() {}
@@ -402,16 +769,21 @@ ModelPoolManager::~ModelPoolManager() {}
 bool ModelPoolManager::initialize(const std::string& model_dir, const ServerConfig& config) {
     LOG_INFO("MODEL_POOL_MANAGER", "Initializing model pool manager");
     
+    // 加载ASR识别器副本
+    if (!recognizer_pool->initialize(model_dir, config)) {
+        LOG_ERROR("MODEL_POOL_MANAGER", "Failed to initialize recognizer pool");
+        return false;
+    }
+    
     // 初始化共享ASR引擎
-    if (!asr_engine->initialize(model_dir, config)) {
+    if (!asr_engine->initialize(recognizer_pool.get(), config)) {
         LOG_ERROR("MODEL_POOL_MANAGER", "Failed to initialize shared ASR engine");
         return false;
     }
     
-    // 初始化VAD池
-    vad_pool = std::make_unique<VADPool>(model_dir, config);
-    if (!vad_pool->initialize()) {
-        LOG_ERROR("MODEL_POOL_MANAGER", "Failed to initialize VAD pool");
+    // 初始化共享VAD服务
+    if (!vad_service->initialize(model_dir, config)) {
+        LOG_ERROR("MODEL_POOL_MANAGER", "Failed to initialize VAD service");
         return false;
     }
     
@@ -444,15 +816,13 @@ ModelPoolManager::SystemStats ModelPoolManager::get_system_stats() const {
     stats.peak_concurrent_sessions = peak_concurrent_sessions.load();
     stats.current_active_sessions = total_sessions.load();
     stats.asr_active_recognitions = asr_engine->get_active_recognitions();
-    stats.vad_total_instances = vad_pool->get_total_instances();
-    stats.vad_available_instances = vad_pool->get_available_instances();
-    stats.vad_active_instances = vad_pool->get_active_instances();
-    
-    if (stats.vad_total_instances > 0) {
-        stats.memory_efficiency_ratio = static_cast<float>(stats.vad_active_instances) / stats.vad_total_instances;
-    } else {
-        stats.memory_efficiency_ratio = 0.0f;
-    }
+    stats.asr_total_replicas = recognizer_pool->get_total_instances();
+    stats.asr_in_use_replicas = recognizer_pool->get_in_use_instances();
+    stats.asr_queue_length = asr_engine->get_queue_length();
+    stats.asr_average_batch_size = asr_engine->get_average_batch_size();
+    stats.vad_active_streams = vad_service->get_active_streams();
+    stats.vad_batched = vad_service->is_batched();
+    stats.vad_average_batch_size = vad_service->get_average_batch_size();
     
     return stats;
 }
@@ -463,9 +833,11 @@ void ModelPoolManager::log_system_stats() const {
              "System stats - Active sessions: " << stats.current_active_sessions
              << ", Peak sessions: " << stats.peak_concurrent_sessions
              << ", ASR recognitions: " << stats.asr_active_recognitions
-             << ", VAD instances (total/available/active): " 
-             << stats.vad_total_instances << "/" 
-             << stats.vad_available_instances << "/" 
-             << stats.vad_active_instances
-             << ", Memory efficiency: " << (stats.memory_efficiency_ratio * 100) << "%");
+             << ", ASR replicas (in use/total): " << stats.asr_in_use_replicas 
+             << "/" << stats.asr_total_replicas
+             << ", ASR queue: " << stats.asr_queue_length
+             << ", ASR avg batch: " << stats.asr_average_batch_size
+             << ", VAD streams: " << stats.vad_active_streams
+             << " (" << (stats.vad_batched ? "batched" : "per-session") << ")"
+             << ", VAD avg batch: " << stats.vad_average_batch_size);
 }
@@ -1,12 +1,27 @@
 #include "oneshot_asr_session.h"
+#include "audio_ingest.h"
+#include "server_config.h"
 #include "logger.h"
+#include "metrics.h"
 #include <json/json.h>
 #include <cstdint>
 #include <algorithm>
 
-OneShotASRSession::OneShotASRSession(ASREngine* eng, connection_hdl h, server* srv, const std::string& id) 
+OneShotASRSession::OneShotASRSession(ASREngine* eng, connection_hdl h, server* srv, const std::string& id,
+                                     const ResultFormat& format) 
     : engine(eng), hdl(h), ws_server(srv), client_id(id), running(true), recording(false),
-      state(SessionState::WAITING_START), session_start_time(std::chrono::steady_clock::now()) {
+      audio_buffer(static_cast<size_t>(chunk_duration_s * eng->get_sample_rate())),
+      state(SessionState::WAITING_START), session_start_time(std::chrono::steady_clock::now()),
+      result_format(format) {
+    const auto& oneshot_config = engine->get_config().get_oneshot_config();
+    max_recording_samples = static_cast<size_t>(oneshot_config.max_duration_s * engine->get_sample_rate());
+    expected_recording_samples = static_cast<size_t>(oneshot_config.expected_duration_s * engine->get_sample_rate());
+    segment_threshold_samples = static_cast<size_t>(oneshot_config.segment_threshold_s * engine->get_sample_rate());
+    decode_while_recording = oneshot_config.decode_while_recording;
+    
+    const auto& performance_config = engine->get_config().get_performance_config();
+    max_buffered_bytes = performance_config.max_audio_buffer_size;
+    parse_audio_overflow_policy(performance_config.audio_overflow_policy, overflow_policy);
 }
 
 OneShotASRSession::~OneShotASRSession() {
@@ -14,6 +29,7 @@ OneShotASRSession::~OneShotASRSession() {
     auto session_duration = std::chrono::duration_cast<std::chrono::seconds>(
         std::chrono::steady_clock::now() - session_start_time).count();
     LOG_INFO(client_id, "OneShot session ended. Duration: " << session_duration << "s");
+    release_buffered_audio();
 }
 
 void OneShotASRSession::start() {
@@ -45,11 +61,28 @@ void OneShotASRSession::handle_message(const std::string& message) {
         LOG_DEBUG(client_id, "Received command: " << command);
         
         if (command == "start") {
-            if (state == SessionState::WAITING_START) {
-                start_recording();
-            } else {
+            if (state != SessionState::WAITING_START) {
                 send_error("Invalid state for start command");
+                return;
             }
+            
+            // duration_hint（秒）为客户端预计的录音时长，用于一次性预留缓冲区
+            size_t expected_samples = expected_recording_samples;
+            if (root.isMember("duration_hint")) {
+                const Json::Value& hint = root["duration_hint"];
+                if (!hint.isNumeric() || hint.asDouble() <= 0.0) {
+                    send_error("Invalid duration_hint");
+                    return;
+                }
+                double hint_samples = hint.asDouble() * engine->get_sample_rate();
+                if (hint_samples > static_cast<double>(max_recording_samples)) {
+                    send_error("duration_hint exceeds maximum recording duration of " + 
+                               std::to_string(static_cast<int>(max_recording_samples / engine->get_sample_rate())) + "s");
+                    return;
+                }
+                expected_samples = static_cast<size_t>(hint_samples);
+            }
+            start_recording(expected_samples);
         } else if (command == "stop") {
             if (state == SessionState::RECORDING) {
                 stop_recording_and_process();
@@ -65,20 +98,121 @@ void OneShotASRSession::handle_message(const std::string& message) {
     }
 }
 
-void OneShotASRSession::add_audio_data(const std::vector<uint8_t>& pcm_bytes) {
+void OneShotASRSession::add_audio_data(const uint8_t* pcm_bytes, size_t num_bytes) {
     if (!running || !recording || state != SessionState::RECORDING) return;
     
-    // Convert PCM bytes to float samples (assuming 16-bit PCM)
-    std::lock_guard<std::mutex> lock(audio_mutex);
-    size_t num_samples = pcm_bytes.size() / 2;
+    size_t num_samples = num_bytes / 2;
+    size_t frame_bytes = num_samples * 2;
+    const char* overflow_reason = nullptr;
+    AudioOverflowPolicy action = AudioOverflowPolicy::REJECT;
+    size_t dropped = 0;
+    bool too_long = false;
+    {
+        std::lock_guard<std::mutex> lock(audio_mutex);
+        bool accept_frame = true;
+        
+        if (recorded_samples + num_samples > max_recording_samples) {
+            too_long = true;
+            accept_frame = false;
+        }
+        
+        // 超出会话预算：drop_oldest丢弃录音开头为新帧腾出空间（一次至少丢弃预算的1/8，
+        // 避免每帧都移动整个缓冲区），其他策略丢弃新帧
+        if (accept_frame && buffered_bytes + frame_bytes > max_buffered_bytes) {
+            overflow_reason = "session";
+            if (overflow_policy == AudioOverflowPolicy::DROP_OLDEST && frame_bytes <= max_buffered_bytes) {
+                size_t excess = (buffered_bytes + frame_bytes - max_buffered_bytes + 1) / 2;
+                excess = std::min(audio_buffer.size(), std::max(excess, max_buffered_bytes / 16));
+                audio_buffer.drop_front(excess);
+                buffered_bytes -= excess * 2;
+                AudioMemoryBudget::instance().release(excess * 2);
+                action = AudioOverflowPolicy::DROP_OLDEST;
+                dropped = excess;
+            } else {
+                accept_frame = false;
+            }
+        }
+        
+        if (accept_frame && !AudioMemoryBudget::instance().try_acquire(frame_bytes)) {
+            overflow_reason = "global";
+            accept_frame = false;
+        }
+        
+        if (accept_frame) {
+            // Convert PCM bytes to float samples (assuming 16-bit PCM)，直接写入录音缓冲区
+            audio_buffer.append_pcm16le(pcm_bytes, num_samples);
+            buffered_bytes += frame_bytes;
+            recorded_samples += num_samples;
+            LOG_DEBUG(client_id, "Added " << num_samples << " audio samples, recorded: " << recorded_samples);
+        } else if (overflow_reason) {
+            action = overflow_policy == AudioOverflowPolicy::CLOSE ? 
+                AudioOverflowPolicy::CLOSE : AudioOverflowPolicy::REJECT;
+            dropped += num_samples;
+        }
+    }
+    
+    if (too_long) {
+        // 超过最大录音时长：丢弃本次录音并返回错误，客户端可以重新start
+        LOG_WARN(client_id, "Recording exceeds maximum duration, discarding");
+        recording = false;
+        state = SessionState::WAITING_START;
+        discard_live_decode();
+        release_buffered_audio();
+        send_error("Recording exceeds maximum duration of " + 
+                   std::to_string(static_cast<int>(max_recording_samples / engine->get_sample_rate())) + "s");
+        send_status("ready");
+    } else if (overflow_reason) {
+        handle_overflow(action, dropped, overflow_reason);
+    } else {
+        overflow_reported = false;
+    }
+    
+    if (live_vad.load() && !too_long) {
+        schedule_vad();
+    }
+}
+
+void OneShotASRSession::handle_overflow(AudioOverflowPolicy action, size_t dropped, const char* reason) {
+    ServerMetrics& metrics = ServerMetrics::instance();
+    metrics.audio_overflow_events[static_cast<size_t>(action)].inc();
+    metrics.samples_dropped.inc(dropped);
     
-    for (size_t i = 0; i < num_samples; i++) {
-        int16_t sample = static_cast<int16_t>(pcm_bytes[i * 2] | (pcm_bytes[i * 2 + 1] << 8));
-        float normalized_sample = static_cast<float>(sample) / 32768.0f;
-        audio_buffer.push_back(normalized_sample);
+    if (action == AudioOverflowPolicy::CLOSE) {
+        LOG_WARN(client_id, "Recording buffer overflow (" << reason << "), closing connection");
+        stop();
+        release_buffered_audio();
+        try {
+            ws_server->close(hdl, websocketpp::close::status::try_again_later, "audio buffer overflow");
+        } catch (const std::exception& e) {
+            LOG_ERROR(client_id, "Error closing connection: " << e.what());
+        }
+        return;
     }
     
-    LOG_DEBUG(client_id, "Added " << num_samples << " audio samples, total: " << audio_buffer.size());
+    if (overflow_reported) return;
+    overflow_reported = true;
+    LOG_WARN(client_id, "Recording buffer overflow (" << reason << "), action: " << audio_overflow_policy_name(action));
+    try {
+        Json::Value notice;
+        notice["type"] = "overflow";
+        notice["reason"] = reason;
+        notice["action"] = audio_overflow_policy_name(action);
+        notice["dropped_samples"] = static_cast<Json::UInt64>(dropped);
+        
+        Json::StreamWriterBuilder builder;
+        builder["indentation"] = "";
+        ws_server->send(hdl, Json::writeString(builder, notice), websocketpp::frame::opcode::text);
+    } catch (const std::exception& e) {
+        LOG_ERROR(client_id, "Error sending overflow notice: " << e.what());
+    }
+}
+
+void OneShotASRSession::release_buffered_audio() {
+    std::lock_guard<std::mutex> lock(audio_mutex);
+    AudioMemoryBudget::instance().release(buffered_bytes);
+    buffered_bytes = 0;
+    recorded_samples = 0;
+    audio_buffer.reset(0);
 }
 
 std::string OneShotASRSession::get_client_id() const {
@@ -93,13 +227,41 @@ bool OneShotASRSession::is_recording() const {
     return recording;
 }
 
-void OneShotASRSession::start_recording() {
-    LOG_INFO(client_id, "Starting audio recording");
-    std::lock_guard<std::mutex> lock(audio_mutex);
-    audio_buffer.clear();
-    recording = true;
-    state = SessionState::RECORDING;
-    recording_start_time = std::chrono::steady_clock::now();
+void OneShotASRSession::start_recording(size_t expected_samples) {
+    LOG_INFO(client_id, "Starting audio recording, expected " 
+             << expected_samples / engine->get_sample_rate() << "s");
+    release_buffered_audio();
+    discard_live_decode();
+    
+    // 边录边解码：分段器在工作线程上创建（回退模式下可能加载模型），创建完成前到达的音频
+    // 留在录音缓冲区，之后一并送入VAD；录音期间不断取走音频，缓冲区只需容纳两次VAD之间的音频
+    WorkerPool* worker_pool = engine->get_worker_pool();
+    auto shared_asr = engine->get_shared_asr();
+    bool live = decode_while_recording && worker_pool && engine->get_vad_service() && 
+                shared_asr && shared_asr->is_initialized();
+    if (live) {
+        expected_samples = 0;
+    }
+    
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(audio_mutex);
+        audio_buffer.reset(expected_samples);
+        generation = live_generation.load();
+        recording = true;
+        state = SessionState::RECORDING;
+        recording_start_time = std::chrono::steady_clock::now();
+    }
+    
+    if (live) {
+        live_vad.store(true);
+        std::weak_ptr<OneShotASRSession> weak_self = shared_from_this();
+        worker_pool->post([weak_self, generation]() {
+            if (auto self = weak_self.lock()) {
+                self->setup_live_decode(generation);
+            }
+        });
+    }
     send_status("recording");
 }
 
@@ -113,83 +275,257 @@ void OneShotASRSession::stop_recording_and_process() {
     LOG_INFO(client_id, "Recording duration: " << recording_duration << "ms");
     
     send_status("processing");
-    process_complete_audio();
+    
+    // 识别在工作线程池中进行，不阻塞WebSocket I/O线程
+    WorkerPool* worker_pool = engine->get_worker_pool();
+    if (!worker_pool) {
+        send_error("Worker pool not available");
+        return;
+    }
+    uint64_t generation = live_generation.load();
+    std::weak_ptr<OneShotASRSession> weak_self = shared_from_this();
+    worker_pool->post([weak_self, generation]() {
+        if (auto self = weak_self.lock()) {
+            self->process_complete_audio(generation);
+        }
+    });
 }
 
-void OneShotASRSession::process_complete_audio() {
-    std::lock_guard<std::mutex> lock(audio_mutex);
+void OneShotASRSession::process_complete_audio(uint64_t generation) {
+    if (!running) return;
+    
+    // 边录边解码：之前的语音段已在录音期间提交，只需处理剩余音频和最后一段。
+    // 分段器尚未创建或创建失败时，录音缓冲区中仍是完整录音，按整段识别
+    std::shared_ptr<SegmentedDecode> decode;
+    {
+        std::lock_guard<std::mutex> lock(vad_mutex);
+        release_stale_decode_locked();
+        processed_generation = generation;
+        if (segmenter && segmenter_generation == generation) {
+            decode = finish_live_decode_locked();
+        }
+    }
+    if (decode) {
+        size_t segment_count = decode->size();
+        if (segment_count == 0) {
+            LOG_INFO(client_id, "No speech detected during recording");
+            send_error("Recognition failed - no speech detected");
+            return;
+        }
+        LOG_INFO(client_id, "Finishing live decode of " << segment_count << " speech segments");
+        decode->seal();
+        return;
+    }
+    
+    std::vector<float> samples;
+    {
+        // 录音交给解码队列，不再计入缓冲预算
+        std::lock_guard<std::mutex> lock(audio_mutex);
+        samples = audio_buffer.take();
+        AudioMemoryBudget::instance().release(buffered_bytes);
+        buffered_bytes = 0;
+    }
     
-    if (audio_buffer.empty()) {
+    if (samples.empty()) {
         LOG_WARN(client_id, "No audio data to process");
         send_error("No audio data received");
         return;
     }
     
-    LOG_INFO(client_id, "Processing " << audio_buffer.size() << " audio samples");
+    LOG_INFO(client_id, "Processing " << samples.size() << " audio samples");
     
     try {
-        // 获取共享ASR引擎进行识别
-        auto shared_asr = engine->get_shared_asr();
-        if (!shared_asr || !shared_asr->is_initialized()) {
-            send_error("Shared ASR engine not available");
-            return;
-        }
-        
-        // 使用共享ASR引擎进行识别，支持元数据
-        std::string language, emotion, event;
-        std::vector<float> timestamps;
-        std::vector<std::string> tokens;
-        
-        std::string text = shared_asr->recognize_with_metadata(
-            audio_buffer.data(), 
-            audio_buffer.size(),
-            language,
-            emotion, 
-            event,
-            timestamps,
-            tokens
-        );
-        
-        if (text.empty()) {
-            send_error("Recognition failed - no result");
-            return;
-        }
-        
-        // 构造结果
-        ASRResult asr_result;
-        asr_result.text = text;
-        asr_result.finished = true;
-        asr_result.idx = 0;
-        asr_result.lang = language.empty() ? "auto" : language;
-        asr_result.emotion = emotion;
-        asr_result.event = event;
-        asr_result.tokens = tokens;
-        
-        // 添加时间戳信息
-        if (!timestamps.empty()) {
-            asr_result.timestamps = timestamps;
+        // 超过分段阈值的录音由VAD切分后并行解码，结果在解码线程中回调，工作线程不等待解码
+        if (!engine->decode_recording(std::move(samples), segment_threshold_samples, 
+                                      result_format.fields, make_join_callback(), client_id)) {
+            send_error("Recognition failed - no speech detected");
         }
-        
-        LOG_INFO(client_id, "Recognition completed: " << asr_result.text);
-        send_result(asr_result);
-        
-        state = SessionState::FINISHED;
-        send_status("finished");
-        
     } catch (const std::exception& e) {
         LOG_ERROR(client_id, "Error during recognition: " << e.what());
         send_error("Recognition failed: " + std::string(e.what()));
     }
 }
 
+SegmentedDecode::JoinCallback OneShotASRSession::make_join_callback() {
+    std::weak_ptr<OneShotASRSession> weak_self = shared_from_this();
+    return [weak_self](RecognitionResult joined, size_t failed_segments, size_t total_segments) {
+        if (auto self = weak_self.lock()) {
+            self->on_segments_joined(std::move(joined), failed_segments, total_segments);
+        }
+    };
+}
+
+void OneShotASRSession::on_segments_joined(RecognitionResult joined, size_t failed_segments, size_t total_segments) {
+    // 任一语音段解码失败时整体报错，不把缺少部分录音的结果当作成功发送
+    if (failed_segments > 0 && total_segments > 1) {
+        if (!running) return;
+        LOG_WARN(client_id, failed_segments << " of " << total_segments << " speech segments failed to decode");
+        send_error("Recognition failed - " + std::to_string(failed_segments) + " of " + 
+                   std::to_string(total_segments) + " speech segments failed");
+        return;
+    }
+    on_recognition_complete(std::move(joined));
+}
+
+void OneShotASRSession::setup_live_decode(uint64_t generation) {
+    std::lock_guard<std::mutex> lock(vad_mutex);
+    release_stale_decode_locked();
+    // 录音已被放弃，或stop后已按整段识别
+    if (generation != live_generation.load() || generation == processed_generation) return;
+    
+    VADService* vad_service = engine->get_vad_service();
+    std::unique_ptr<VADSegmenter> new_segmenter;
+    if (vad_service) {
+        new_segmenter = vad_service->create_segmenter();
+    }
+    if (!new_segmenter) {
+        LOG_WARN(client_id, "VAD segmenter unavailable, decoding after stop");
+        live_vad.store(false);
+        return;
+    }
+    
+    segmenter = std::move(new_segmenter);
+    segmenter_generation = generation;
+    live_decode = std::make_shared<SegmentedDecode>(engine->get_shared_asr(), DecodePriority::ONESHOT,
+                                                    result_format.fields, make_join_callback());
+    // 送入创建期间到达的音频
+    feed_vad_locked();
+}
+
+void OneShotASRSession::schedule_vad() {
+    if (!running || vad_scheduled.exchange(true)) return;
+    
+    WorkerPool* worker_pool = engine->get_worker_pool();
+    if (!worker_pool) {
+        vad_scheduled.store(false);
+        return;
+    }
+    // 先清除标志再取音频：取走之后到达的音频会再调度一次
+    std::weak_ptr<OneShotASRSession> weak_self = shared_from_this();
+    worker_pool->post([weak_self]() {
+        if (auto self = weak_self.lock()) {
+            self->vad_scheduled.store(false);
+            std::lock_guard<std::mutex> lock(self->vad_mutex);
+            self->release_stale_decode_locked();
+            self->feed_vad_locked();
+        }
+    });
+}
+
+void OneShotASRSession::feed_vad_locked() {
+    if (!segmenter) return;
+    
+    vad_pending.clear();
+    {
+        // 送入VAD的音频不再计入缓冲预算。在audio_mutex下复查代数：start重置缓冲区前已递增代数，
+        // 属于旧录音的分段器不会取走新录音的音频
+        std::lock_guard<std::mutex> lock(audio_mutex);
+        if (segmenter_generation != live_generation.load()) return;
+        audio_buffer.drain_into(vad_pending);
+        AudioMemoryBudget::instance().release(buffered_bytes);
+        buffered_bytes = 0;
+    }
+    if (vad_pending.empty()) return;
+    
+    try {
+        segmenter->accept(vad_pending.data(), vad_pending.size());
+        submit_finished_segments_locked();
+    } catch (const std::exception& e) {
+        LOG_ERROR(client_id, "Error during live VAD: " << e.what());
+    }
+}
+
+void OneShotASRSession::submit_finished_segments_locked() {
+    const float sample_rate = engine->get_sample_rate();
+    VADSegment segment;
+    std::vector<float> segment_samples;
+    while (segmenter->pop_segment(segment, &segment_samples)) {
+        LOG_DEBUG(client_id, "Live segment [" << segment.begin << ", " << segment.end << ") submitted");
+        live_decode->submit(std::move(segment_samples), segment.begin / sample_rate);
+    }
+}
+
+void OneShotASRSession::release_stale_decode_locked() {
+    if (!segmenter || segmenter_generation == live_generation.load()) return;
+    segmenter.reset();
+    if (live_decode) {
+        live_decode->cancel();
+        live_decode.reset();
+    }
+}
+
+std::shared_ptr<SegmentedDecode> OneShotASRSession::finish_live_decode_locked() {
+    feed_vad_locked();
+    try {
+        segmenter->flush();
+        submit_finished_segments_locked();
+    } catch (const std::exception& e) {
+        LOG_ERROR(client_id, "Error flushing live VAD: " << e.what());
+    }
+    segmenter.reset();
+    live_vad.store(false);
+    return std::move(live_decode);
+}
+
+void OneShotASRSession::discard_live_decode() {
+    // I/O线程只递增代数，不等待工作线程上正在进行的VAD推理；分段器和已提交的分段解码
+    // 由工作线程取消并销毁
+    live_generation.fetch_add(1);
+    live_vad.store(false);
+    
+    WorkerPool* worker_pool = engine->get_worker_pool();
+    if (!decode_while_recording || !worker_pool) return;
+    std::weak_ptr<OneShotASRSession> weak_self = shared_from_this();
+    worker_pool->post([weak_self]() {
+        if (auto self = weak_self.lock()) {
+            std::lock_guard<std::mutex> lock(self->vad_mutex);
+            self->release_stale_decode_locked();
+        }
+    });
+}
+
+void OneShotASRSession::on_recognition_complete(RecognitionResult result) {
+    if (!running) return;
+    
+    if (result.text.empty()) {
+        send_error("Recognition failed - no result");
+        return;
+    }
+    
+    // 构造结果
+    ASRResult asr_result;
+    asr_result.text = std::move(result.text);
+    asr_result.finished = true;
+    asr_result.idx = 0;
+    if (result_format.fields & RESULT_FIELD_LANG) {
+        asr_result.lang = result.language.empty() ? "auto" : std::move(result.language);
+    }
+    asr_result.emotion = std::move(result.emotion);
+    asr_result.event = std::move(result.event);
+    asr_result.tokens = std::move(result.tokens);
+    
+    // 添加时间戳信息
+    if (!result.timestamps.empty()) {
+        asr_result.timestamps = std::move(result.timestamps);
+    }
+    
+    LOG_INFO(client_id, "Recognition completed: " << asr_result.text);
+    send_result(asr_result);
+    ServerMetrics::instance().oneshot_results_sent.inc();
+    
+    state = SessionState::FINISHED;
+    send_status("finished");
+}
+
 void OneShotASRSession::send_result(const ASRResult& result) {
     try {
-        Json::Value json_result = result.to_json();
-        json_result["type"] = "result";
-        
-        Json::StreamWriterBuilder builder;
-        std::string json_string = Json::writeString(builder, json_result);
-        ws_server->send(hdl, json_string, websocketpp::frame::opcode::text);
+        if (result_format.binary) {
+            const std::string& frame = result_writer.write_binary(result, ResultWriter::FLAG_ONESHOT);
+            ws_server->send(hdl, frame.data(), frame.size(), websocketpp::frame::opcode::binary);
+        } else {
+            const std::string& json_string = result_writer.write_json(result, result_format.fields, "result");
+            ws_server->send(hdl, json_string.data(), json_string.size(), websocketpp::frame::opcode::text);
+        }
         
         LOG_DEBUG(client_id, "Sent result: " << result.text);
     } catch (const std::exception& e) {
@@ -0,0 +1,170 @@
+#include "result_writer.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+uint32_t parse_result_fields(const std::string& list, std::string* unknown) {
+    uint32_t fields = 0;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t end = list.find(',', start);
+        if (end == std::string::npos) end = list.size();
+        std::string name = list.substr(start, end - start);
+        start = end + 1;
+
+        if (name.empty() || name == "text" || name == "finished" || name == "idx") continue;
+        if (name == "lang") fields |= RESULT_FIELD_LANG;
+        else if (name == "emotion") fields |= RESULT_FIELD_EMOTION;
+        else if (name == "event") fields |= RESULT_FIELD_EVENT;
+        else if (name == "timestamps") fields |= RESULT_FIELD_TIMESTAMPS;
+        else if (name == "tokens") fields |= RESULT_FIELD_TOKENS;
+        else if (name == "all") fields |= RESULT_FIELDS_ALL;
+        else if (unknown) {
+            if (!unknown->empty()) *unknown += ',';
+            *unknown += name;
+        }
+    }
+    return fields;
+}
+
+// JSON键按jsoncpp的输出顺序（键名字典序）写出
+const std::string& ResultWriter::write_json(const ASRResult& result, uint32_t fields, const char* type) {
+    buffer.clear();
+    buffer += '{';
+    if (fields & RESULT_FIELD_EMOTION) {
+        buffer += "\"emotion\":";
+        append_json_string(result.emotion);
+        buffer += ',';
+    }
+    if (fields & RESULT_FIELD_EVENT) {
+        buffer += "\"event\":";
+        append_json_string(result.event);
+        buffer += ',';
+    }
+    buffer += result.finished ? "\"finished\":true" : "\"finished\":false";
+    buffer += ",\"idx\":";
+    buffer += std::to_string(result.idx);
+    if (fields & RESULT_FIELD_LANG) {
+        buffer += ",\"lang\":";
+        append_json_string(result.lang);
+    }
+    buffer += ",\"text\":";
+    append_json_string(result.text);
+
+    if (fields & RESULT_FIELD_TIMESTAMPS) {
+        buffer += ",\"timestamps\":[";
+        for (size_t i = 0; i < result.timestamps.size(); ++i) {
+            if (i > 0) buffer += ',';
+            append_json_float(result.timestamps[i]);
+        }
+        buffer += ']';
+    }
+    if (fields & RESULT_FIELD_TOKENS) {
+        buffer += ",\"tokens\":[";
+        for (size_t i = 0; i < result.tokens.size(); ++i) {
+            if (i > 0) buffer += ',';
+            append_json_string(result.tokens[i]);
+        }
+        buffer += ']';
+    }
+
+    if (type) {
+        buffer += ",\"type\":\"";
+        buffer += type;
+        buffer += '"';
+    }
+    buffer += '}';
+    return buffer;
+}
+
+// 布局（小端）：
+//   u8 version, u8 flags, i32 idx,
+//   u32长度+UTF-8 text, u16长度+lang, u16长度+emotion, u16长度+event,
+//   u32 count + count个float32 timestamps, u32 count + count个(u16长度+UTF-8) tokens
+const std::string& ResultWriter::write_binary(const ASRResult& result, uint8_t extra_flags) {
+    buffer.clear();
+    buffer += static_cast<char>(kBinaryVersion);
+    buffer += static_cast<char>((result.finished ? FLAG_FINISHED : 0) | extra_flags);
+    append_u32(static_cast<uint32_t>(result.idx));
+
+    append_u32(static_cast<uint32_t>(result.text.size()));
+    buffer += result.text;
+    append_short_string(result.lang);
+    append_short_string(result.emotion);
+    append_short_string(result.event);
+
+    append_u32(static_cast<uint32_t>(result.timestamps.size()));
+    for (float timestamp : result.timestamps) {
+        uint32_t bits;
+        std::memcpy(&bits, &timestamp, sizeof(bits));
+        append_u32(bits);
+    }
+    append_u32(static_cast<uint32_t>(result.tokens.size()));
+    for (const std::string& token : result.tokens) {
+        append_short_string(token);
+    }
+    return buffer;
+}
+
+void ResultWriter::append_json_string(const std::string& value) {
+    static const char hex[] = "0123456789abcdef";
+    buffer += '"';
+    size_t run_start = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(value[i]);
+        if (c >= 0x20 && c != '"' && c != '\\') continue;
+
+        // 非转义字符（含UTF-8多字节序列）成段复制
+        buffer.append(value, run_start, i - run_start);
+        run_start = i + 1;
+        switch (c) {
+            case '"':  buffer += "\\\""; break;
+            case '\\': buffer += "\\\\"; break;
+            case '\n': buffer += "\\n"; break;
+            case '\r': buffer += "\\r"; break;
+            case '\t': buffer += "\\t"; break;
+            case '\b': buffer += "\\b"; break;
+            case '\f': buffer += "\\f"; break;
+            default:
+                buffer += "\\u00";
+                buffer += hex[c >> 4];
+                buffer += hex[c & 0xf];
+        }
+    }
+    buffer.append(value, run_start, value.size() - run_start);
+    buffer += '"';
+}
+
+// 时间戳写为能还原出同一float的最短小数（0.12而不是jsoncpp的0.11999999731779099），
+// 解析后转换为float与原值完全相同；整数值补".0"，与jsoncpp一样保持实数类型
+void ResultWriter::append_json_float(float value) {
+    if (!std::isfinite(value)) {
+        buffer += "null";
+        return;
+    }
+    char digits[32];
+    auto converted = std::to_chars(digits, digits + sizeof(digits), value);
+    buffer.append(digits, converted.ptr);
+    if (std::find_if(digits, converted.ptr, [](char c) { return c == '.' || c == 'e'; }) == converted.ptr) {
+        buffer += ".0";
+    }
+}
+
+void ResultWriter::append_u16(uint16_t value) {
+    buffer += static_cast<char>(value & 0xff);
+    buffer += static_cast<char>(value >> 8);
+}
+
+void ResultWriter::append_u32(uint32_t value) {
+    char bytes[4] = {static_cast<char>(value & 0xff), static_cast<char>((value >> 8) & 0xff),
+                     static_cast<char>((value >> 16) & 0xff), static_cast<char>(value >> 24)};
+    buffer.append(bytes, 4);
+}
+
+// 超过65535字节的部分截断（语言、情感、事件标签与单个token都很短）
+void ResultWriter::append_short_string(const std::string& value) {
+    size_t length = std::min<size_t>(value.size(), 0xffff);
+    append_u16(static_cast<uint16_t>(length));
+    buffer.append(value, 0, length);
+}
@@ -1,10 +1,38 @@
 #include "server_config.h"
+#include "audio_budget.h"
 #include "logger.h"
 #include <iostream>
 #include <cstring>
 #include <algorithm>
 #include <cctype>
 #include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+// 解析字节数等非负大小，负数（stoull会把它回绕成极大值）和超出范围的值抛出异常
+size_t parse_size(const std::string& text) {
+    size_t pos = text.find_first_not_of(" \t");
+    if (pos != std::string::npos && text[pos] == '-') {
+        throw std::invalid_argument("negative size: " + text);
+    }
+    unsigned long long value = std::stoull(text);
+    if (value > std::numeric_limits<size_t>::max()) {
+        throw std::out_of_range("size too large: " + text);
+    }
+    return static_cast<size_t>(value);
+}
+
+// VAD由共享的VADService提供，实例池配置已移除；旧的环境变量或命令行参数只提示一次
+void warn_vad_pool_deprecated() {
+    static bool warned = false;
+    if (warned) return;
+    warned = true;
+    LOG_WARN("CONFIG", "VAD_POOL_* / --vad-pool-* settings are deprecated and ignored");
+}
+
+} // namespace
 
 ServerConfig::ServerConfig() {
     // 构造函数中设置默认值（已在头文件中设置）
@@ -113,6 +141,19 @@ int ServerConfig::get_env_int(const char* name, int default_value) const {
     return default_value;
 }
 
+size_t ServerConfig::get_env_size(const char* name, size_t default_value) const {
+    const char* env_val = std::getenv(name);
+    if (env_val != nullptr) {
+        try {
+            return parse_size(env_val);
+        } catch (const std::exception& e) {
+            LOG_WARN("CONFIG", "Invalid size value for " << name << ": " << env_val 
+                     << ", using default: " << default_value);
+        }
+    }
+    return default_value;
+}
+
 float ServerConfig::get_env_float(const char* name, float default_value) const {
     const char* env_val = std::getenv(name);
     if (env_val != nullptr) {
@@ -156,8 +197,11 @@ void ServerConfig::load_from_environment() {
     
     // ASR配置
     asr_config_.pool_size = get_env_int("ASR_POOL_SIZE", asr_config_.pool_size);
+    asr_config_.share_weights = get_env_bool("ASR_SHARE_WEIGHTS", asr_config_.share_weights);
     asr_config_.num_threads = get_env_int("ASR_NUM_THREADS", asr_config_.num_threads);
     asr_config_.acquire_timeout_ms = get_env_int("ASR_ACQUIRE_TIMEOUT_MS", asr_config_.acquire_timeout_ms);
+    asr_config_.batch_size = get_env_int("ASR_BATCH_SIZE", asr_config_.batch_size);
+    asr_config_.batch_timeout_ms = get_env_int("ASR_BATCH_TIMEOUT_MS", asr_config_.batch_timeout_ms);
     asr_config_.model_name = get_env_string("ASR_MODEL_NAME", asr_config_.model_name);
     asr_config_.use_itn = get_env_bool("ASR_USE_ITN", asr_config_.use_itn);
     asr_config_.language = get_env_string("ASR_LANGUAGE", asr_config_.language);
@@ -170,25 +214,49 @@ void ServerConfig::load_from_environment() {
     vad_config_.max_speech_duration = get_env_float("VAD_MAX_SPEECH_DURATION", vad_config_.max_speech_duration);
     vad_config_.sample_rate = get_env_float("VAD_SAMPLE_RATE", vad_config_.sample_rate);
     vad_config_.window_size = get_env_int("VAD_WINDOW_SIZE", vad_config_.window_size);
+    vad_config_.batched = get_env_bool("VAD_BATCHED", vad_config_.batched);
+    vad_config_.max_batch_size = get_env_int("VAD_MAX_BATCH_SIZE", vad_config_.max_batch_size);
+    vad_config_.num_threads = get_env_int("VAD_NUM_THREADS", vad_config_.num_threads);
     vad_config_.debug = get_env_bool("VAD_DEBUG", vad_config_.debug);
     
-    // VAD池配置
-    vad_pool_config_.min_pool_size = static_cast<size_t>(get_env_int("VAD_POOL_MIN_SIZE", static_cast<int>(vad_pool_config_.min_pool_size)));
-    vad_pool_config_.max_pool_size = static_cast<size_t>(get_env_int("VAD_POOL_MAX_SIZE", static_cast<int>(vad_pool_config_.max_pool_size)));
-    vad_pool_config_.acquire_timeout_ms = get_env_int("VAD_POOL_ACQUIRE_TIMEOUT_MS", vad_pool_config_.acquire_timeout_ms);
+    // 已废弃的VAD池配置
+    if (std::getenv("VAD_POOL_MIN_SIZE") || std::getenv("VAD_POOL_MAX_SIZE") || 
+        std::getenv("VAD_POOL_ACQUIRE_TIMEOUT_MS")) {
+        warn_vad_pool_deprecated();
+    }
     
     // 服务器设置
     server_settings_.port = get_env_int("SERVER_PORT", server_settings_.port);
     server_settings_.models_root = get_env_string("MODELS_ROOT", server_settings_.models_root);
     server_settings_.log_level = get_env_string("LOG_LEVEL", server_settings_.log_level);
     server_settings_.max_connections = get_env_int("MAX_CONNECTIONS", server_settings_.max_connections);
+    server_settings_.max_decode_backlog_ms = get_env_int("MAX_DECODE_BACKLOG_MS", server_settings_.max_decode_backlog_ms);
     server_settings_.connection_timeout_s = get_env_int("CONNECTION_TIMEOUT_S", server_settings_.connection_timeout_s);
+    server_settings_.worker_threads = get_env_int("WORKER_THREADS", server_settings_.worker_threads);
+    server_settings_.io_threads = get_env_int("IO_THREADS", server_settings_.io_threads);
+    
+    // 流式识别配置
+    streaming_config_.incremental_partial = get_env_bool("PARTIAL_INCREMENTAL", streaming_config_.incremental_partial);
+    streaming_config_.partial_window_s = get_env_float("PARTIAL_WINDOW_S", streaming_config_.partial_window_s);
+    
+    // 一句话识别配置
+    oneshot_config_.max_duration_s = get_env_float("ONESHOT_MAX_DURATION_S", oneshot_config_.max_duration_s);
+    oneshot_config_.expected_duration_s = get_env_float("ONESHOT_EXPECTED_DURATION_S", oneshot_config_.expected_duration_s);
+    oneshot_config_.segment_threshold_s = get_env_float("ONESHOT_SEGMENT_THRESHOLD_S", oneshot_config_.segment_threshold_s);
+    oneshot_config_.decode_while_recording = get_env_bool("ONESHOT_DECODE_WHILE_RECORDING", oneshot_config_.decode_while_recording);
     
     // 性能配置
     performance_config_.enable_memory_optimization = get_env_bool("ENABLE_MEMORY_OPTIMIZATION", performance_config_.enable_memory_optimization);
-    performance_config_.max_audio_buffer_size = static_cast<size_t>(get_env_int("MAX_AUDIO_BUFFER_SIZE", static_cast<int>(performance_config_.max_audio_buffer_size)));
+    performance_config_.max_audio_buffer_size = get_env_size("MAX_AUDIO_BUFFER_SIZE", performance_config_.max_audio_buffer_size);
+    performance_config_.max_total_audio_buffer_size = get_env_size("MAX_TOTAL_AUDIO_BUFFER_SIZE", performance_config_.max_total_audio_buffer_size);
+    performance_config_.audio_overflow_policy = get_env_string("AUDIO_OVERFLOW_POLICY", performance_config_.audio_overflow_policy);
     performance_config_.gc_interval_s = get_env_int("GC_INTERVAL_S", performance_config_.gc_interval_s);
     performance_config_.enable_performance_logging = get_env_bool("ENABLE_PERFORMANCE_LOGGING", performance_config_.enable_performance_logging);
+    
+    // 延迟追踪配置
+    tracing_config_.enabled = get_env_bool("TRACE_ENABLED", tracing_config_.enabled);
+    tracing_config_.buffer_events = get_env_int("TRACE_BUFFER_EVENTS", tracing_config_.buffer_events);
+    tracing_config_.output_prefix = get_env_string("TRACE_OUTPUT", tracing_config_.output_prefix);
 }
 
 void ServerConfig::load_from_args(int argc, char* argv[]) {
@@ -214,12 +282,36 @@ void ServerConfig::load_from_args(int argc, char* argv[]) {
         else if (arg == "--max-connections" && i + 1 < argc) {
             server_settings_.max_connections = std::stoi(argv[++i]);
         }
+        else if (arg == "--max-decode-backlog-ms" && i + 1 < argc) {
+            server_settings_.max_decode_backlog_ms = std::stoi(argv[++i]);
+        }
+        else if (arg == "--asr-pool-size" && i + 1 < argc) {
+            asr_config_.pool_size = std::stoi(argv[++i]);
+        }
+        else if (arg == "--asr-share-weights") {
+            asr_config_.share_weights = true;
+        }
+        else if (arg == "--asr-no-share-weights") {
+            asr_config_.share_weights = false;
+        }
+        else if (arg == "--io-threads" && i + 1 < argc) {
+            server_settings_.io_threads = std::stoi(argv[++i]);
+        }
+        else if (arg == "--worker-threads" && i + 1 < argc) {
+            server_settings_.worker_threads = std::stoi(argv[++i]);
+        }
         else if (arg == "--asr-threads" && i + 1 < argc) {
             asr_config_.num_threads = std::stoi(argv[++i]);
         }
         else if (arg == "--asr-timeout" && i + 1 < argc) {
             asr_config_.acquire_timeout_ms = std::stoi(argv[++i]);
         }
+        else if (arg == "--asr-batch-size" && i + 1 < argc) {
+            asr_config_.batch_size = std::stoi(argv[++i]);
+        }
+        else if (arg == "--asr-batch-timeout" && i + 1 < argc) {
+            asr_config_.batch_timeout_ms = std::stoi(argv[++i]);
+        }
         else if (arg == "--asr-model" && i + 1 < argc) {
             asr_config_.model_name = argv[++i];
         }
@@ -248,15 +340,48 @@ void ServerConfig::load_from_args(int argc, char* argv[]) {
         else if (arg == "--vad-max-speech" && i + 1 < argc) {
             vad_config_.max_speech_duration = std::stof(argv[++i]);
         }
-        else if (arg == "--vad-pool-min" && i + 1 < argc) {
-            vad_pool_config_.min_pool_size = static_cast<size_t>(std::stoi(argv[++i]));
+        else if (arg == "--vad-batched") {
+            vad_config_.batched = true;
+        }
+        else if (arg == "--vad-per-session") {
+            vad_config_.batched = false;
+        }
+        else if (arg == "--vad-max-batch" && i + 1 < argc) {
+            vad_config_.max_batch_size = std::stoi(argv[++i]);
         }
-        else if (arg == "--vad-pool-max" && i + 1 < argc) {
-            vad_pool_config_.max_pool_size = static_cast<size_t>(std::stoi(argv[++i]));
+        else if (arg == "--vad-threads" && i + 1 < argc) {
+            vad_config_.num_threads = std::stoi(argv[++i]);
+        }
+        else if ((arg == "--vad-pool-min" || arg == "--vad-pool-max") && i + 1 < argc) {
+            ++i;
+            warn_vad_pool_deprecated();
         }
         else if (arg == "--vad-debug") {
             vad_config_.debug = true;
         }
+        // 流式识别配置
+        else if (arg == "--partial-incremental") {
+            streaming_config_.incremental_partial = true;
+        }
+        else if (arg == "--partial-full") {
+            streaming_config_.incremental_partial = false;
+        }
+        else if (arg == "--partial-window" && i + 1 < argc) {
+            streaming_config_.partial_window_s = std::stof(argv[++i]);
+        }
+        // 一句话识别配置
+        else if (arg == "--oneshot-max-duration" && i + 1 < argc) {
+            oneshot_config_.max_duration_s = std::stof(argv[++i]);
+        }
+        else if (arg == "--oneshot-expected-duration" && i + 1 < argc) {
+            oneshot_config_.expected_duration_s = std::stof(argv[++i]);
+        }
+        else if (arg == "--oneshot-segment-threshold" && i + 1 < argc) {
+            oneshot_config_.segment_threshold_s = std::stof(argv[++i]);
+        }
+        else if (arg == "--oneshot-decode-while-recording") {
+            oneshot_config_.decode_while_recording = true;
+        }
         // 性能配置
         else if (arg == "--enable-memory-opt") {
             performance_config_.enable_memory_optimization = true;
@@ -268,7 +393,36 @@ void ServerConfig::load_from_args(int argc, char* argv[]) {
             performance_config_.enable_performance_logging = true;
         }
         else if (arg == "--max-buffer-size" && i + 1 < argc) {
-            performance_config_.max_audio_buffer_size = static_cast<size_t>(std::stoi(argv[++i]));
+            performance_config_.max_audio_buffer_size = parse_size(argv[++i]);
+        }
+        else if (arg == "--max-total-buffer-size" && i + 1 < argc) {
+            performance_config_.max_total_audio_buffer_size = parse_size(argv[++i]);
+        }
+        else if (arg == "--audio-overflow-policy" && i + 1 < argc) {
+            performance_config_.audio_overflow_policy = argv[++i];
+        }
+        // 延迟追踪配置
+        else if (arg == "--trace") {
+            tracing_config_.enabled = true;
+        }
+        else if (arg == "--trace-buffer" && i + 1 < argc) {
+            tracing_config_.buffer_events = std::stoi(argv[++i]);
+        }
+        else if (arg == "--trace-output" && i + 1 < argc) {
+            tracing_config_.output_prefix = argv[++i];
+        }
+        // 离线批量转写
+        else if (arg == "--transcribe" && i + 1 < argc) {
+            transcribe_config_.input = argv[++i];
+        }
+        else if (arg == "--transcribe-output" && i + 1 < argc) {
+            transcribe_config_.output = argv[++i];
+        }
+        else if (arg == "--transcribe-jobs" && i + 1 < argc) {
+            transcribe_config_.jobs = std::stoi(argv[++i]);
+        }
+        else if (arg == "--transcribe-resume") {
+            transcribe_config_.resume = true;
         }
         else {
             std::cerr << "Unknown argument: " << arg << std::endl;
@@ -297,6 +451,16 @@ bool ServerConfig::validate() const {
         valid = false;
     }
     
+    if (asr_config_.batch_size <= 0 || asr_config_.batch_size > 64) {
+        LOG_ERROR("CONFIG", "Invalid ASR batch size: " << asr_config_.batch_size << " (must be 1-64)");
+        valid = false;
+    }
+    
+    if (asr_config_.batch_timeout_ms < 0) {
+        LOG_ERROR("CONFIG", "Invalid ASR batch timeout: " << asr_config_.batch_timeout_ms);
+        valid = false;
+    }
+    
     // 验证VAD配置
     if (vad_config_.threshold < 0.0f || vad_config_.threshold > 1.0f) {
         LOG_ERROR("CONFIG", "Invalid VAD threshold: " << vad_config_.threshold << " (must be 0.0-1.0)");
@@ -318,13 +482,70 @@ bool ServerConfig::validate() const {
         valid = false;
     }
     
-    // 验证VAD池配置
-    if (vad_pool_config_.min_pool_size == 0 || vad_pool_config_.min_pool_size > vad_pool_config_.max_pool_size) {
-        LOG_ERROR("CONFIG", "Invalid VAD pool sizes: min=" << vad_pool_config_.min_pool_size 
-                  << ", max=" << vad_pool_config_.max_pool_size);
+    if (vad_config_.max_batch_size < 1 || vad_config_.max_batch_size > 1024) {
+        LOG_ERROR("CONFIG", "Invalid VAD max batch size: " << vad_config_.max_batch_size << " (must be 1-1024)");
+        valid = false;
+    }
+    
+    if (vad_config_.num_threads < 1 || vad_config_.num_threads > 64) {
+        LOG_ERROR("CONFIG", "Invalid VAD threads: " << vad_config_.num_threads << " (must be 1-64)");
+        valid = false;
+    }
+    
+    // 验证流式识别配置
+    if (streaming_config_.partial_window_s < 1.0f) {
+        LOG_ERROR("CONFIG", "Invalid partial window: " << streaming_config_.partial_window_s << " (must be >= 1.0s)");
+        valid = false;
+    }
+    
+    // 验证一句话识别配置
+    if (oneshot_config_.max_duration_s <= 0.0f) {
+        LOG_ERROR("CONFIG", "Invalid OneShot max duration: " << oneshot_config_.max_duration_s << "s");
+        valid = false;
+    }
+    
+    if (oneshot_config_.expected_duration_s <= 0.0f || oneshot_config_.expected_duration_s > oneshot_config_.max_duration_s) {
+        LOG_ERROR("CONFIG", "Invalid OneShot expected duration: " << oneshot_config_.expected_duration_s 
+                  << "s (must be > 0 and <= max duration)");
+        valid = false;
+    }
+    
+    if (oneshot_config_.segment_threshold_s < 0.0f) {
+        LOG_ERROR("CONFIG", "Invalid OneShot segment threshold: " << oneshot_config_.segment_threshold_s << "s (must be >= 0)");
+        valid = false;
+    }
+    
+    // 验证音频缓冲配置
+    AudioOverflowPolicy overflow_policy;
+    if (!parse_audio_overflow_policy(performance_config_.audio_overflow_policy, overflow_policy)) {
+        LOG_ERROR("CONFIG", "Invalid audio overflow policy: " << performance_config_.audio_overflow_policy
+                  << " (must be drop_oldest, reject or close)");
+        valid = false;
+    }
+    
+    if (performance_config_.max_audio_buffer_size < 64 * 1024) {
+        LOG_ERROR("CONFIG", "Invalid max audio buffer size: " << performance_config_.max_audio_buffer_size << " (must be >= 65536 bytes)");
+        valid = false;
+    }
+    
+    // 验证延迟追踪配置
+    if (tracing_config_.buffer_events < 1024 || tracing_config_.buffer_events > 16 * 1024 * 1024) {
+        LOG_ERROR("CONFIG", "Invalid trace buffer size: " << tracing_config_.buffer_events << " (must be 1024-16777216 events)");
         valid = false;
     }
     
+    // 验证离线转写配置
+    if (!transcribe_config_.input.empty()) {
+        if (transcribe_config_.output.empty()) {
+            LOG_ERROR("CONFIG", "Transcription output file must not be empty");
+            valid = false;
+        }
+        if (transcribe_config_.jobs < 0) {
+            LOG_ERROR("CONFIG", "Invalid transcription jobs: " << transcribe_config_.jobs << " (must be >= 0)");
+            valid = false;
+        }
+    }
+    
     // 验证服务器设置
     if (server_settings_.port <= 0 || server_settings_.port > 65535) {
         LOG_ERROR("CONFIG", "Invalid server port: " << server_settings_.port);
@@ -336,6 +557,21 @@ bool ServerConfig::validate() const {
         valid = false;
     }
     
+    if (server_settings_.max_decode_backlog_ms < 0) {
+        LOG_ERROR("CONFIG", "Invalid max decode backlog: " << server_settings_.max_decode_backlog_ms << "ms");
+        valid = false;
+    }
+    
+    if (server_settings_.io_threads <= 0 || server_settings_.io_threads > 64) {
+        LOG_ERROR("CONFIG", "Invalid I/O threads: " << server_settings_.io_threads << " (must be 1-64)");
+        valid = false;
+    }
+    
+    if (server_settings_.worker_threads < 0 || server_settings_.worker_threads > 256) {
+        LOG_ERROR("CONFIG", "Invalid worker threads: " << server_settings_.worker_threads << " (must be 0-256)");
+        valid = false;
+    }
+    
     return valid;
 }
 
@@ -353,13 +589,21 @@ void ServerConfig::print_config() const {
     LOG_INFO("CONFIG", "  Models Root: " << server_settings_.models_root);
     LOG_INFO("CONFIG", "  Log Level: " << server_settings_.log_level);
     LOG_INFO("CONFIG", "  Max Connections: " << server_settings_.max_connections);
+    LOG_INFO("CONFIG", "  Max Decode Backlog: " << (server_settings_.max_decode_backlog_ms > 0 ?
+                                                    std::to_string(server_settings_.max_decode_backlog_ms) + "ms" : "unlimited"));
     LOG_INFO("CONFIG", "  Connection Timeout: " << server_settings_.connection_timeout_s << "s");
+    LOG_INFO("CONFIG", "  I/O Threads: " << server_settings_.io_threads);
+    LOG_INFO("CONFIG", "  Worker Threads: " << (server_settings_.worker_threads > 0 ? 
+                                                std::to_string(server_settings_.worker_threads) : "auto"));
     
     // ASR配置
     LOG_INFO("CONFIG", "[ASR Configuration]");
     LOG_INFO("CONFIG", "  Pool Size: " << asr_config_.pool_size);
+    LOG_INFO("CONFIG", "  Share Weights: " << (asr_config_.share_weights ? "true" : "false"));
     LOG_INFO("CONFIG", "  Threads: " << asr_config_.num_threads);
     LOG_INFO("CONFIG", "  Acquire Timeout: " << asr_config_.acquire_timeout_ms << "ms");
+    LOG_INFO("CONFIG", "  Batch Size: " << asr_config_.batch_size);
+    LOG_INFO("CONFIG", "  Batch Timeout: " << asr_config_.batch_timeout_ms << "ms");
     LOG_INFO("CONFIG", "  Model Name: " << asr_config_.model_name);
     LOG_INFO("CONFIG", "  Language: " << asr_config_.language);
     LOG_INFO("CONFIG", "  Use ITN: " << (asr_config_.use_itn ? "true" : "false"));
@@ -373,21 +617,47 @@ void ServerConfig::print_config() const {
     LOG_INFO("CONFIG", "  Max Speech Duration: " << vad_config_.max_speech_duration << "s");
     LOG_INFO("CONFIG", "  Sample Rate: " << vad_config_.sample_rate << "Hz");
     LOG_INFO("CONFIG", "  Window Size: " << vad_config_.window_size);
+    LOG_INFO("CONFIG", "  Batched: " << (vad_config_.batched ? "true" : "false"));
+    LOG_INFO("CONFIG", "  Max Batch Size: " << vad_config_.max_batch_size);
+    LOG_INFO("CONFIG", "  Threads: " << vad_config_.num_threads);
     LOG_INFO("CONFIG", "  Debug: " << (vad_config_.debug ? "true" : "false"));
     
-    // VAD池配置
-    LOG_INFO("CONFIG", "[VAD Pool Configuration]");
-    LOG_INFO("CONFIG", "  Min Pool Size: " << vad_pool_config_.min_pool_size);
-    LOG_INFO("CONFIG", "  Max Pool Size: " << vad_pool_config_.max_pool_size);
-    LOG_INFO("CONFIG", "  Acquire Timeout: " << vad_pool_config_.acquire_timeout_ms << "ms");
+    // 流式识别配置
+    LOG_INFO("CONFIG", "[Streaming Configuration]");
+    LOG_INFO("CONFIG", "  Incremental Partial: " << (streaming_config_.incremental_partial ? "enabled" : "disabled"));
+    LOG_INFO("CONFIG", "  Partial Window: " << streaming_config_.partial_window_s << "s");
+    
+    // 一句话识别配置
+    LOG_INFO("CONFIG", "[OneShot Configuration]");
+    LOG_INFO("CONFIG", "  Max Duration: " << oneshot_config_.max_duration_s << "s");
+    LOG_INFO("CONFIG", "  Expected Duration: " << oneshot_config_.expected_duration_s << "s");
+    LOG_INFO("CONFIG", "  Segment Threshold: " << oneshot_config_.segment_threshold_s << "s");
+    LOG_INFO("CONFIG", "  Decode While Recording: " << (oneshot_config_.decode_while_recording ? "enabled" : "disabled"));
     
     // 性能配置
     LOG_INFO("CONFIG", "[Performance Configuration]");
     LOG_INFO("CONFIG", "  Memory Optimization: " << (performance_config_.enable_memory_optimization ? "enabled" : "disabled"));
-    LOG_INFO("CONFIG", "  Max Audio Buffer Size: " << performance_config_.max_audio_buffer_size << " bytes");
+    LOG_INFO("CONFIG", "  Max Audio Buffer Size: " << performance_config_.max_audio_buffer_size << " bytes per session");
+    LOG_INFO("CONFIG", "  Max Total Audio Buffer Size: " << (performance_config_.max_total_audio_buffer_size > 0 ?
+                                                              std::to_string(performance_config_.max_total_audio_buffer_size) + " bytes" : "unlimited"));
+    LOG_INFO("CONFIG", "  Audio Overflow Policy: " << performance_config_.audio_overflow_policy);
     LOG_INFO("CONFIG", "  GC Interval: " << performance_config_.gc_interval_s << "s");
     LOG_INFO("CONFIG", "  Performance Logging: " << (performance_config_.enable_performance_logging ? "enabled" : "disabled"));
     
+    // 延迟追踪配置
+    LOG_INFO("CONFIG", "[Tracing Configuration]");
+    LOG_INFO("CONFIG", "  Enabled: " << (tracing_config_.enabled ? "true" : "false"));
+    LOG_INFO("CONFIG", "  Buffer Events: " << tracing_config_.buffer_events);
+    LOG_INFO("CONFIG", "  Output Prefix: " << tracing_config_.output_prefix);
+    
+    if (!transcribe_config_.input.empty()) {
+        LOG_INFO("CONFIG", "[Transcription Configuration]");
+        LOG_INFO("CONFIG", "  Input: " << transcribe_config_.input);
+        LOG_INFO("CONFIG", "  Output: " << transcribe_config_.output);
+        LOG_INFO("CONFIG", "  Jobs: " << (transcribe_config_.jobs > 0 ? std::to_string(transcribe_config_.jobs) : "auto"));
+        LOG_INFO("CONFIG", "  Resume: " << (transcribe_config_.resume ? "true" : "false"));
+    }
+    
     LOG_INFO("CONFIG", "=== End Configuration ===");
 }
 
@@ -399,10 +669,17 @@ void ServerConfig::print_usage(const char* program_name) {
     std::cout << "  --models-root PATH             Path to models directory (default: ./assets)" << std::endl;
     std::cout << "  --log-level LEVEL              Log level: DEBUG, INFO, WARN, ERROR (default: INFO)" << std::endl;
     std::cout << "  --max-connections NUM          Maximum concurrent connections (default: 100)" << std::endl;
+    std::cout << "  --max-decode-backlog-ms MS     Reject new connections when the estimated decode backlog exceeds MS, 0 = off (default: 0)" << std::endl;
+    std::cout << "  --io-threads NUM               WebSocket I/O threads sharing the event loop (default: 1)" << std::endl;
+    std::cout << "  --worker-threads NUM           Background worker threads, 0 = CPU cores (default: 0)" << std::endl;
     std::cout << std::endl;
     std::cout << "ASR Options:" << std::endl;
+    std::cout << "  --asr-pool-size NUM            ASR recognizer replicas decoding in parallel (default: 2)" << std::endl;
+    std::cout << "  --asr-share-weights/--asr-no-share-weights  Share model weights across replicas (default: enabled)" << std::endl;
     std::cout << "  --asr-threads NUM              ASR threads per model (default: 2)" << std::endl;
     std::cout << "  --asr-timeout MS               ASR acquire timeout in ms (default: 5000)" << std::endl;
+    std::cout << "  --asr-batch-size NUM           Max streams per batched decode (default: 8)" << std::endl;
+    std::cout << "  --asr-batch-timeout MS         Batch collection window in ms (default: 10)" << std::endl;
     std::cout << "  --asr-model NAME               ASR model name (default: sherpa-onnx-sense-voice-zh-en-ja-ko-yue-2024-07-17)" << std::endl;
     std::cout << "  --asr-language LANG            ASR language (default: auto)" << std::endl;
     std::cout << "  --asr-use-itn/--asr-no-itn     Enable/disable ITN (default: enabled)" << std::endl;
@@ -413,23 +690,59 @@ void ServerConfig::print_usage(const char* program_name) {
     std::cout << "  --vad-min-silence FLOAT        Min silence duration in seconds (default: 0.25)" << std::endl;
     std::cout << "  --vad-min-speech FLOAT         Min speech duration in seconds (default: 0.25)" << std::endl;
     std::cout << "  --vad-max-speech FLOAT         Max speech duration in seconds (default: 8.0)" << std::endl;
-    std::cout << "  --vad-pool-min NUM             VAD pool min size (default: 2)" << std::endl;
-    std::cout << "  --vad-pool-max NUM             VAD pool max size (default: 10)" << std::endl;
+    std::cout << "  --vad-batched                  Share one silero model and batch windows across sessions (default)" << std::endl;
+    std::cout << "  --vad-per-session              Use a separate sherpa-onnx VAD per session" << std::endl;
+    std::cout << "  --vad-max-batch NUM            Max windows per batched VAD inference (default: 128)" << std::endl;
+    std::cout << "  --vad-threads NUM              VAD inference threads (default: 1)" << std::endl;
+    std::cout << "  --vad-pool-min NUM             Deprecated, ignored" << std::endl;
+    std::cout << "  --vad-pool-max NUM             Deprecated, ignored" << std::endl;
     std::cout << "  --vad-debug                    Enable VAD debug mode" << std::endl;
     std::cout << std::endl;
+    std::cout << "Streaming Options:" << std::endl;
+    std::cout << "  --partial-incremental          Decode only the recent tail for partial results (default)" << std::endl;
+    std::cout << "  --partial-full                 Re-decode the whole utterance for every partial result" << std::endl;
+    std::cout << "  --partial-window SECONDS       Max tail audio decoded per partial result (default: 3.0)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "OneShot Options:" << std::endl;
+    std::cout << "  --oneshot-max-duration SECONDS Max recording length per request (default: 120)" << std::endl;
+    std::cout << "  --oneshot-expected-duration SECONDS" << std::endl;
+    std::cout << "                                 Buffer reserved when start has no duration_hint (default: 10)" << std::endl;
+    std::cout << "  --oneshot-segment-threshold SECONDS" << std::endl;
+    std::cout << "                                 Split longer recordings with VAD and decode segments in parallel, 0 = off (default: 20)" << std::endl;
+    std::cout << "  --oneshot-decode-while-recording" << std::endl;
+    std::cout << "                                 Decode finished speech segments during recording" << std::endl;
+    std::cout << std::endl;
     std::cout << "Performance Options:" << std::endl;
     std::cout << "  --enable-memory-opt            Enable memory optimization" << std::endl;
     std::cout << "  --disable-memory-opt           Disable memory optimization" << std::endl;
     std::cout << "  --enable-perf-logging          Enable performance logging" << std::endl;
-    std::cout << "  --max-buffer-size BYTES        Max audio buffer size (default: 1048576)" << std::endl;
+    std::cout << "  --max-buffer-size BYTES        Max buffered audio per session, 16-bit PCM bytes (default: 4194304)" << std::endl;
+    std::cout << "  --max-total-buffer-size BYTES  Max buffered audio across all sessions, 0 = unlimited (default: 268435456)" << std::endl;
+    std::cout << "  --audio-overflow-policy NAME   On overflow: drop_oldest, reject or close (default: reject)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Tracing Options:" << std::endl;
+    std::cout << "  --trace                        Record per-utterance latency trace events (GET /trace, SIGUSR1)" << std::endl;
+    std::cout << "  --trace-buffer NUM             Trace ring buffer size in events (default: 262144)" << std::endl;
+    std::cout << "  --trace-output PREFIX          File prefix for SIGUSR1 trace dumps (default: ./asr_trace)" << std::endl;
+    std::cout << std::endl;
+    std::cout << "Batch Transcription Options (no server is started):" << std::endl;
+    std::cout << "  --transcribe PATH              WAV file, directory (searched for *.wav) or list file, one path per line" << std::endl;
+    std::cout << "  --transcribe-output FILE       JSONL result file (default: transcripts.jsonl)" << std::endl;
+    std::cout << "  --transcribe-jobs NUM          Files processed concurrently, 0 = batch size x pool size x 2 (default: 0)" << std::endl;
+    std::cout << "  --transcribe-resume            Skip files already in the output file and append" << std::endl;
     std::cout << std::endl;
     std::cout << "Environment Variables:" << std::endl;
-    std::cout << "  SERVER_PORT, MODELS_ROOT, LOG_LEVEL, MAX_CONNECTIONS" << std::endl;
-    std::cout << "  ASR_POOL_SIZE, ASR_NUM_THREADS, ASR_ACQUIRE_TIMEOUT_MS, ASR_MODEL_NAME" << std::endl;
-    std::cout << "  ASR_LANGUAGE, ASR_USE_ITN, ASR_DEBUG" << std::endl;
+    std::cout << "  SERVER_PORT, MODELS_ROOT, LOG_LEVEL, MAX_CONNECTIONS, MAX_DECODE_BACKLOG_MS, IO_THREADS, WORKER_THREADS" << std::endl;
+    std::cout << "  ASR_POOL_SIZE, ASR_SHARE_WEIGHTS, ASR_NUM_THREADS, ASR_ACQUIRE_TIMEOUT_MS, ASR_MODEL_NAME" << std::endl;
+    std::cout << "  ASR_LANGUAGE, ASR_USE_ITN, ASR_DEBUG, ASR_BATCH_SIZE, ASR_BATCH_TIMEOUT_MS" << std::endl;
     std::cout << "  VAD_THRESHOLD, VAD_MIN_SILENCE_DURATION, VAD_MIN_SPEECH_DURATION" << std::endl;
-    std::cout << "  VAD_MAX_SPEECH_DURATION, VAD_POOL_MIN_SIZE, VAD_POOL_MAX_SIZE, VAD_DEBUG" << std::endl;
-    std::cout << "  ENABLE_MEMORY_OPTIMIZATION, MAX_AUDIO_BUFFER_SIZE, ENABLE_PERFORMANCE_LOGGING" << std::endl;
+    std::cout << "  VAD_MAX_SPEECH_DURATION, VAD_BATCHED, VAD_MAX_BATCH_SIZE, VAD_NUM_THREADS, VAD_DEBUG" << std::endl;
+    std::cout << "  PARTIAL_INCREMENTAL, PARTIAL_WINDOW_S" << std::endl;
+    std::cout << "  ONESHOT_MAX_DURATION_S, ONESHOT_EXPECTED_DURATION_S, ONESHOT_SEGMENT_THRESHOLD_S" << std::endl;
+    std::cout << "  ONESHOT_DECODE_WHILE_RECORDING" << std::endl;
+    std::cout << "  ENABLE_MEMORY_OPTIMIZATION, MAX_AUDIO_BUFFER_SIZE, MAX_TOTAL_AUDIO_BUFFER_SIZE" << std::endl;
+    std::cout << "  AUDIO_OVERFLOW_POLICY, ENABLE_PERFORMANCE_LOGGING" << std::endl;
+    std::cout << "  TRACE_ENABLED, TRACE_BUFFER_EVENTS, TRACE_OUTPUT" << std::endl;
     std::cout << std::endl;
     std::cout << "  --help, -h                     Show this help message" << std::endl;
 }
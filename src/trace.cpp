@@ -0,0 +1,215 @@
+#include "trace.h"
+#include "logger.h"
+#include <json/json.h>
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <unordered_set>
+#include <vector>
+
+namespace tracing {
+
+namespace {
+
+const char* lane_name(uint8_t lane) {
+    switch (static_cast<Lane>(lane)) {
+        case Lane::IO: return "io";
+        case Lane::PROCESSING: return "processing";
+        case Lane::DECODE: return "decode";
+    }
+    return "other";
+}
+
+// 读取时复制出的事件
+struct Snapshot {
+    const char* name;
+    uint64_t ts_us;
+    uint64_t dur_us;
+    uint32_t track;
+    uint8_t lane;
+    char phase;
+    int64_t arg;
+};
+
+} // namespace
+
+Tracer::~Tracer() {
+    stop();
+}
+
+Tracer& Tracer::instance() {
+    static Tracer tracer;
+    return tracer;
+}
+
+void Tracer::start(size_t buffer_events, const std::string& path) {
+    if (enabled.load()) return;
+
+    origin = std::chrono::steady_clock::now();
+    capacity = std::max<size_t>(buffer_events, 1024);
+    events.reset(new Event[capacity]);
+    track_names.reset(new TrackName[kMaxTrackNames]);
+    output_path = path;
+
+    running = true;
+    dump_thread = std::thread(&Tracer::dump_loop, this);
+    enabled.store(true, std::memory_order_release);
+    LOG_INFO("TRACE", "Tracing enabled, buffer: " << capacity << " events, SIGUSR1 dumps to " << output_path << "-*.json");
+}
+
+void Tracer::stop() {
+    enabled.store(false);
+    if (running.exchange(false) && dump_thread.joinable()) {
+        dump_thread.join();
+    }
+}
+
+uint32_t Tracer::register_track(const std::string& name) {
+    if (!is_enabled()) return 0;
+
+    uint32_t track = next_track.fetch_add(1, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(track_names_mutex);
+    TrackName& slot = track_names[track % kMaxTrackNames];
+    slot.track = track;
+    slot.name = name;
+    return track;
+}
+
+void Tracer::record(uint32_t track, Lane lane, char phase, const char* name,
+                    TimePoint start, TimePoint end, int64_t arg) {
+    if (!is_enabled()) return;
+
+    uint64_t position = head.fetch_add(1, std::memory_order_relaxed);
+    Event& event = events[position % capacity];
+    event.seq.store(2 * position + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    event.name.store(name, std::memory_order_relaxed);
+    event.ts_us.store(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(start - origin).count()), std::memory_order_relaxed);
+    event.dur_us.store(static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::microseconds>(end - start).count()), std::memory_order_relaxed);
+    event.track.store(track, std::memory_order_relaxed);
+    event.lane.store(static_cast<uint8_t>(lane), std::memory_order_relaxed);
+    event.phase.store(phase, std::memory_order_relaxed);
+    event.arg.store(arg, std::memory_order_relaxed);
+
+    event.seq.store(2 * position + 2, std::memory_order_release);
+}
+
+std::string Tracer::to_chrome_json() {
+    std::vector<Snapshot> snapshot;
+    if (is_enabled()) {
+        uint64_t end = head.load(std::memory_order_acquire);
+        uint64_t begin = end > capacity ? end - capacity : 0;
+        snapshot.reserve(static_cast<size_t>(end - begin));
+
+        for (uint64_t position = begin; position < end; ++position) {
+            const Event& event = events[position % capacity];
+            if (event.seq.load(std::memory_order_acquire) != 2 * position + 2) continue;
+            Snapshot copy{event.name.load(std::memory_order_relaxed),
+                          event.ts_us.load(std::memory_order_relaxed),
+                          event.dur_us.load(std::memory_order_relaxed),
+                          event.track.load(std::memory_order_relaxed),
+                          event.lane.load(std::memory_order_relaxed),
+                          event.phase.load(std::memory_order_relaxed),
+                          event.arg.load(std::memory_order_relaxed)};
+            std::atomic_thread_fence(std::memory_order_acquire);
+            // 读取期间被写者覆盖则丢弃
+            if (event.seq.load(std::memory_order_relaxed) != 2 * position + 2) continue;
+            snapshot.push_back(copy);
+        }
+    }
+
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    char buffer[256];
+    auto append = [&](const char* text) {
+        if (!first) out += ",\n";
+        out += text;
+        first = false;
+    };
+
+    // 元数据：轨道名为会话ID，行名为Lane
+    std::unordered_set<uint32_t> tracks;
+    for (const auto& event : snapshot) tracks.insert(event.track);
+    {
+        std::lock_guard<std::mutex> lock(track_names_mutex);
+        for (uint32_t track : tracks) {
+            const TrackName& slot = track_names[track % kMaxTrackNames];
+            std::string name = slot.track == track ? slot.name : "session " + std::to_string(track);
+            std::string metadata = "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + std::to_string(track) +
+                                   ",\"args\":{\"name\":" + Json::valueToQuotedString(name.c_str()) + "}}";
+            append(metadata.c_str());
+            for (uint8_t lane = 1; lane <= static_cast<uint8_t>(Lane::DECODE); ++lane) {
+                std::snprintf(buffer, sizeof(buffer),
+                              "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+                              track, lane, lane_name(lane));
+                append(buffer);
+            }
+        }
+    }
+
+    uint64_t async_id = 0;
+    for (const auto& event : snapshot) {
+        if (event.phase == 'i') {
+            std::snprintf(buffer, sizeof(buffer),
+                          "{\"name\":\"%s\",\"cat\":\"asr\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%" PRIu64
+                          ",\"pid\":%u,\"tid\":%u,\"args\":{\"value\":%" PRId64 "}}",
+                          event.name, event.ts_us, event.track, event.lane, event.arg);
+            append(buffer);
+        } else if (static_cast<Lane>(event.lane) == Lane::DECODE) {
+            // 同一会话的解码请求可能重叠，用异步事件对避免错误嵌套
+            ++async_id;
+            std::snprintf(buffer, sizeof(buffer),
+                          "{\"name\":\"%s\",\"cat\":\"decode\",\"ph\":\"b\",\"id\":%" PRIu64 ",\"ts\":%" PRIu64
+                          ",\"pid\":%u,\"tid\":%u,\"args\":{\"value\":%" PRId64 "}}",
+                          event.name, async_id, event.ts_us, event.track, event.lane, event.arg);
+            append(buffer);
+            std::snprintf(buffer, sizeof(buffer),
+                          "{\"name\":\"%s\",\"cat\":\"decode\",\"ph\":\"e\",\"id\":%" PRIu64 ",\"ts\":%" PRIu64
+                          ",\"pid\":%u,\"tid\":%u}",
+                          event.name, async_id, event.ts_us + event.dur_us, event.track, event.lane);
+            append(buffer);
+        } else {
+            std::snprintf(buffer, sizeof(buffer),
+                          "{\"name\":\"%s\",\"cat\":\"asr\",\"ph\":\"X\",\"ts\":%" PRIu64 ",\"dur\":%" PRIu64
+                          ",\"pid\":%u,\"tid\":%u,\"args\":{\"value\":%" PRId64 "}}",
+                          event.name, event.ts_us, event.dur_us, event.track, event.lane, event.arg);
+            append(buffer);
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool Tracer::write_file(const std::string& path) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        LOG_ERROR("TRACE", "Cannot open trace file: " << path);
+        return false;
+    }
+    file << to_chrome_json();
+    return static_cast<bool>(file);
+}
+
+void Tracer::dump_loop() {
+    while (running.load()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        if (!dump_requested.exchange(false)) continue;
+
+        char suffix[32];
+        std::time_t now = std::time(nullptr);
+        std::tm local_time{};
+        localtime_r(&now, &local_time);
+        std::strftime(suffix, sizeof(suffix), "-%Y%m%d-%H%M%S.json", &local_time);
+        std::string path = output_path + suffix;
+        if (write_file(path)) {
+            LOG_INFO("TRACE", "Trace written to " << path);
+        }
+    }
+}
+
+} // namespace tracing
@@ -0,0 +1,853 @@
+#include "vad_service.h"
+#include "server_config.h"
+#include "logger.h"
+#include <algorithm>
+#include <exception>
+
+#ifdef ASR_ENABLE_BATCHED_VAD
+#include <onnxruntime_cxx_api.h>
+#endif
+
+using namespace sherpa_onnx::cxx;
+
+namespace {
+
+// 与sherpa-onnx的silero VAD相同的判决与分段规则，按样本数计时。
+// 区别在于超过最大语音时长时直接切段，保证语音段不超出会话的环形缓冲区
+struct SpeechSegmenter {
+    float threshold = 0.5f;
+    uint64_t window_size = 512;
+    uint64_t min_silence_samples = 0;
+    uint64_t min_speech_samples = 0;
+    uint64_t max_speech_samples = 0;
+
+    uint64_t current = 0;
+    bool triggered = false;
+    uint64_t temp_start = 0;
+    uint64_t temp_end = 0;
+
+    bool in_segment = false;
+    uint64_t segment_start = 0;
+    uint64_t last_segment_end = 0;
+
+    bool is_speech(float prob) {
+        current += window_size;
+
+        if (prob > threshold && temp_end != 0) {
+            temp_end = 0;
+        }
+        if (prob > threshold && temp_start == 0) {
+            // 开始说话，但需满足最小语音时长
+            temp_start = current;
+            return false;
+        }
+        if (prob > threshold && temp_start != 0 && !triggered) {
+            if (current - temp_start < min_speech_samples) return false;
+            triggered = true;
+            return true;
+        }
+        if (prob < threshold && !triggered) {
+            temp_start = 0;
+            temp_end = 0;
+            return false;
+        }
+        if (prob > threshold - 0.15f && triggered) {
+            return true;
+        }
+        if (prob < threshold && triggered) {
+            if (temp_end == 0) temp_end = current;
+            if (current - temp_end < min_silence_samples) return true;
+            // 静音足够长，语音结束
+            temp_start = 0;
+            temp_end = 0;
+            triggered = false;
+            return false;
+        }
+        return false;
+    }
+
+    // 处理一个窗口的语音概率，有语音段结束时写入segment并返回true
+    bool accept(float prob, VADSegment& segment) {
+        if (is_speech(prob)) {
+            if (!in_segment) {
+                // 与sherpa-onnx一致，向前多保留两个窗口和最小语音时长
+                uint64_t lookback = 2 * window_size + min_speech_samples;
+                segment_start = std::max(current > lookback ? current - lookback : 0, last_segment_end);
+                in_segment = true;
+            } else if (max_speech_samples > 0 && current - segment_start >= max_speech_samples) {
+                segment = {segment_start, current};
+                segment_start = last_segment_end = current;
+                return true;
+            }
+        } else if (in_segment) {
+            segment = {segment_start, current};
+            last_segment_end = current;
+            in_segment = false;
+            return true;
+        }
+        return false;
+    }
+
+    // 输入在end处结束，未结束的语音段作为最后一段输出
+    bool finish(uint64_t end, VADSegment& segment) {
+        if (!in_segment) return false;
+        segment = {segment_start, std::max(end, segment_start)};
+        last_segment_end = segment.end;
+        in_segment = false;
+        return true;
+    }
+
+    // 当前或之后的语音段可能开始的最早位置，之前的样本不会再被用到
+    uint64_t earliest_start() const {
+        if (in_segment) return segment_start;
+        uint64_t lookback = 2 * window_size + min_speech_samples;
+        return std::max(current > lookback ? current - lookback : 0, last_segment_end);
+    }
+};
+
+void configure_segmenter(SpeechSegmenter& segmenter, const VadModelConfig& config, int window_size) {
+    const float sample_rate = static_cast<float>(config.sample_rate);
+    segmenter.threshold = config.silero_vad.threshold;
+    segmenter.window_size = static_cast<uint64_t>(window_size);
+    segmenter.min_silence_samples = static_cast<uint64_t>(config.silero_vad.min_silence_duration * sample_rate);
+    segmenter.min_speech_samples = static_cast<uint64_t>(config.silero_vad.min_speech_duration * sample_rate);
+    segmenter.max_speech_samples = static_cast<uint64_t>(config.silero_vad.max_speech_duration * sample_rate);
+}
+
+} // namespace
+
+// ---- silero批量推理模型 ----
+
+#ifdef ASR_ENABLE_BATCHED_VAD
+
+// 直接通过ONNX Runtime加载silero模型，输入输出按名称绑定，兼容两种版本：
+// v4: input[B, N], sr, h[2, B, 64], c[2, B, 64] -> output[B, 1], hn, cn
+// v5: input[B, 64 + N], state[2, B, 128], sr -> output[B, 1], stateN（输入前拼接上一窗口末尾的上下文）
+class VADService::SileroBatchModel {
+private:
+    enum class InputKind { AUDIO, SAMPLE_RATE, STATE };
+
+    Ort::Env env;
+    std::unique_ptr<Ort::Session> session;
+    Ort::MemoryInfo memory_info = Ort::MemoryInfo::CreateCpu(OrtDeviceAllocator, OrtMemTypeCPU);
+
+    std::vector<std::string> input_names;
+    std::vector<std::string> output_names;
+    std::vector<const char*> input_name_ptrs;
+    std::vector<const char*> output_name_ptrs;
+    std::vector<InputKind> input_kinds;
+    std::vector<int> input_state_index;    // 输入为状态时对应的状态序号
+    std::vector<int> output_state_index;   // 输出为状态时对应的状态序号，-1为语音概率
+
+    int num_states = 0;
+    int64_t state_dim = 0;
+    int context_size = 0;
+    bool sr_is_scalar = true;
+    int64_t sample_rate = 16000;
+
+public:
+    SileroBatchModel(const std::string& model_path, int rate, int num_threads)
+        : env(ORT_LOGGING_LEVEL_WARNING, "silero_vad"), sample_rate(rate) {
+        Ort::SessionOptions options;
+        options.SetIntraOpNumThreads(num_threads);
+        options.SetInterOpNumThreads(1);
+        session = std::make_unique<Ort::Session>(env, model_path.c_str(), options);
+
+        Ort::AllocatorWithDefaultOptions allocator;
+        for (size_t i = 0; i < session->GetInputCount(); ++i) {
+            std::string name = session->GetInputNameAllocated(i, allocator).get();
+            if (name == "input") {
+                input_kinds.push_back(InputKind::AUDIO);
+                input_state_index.push_back(-1);
+            } else if (name == "sr") {
+                input_kinds.push_back(InputKind::SAMPLE_RATE);
+                input_state_index.push_back(-1);
+                sr_is_scalar = session->GetInputTypeInfo(i).GetTensorTypeAndShapeInfo().GetShape().empty();
+            } else {
+                // h/c（v4）或state（v5），形状均为[2, batch, dim]
+                auto shape = session->GetInputTypeInfo(i).GetTensorTypeAndShapeInfo().GetShape();
+                if (shape.size() != 3 || shape[2] <= 0) {
+                    throw std::runtime_error("Unsupported silero VAD input: " + name);
+                }
+                state_dim = shape[2];
+                input_kinds.push_back(InputKind::STATE);
+                input_state_index.push_back(num_states++);
+            }
+            input_names.push_back(name);
+        }
+
+        for (size_t i = 0; i < session->GetOutputCount(); ++i) {
+            std::string name = session->GetOutputNameAllocated(i, allocator).get();
+            int state_index = -1;
+            if (name != "output") {
+                // hn -> h, cn -> c, stateN -> state
+                std::string state_name = name.substr(0, name.size() - 1);
+                for (size_t j = 0; j < input_names.size(); ++j) {
+                    if (input_names[j] == state_name) state_index = input_state_index[j];
+                }
+                if (state_index < 0) {
+                    throw std::runtime_error("Unsupported silero VAD output: " + name);
+                }
+            }
+            output_names.push_back(name);
+            output_state_index.push_back(state_index);
+        }
+
+        if (num_states == 0) {
+            throw std::runtime_error("Silero VAD model has no recurrent state inputs");
+        }
+        // 单一state输入的是v5模型，需要拼接上下文
+        if (num_states == 1) {
+            context_size = (sample_rate == 16000) ? 64 : 32;
+        }
+
+        for (const auto& name : input_names) input_name_ptrs.push_back(name.c_str());
+        for (const auto& name : output_names) output_name_ptrs.push_back(name.c_str());
+    }
+
+    int get_context_size() const { return context_size; }
+
+    // 每个流的状态长度，布局为[state][layer][dim]
+    size_t get_state_size() const { return static_cast<size_t>(num_states * 2 * state_dim); }
+
+    // input为batch行、每行input_len个样本；states为batch个流的状态，推理后原地更新。
+    // 调度线程和分段器所在的工作线程会并发调用（Ort::Session::Run线程安全），状态缓冲区按调用分配
+    void run(float* input, size_t batch, size_t input_len, float* states, float* probs) {
+        const size_t state_size = get_state_size();
+        const int64_t batch_size = static_cast<int64_t>(batch);
+
+        // 把各流的状态拼成[2, batch, dim]
+        std::vector<std::vector<float>> state_buffers(num_states);
+        for (int s = 0; s < num_states; ++s) {
+            auto& buffer = state_buffers[s];
+            buffer.resize(2 * batch * state_dim);
+            for (size_t b = 0; b < batch; ++b) {
+                for (int layer = 0; layer < 2; ++layer) {
+                    const float* src = states + b * state_size + (s * 2 + layer) * state_dim;
+                    std::copy(src, src + state_dim, buffer.data() + (layer * batch + b) * state_dim);
+                }
+            }
+        }
+
+        int64_t sr_value = sample_rate;
+        const int64_t sr_shape[1] = {1};
+        const int64_t input_shape[2] = {batch_size, static_cast<int64_t>(input_len)};
+        const int64_t state_shape[3] = {2, batch_size, state_dim};
+
+        std::vector<Ort::Value> inputs;
+        inputs.reserve(input_kinds.size());
+        for (size_t i = 0; i < input_kinds.size(); ++i) {
+            switch (input_kinds[i]) {
+                case InputKind::AUDIO:
+                    inputs.push_back(Ort::Value::CreateTensor<float>(
+                        memory_info, input, batch * input_len, input_shape, 2));
+                    break;
+                case InputKind::SAMPLE_RATE:
+                    inputs.push_back(Ort::Value::CreateTensor<int64_t>(
+                        memory_info, &sr_value, 1, sr_shape, sr_is_scalar ? 0 : 1));
+                    break;
+                case InputKind::STATE: {
+                    auto& buffer = state_buffers[input_state_index[i]];
+                    inputs.push_back(Ort::Value::CreateTensor<float>(
+                        memory_info, buffer.data(), buffer.size(), state_shape, 3));
+                    break;
+                }
+            }
+        }
+
+        auto outputs = session->Run(Ort::RunOptions{nullptr},
+                                    input_name_ptrs.data(), inputs.data(), inputs.size(),
+                                    output_name_ptrs.data(), output_name_ptrs.size());
+
+        for (size_t i = 0; i < outputs.size(); ++i) {
+            const float* data = outputs[i].GetTensorData<float>();
+            int s = output_state_index[i];
+            if (s < 0) {
+                std::copy(data, data + batch, probs);
+                continue;
+            }
+            // 把[2, batch, dim]拆回各流
+            for (size_t b = 0; b < batch; ++b) {
+                for (int layer = 0; layer < 2; ++layer) {
+                    const float* src = data + (layer * batch + b) * state_dim;
+                    std::copy(src, src + state_dim, states + b * state_size + (s * 2 + layer) * state_dim);
+                }
+            }
+        }
+    }
+};
+
+#else
+
+// 编译时未找到ONNX Runtime头文件，批处理模式不可用
+class VADService::SileroBatchModel {
+public:
+    int get_context_size() const { return 0; }
+    size_t get_state_size() const { return 0; }
+    void run(float*, size_t, size_t, float*, float*) {}
+};
+
+#endif
+
+// ---- 批处理流 ----
+
+struct VADService::StreamState {
+    // 调度线程读取窗口时持有source_mutex，流销毁时置空source，保证不会读取已释放的缓冲区
+    std::mutex source_mutex;
+    const AudioRingBuffer* source;
+    EventCallback on_event;
+
+    std::atomic<uint64_t> available_end{0};
+    std::atomic<uint64_t> processed{0};
+    std::atomic<bool> queued{false};
+    std::atomic<bool> detected{false};
+    std::atomic<bool> closed{false};
+
+    // 以下仅由调度线程访问
+    std::vector<float> recurrent_state;
+    std::vector<float> context;
+    SpeechSegmenter segmenter;
+
+    std::mutex segments_mutex;
+    std::deque<VADSegment> segments;
+    std::atomic<size_t> segment_count{0};
+
+    StreamState(const AudioRingBuffer* src, EventCallback callback)
+        : source(src), on_event(std::move(callback)) {}
+};
+
+class VADService::BatchedStream : public VADStream {
+private:
+    VADService* service;
+    std::shared_ptr<StreamState> state;
+
+public:
+    BatchedStream(VADService* svc, std::shared_ptr<StreamState> st)
+        : service(svc), state(std::move(st)) {
+        service->active_streams++;
+    }
+
+    ~BatchedStream() override {
+        {
+            std::lock_guard<std::mutex> lock(state->source_mutex);
+            state->source = nullptr;
+        }
+        state->closed = true;
+        service->active_streams--;
+    }
+
+    void advance_to(uint64_t end) override {
+        state->available_end.store(end, std::memory_order_release);
+        // 与调度线程清除queued后的复查配对，保证新窗口不会被遗漏
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (end - state->processed.load() >= static_cast<uint64_t>(service->window_size) &&
+            !state->queued.exchange(true)) {
+            service->enqueue(state);
+        }
+    }
+
+    uint64_t get_processed_samples() const override {
+        return state->processed.load(std::memory_order_acquire);
+    }
+
+    bool is_detected() const override {
+        return state->detected.load();
+    }
+
+    bool pop_segment(VADSegment& segment) override {
+        if (state->segment_count.load() == 0) return false;
+
+        std::lock_guard<std::mutex> lock(state->segments_mutex);
+        if (state->segments.empty()) return false;
+        segment = state->segments.front();
+        state->segments.pop_front();
+        state->segment_count--;
+        return true;
+    }
+};
+
+// ---- 回退模式：每个流独立的sherpa-onnx VAD ----
+
+class VADService::SherpaStream : public VADStream {
+private:
+    VADService* service;
+    const AudioRingBuffer* source;
+    VoiceActivityDetector vad;
+    uint64_t processed = 0;
+    std::vector<float> scratch;     // 跨越环形缓冲区末尾的窗口
+
+public:
+    SherpaStream(VADService* svc, const AudioRingBuffer* src, VoiceActivityDetector detector)
+        : service(svc), source(src), vad(std::move(detector)) {
+        service->active_streams++;
+    }
+
+    ~SherpaStream() override {
+        service->active_streams--;
+    }
+
+    void advance_to(uint64_t end) override {
+        const uint64_t window = static_cast<uint64_t>(service->window_size);
+        while (processed + window <= end) {
+            vad.AcceptWaveform(source->view(processed, window, scratch), service->window_size);
+            processed += window;
+        }
+    }
+
+    uint64_t get_processed_samples() const override { return processed; }
+
+    bool is_detected() const override { return vad.IsDetected(); }
+
+    bool pop_segment(VADSegment& segment) override {
+        if (vad.IsEmpty()) return false;
+        auto speech = vad.Front();
+        vad.Pop();
+        segment.begin = static_cast<uint64_t>(speech.start);
+        segment.end = segment.begin + speech.samples.size();
+        return true;
+    }
+};
+
+// ---- 分段器 ----
+
+// 共用批处理模型的分段器：在调用线程上逐窗口推理（batch为1），只保存本分段器的
+// 循环状态和上下文。keep_samples时保留可能属于当前或之后语音段的样本
+class VADService::BatchedSegmenter : public VADSegmenter {
+private:
+    SileroBatchModel* model;
+    size_t window;
+    size_t context_size;
+    std::vector<float> recurrent_state;
+    std::vector<float> input;   // 上下文 + 一个窗口
+    std::vector<float> tail;    // 不足一个窗口的剩余样本
+    SpeechSegmenter segmenter;
+    std::deque<VADSegment> segments;
+    uint64_t received = 0;
+
+    bool keep_samples;
+    std::vector<float> history; // [history_start, received)范围内的样本
+    uint64_t history_start = 0;
+
+    void run_window(const float* samples) {
+        std::copy(samples, samples + window, input.begin() + context_size);
+        float prob = 0.0f;
+        model->run(input.data(), 1, input.size(), recurrent_state.data(), &prob);
+        // 本窗口末尾作为下一窗口的上下文
+        std::copy(input.end() - context_size, input.end(), input.begin());
+
+        VADSegment segment;
+        if (segmenter.accept(prob, segment)) segments.push_back(segment);
+    }
+
+    // 丢弃不会再被任何语音段用到的样本，至少积累一半才移动，避免每次都搬移缓冲区
+    void trim_history() {
+        uint64_t keep_from = segmenter.earliest_start();
+        if (!segments.empty()) keep_from = std::min(keep_from, segments.front().begin);
+        if (keep_from <= history_start) return;
+        size_t drop = static_cast<size_t>(std::min<uint64_t>(keep_from - history_start, history.size()));
+        if (drop * 2 < history.size()) return;
+        history.erase(history.begin(), history.begin() + drop);
+        history_start += drop;
+    }
+
+public:
+    BatchedSegmenter(SileroBatchModel* silero, const VadModelConfig& config, int window_size, bool keep)
+        : model(silero), window(static_cast<size_t>(window_size)),
+          context_size(static_cast<size_t>(silero->get_context_size())),
+          recurrent_state(silero->get_state_size(), 0.0f),
+          input(context_size + window, 0.0f), keep_samples(keep) {
+        configure_segmenter(segmenter, config, window_size);
+        tail.reserve(window);
+    }
+
+    void accept(const float* samples, size_t count) override {
+        if (keep_samples) history.insert(history.end(), samples, samples + count);
+        received += count;
+
+        size_t offset = 0;
+        if (!tail.empty()) {
+            offset = std::min(window - tail.size(), count);
+            tail.insert(tail.end(), samples, samples + offset);
+            if (tail.size() < window) return;
+            run_window(tail.data());
+            tail.clear();
+        }
+        for (; offset + window <= count; offset += window) {
+            run_window(samples + offset);
+        }
+        tail.insert(tail.end(), samples + offset, samples + count);
+
+        if (keep_samples) trim_history();
+    }
+
+    void flush() override {
+        VADSegment segment;
+        if (segmenter.finish(received, segment)) segments.push_back(segment);
+    }
+
+    bool pop_segment(VADSegment& segment, std::vector<float>* samples) override {
+        if (segments.empty()) return false;
+        segment = segments.front();
+        segments.pop_front();
+
+        if (samples) {
+            samples->clear();
+            if (keep_samples) {
+                uint64_t begin = std::max(segment.begin, history_start) - history_start;
+                uint64_t end = std::min<uint64_t>(std::max(segment.end, history_start) - history_start, history.size());
+                if (begin < end) samples->assign(history.begin() + begin, history.begin() + end);
+            }
+        }
+        if (keep_samples) trim_history();
+        return true;
+    }
+};
+
+// 回退模式的分段器：借用服务空闲池中的sherpa-onnx VAD，销毁时Reset后归还
+class VADService::SherpaSegmenter : public VADSegmenter {
+private:
+    VADService* service;
+    VoiceActivityDetector vad;
+    size_t step;
+
+public:
+    SherpaSegmenter(VADService* svc, VoiceActivityDetector detector, size_t step_samples)
+        : service(svc), vad(std::move(detector)), step(std::max<size_t>(step_samples, 1)) {}
+
+    ~SherpaSegmenter() override {
+        try {
+            vad.Reset();
+            std::lock_guard<std::mutex> lock(service->detectors_mutex);
+            service->idle_detectors.push_back(std::move(vad));
+        } catch (const std::exception& e) {
+            LOG_ERROR("VAD_SERVICE", "Error returning VAD instance to pool: " << e.what());
+        }
+    }
+
+    void accept(const float* samples, size_t count) override {
+        for (size_t offset = 0; offset < count; offset += step) {
+            vad.AcceptWaveform(samples + offset, static_cast<int32_t>(std::min(step, count - offset)));
+        }
+    }
+
+    void flush() override {
+        vad.Flush();
+    }
+
+    bool pop_segment(VADSegment& segment, std::vector<float>* samples) override {
+        if (vad.IsEmpty()) return false;
+        auto speech = vad.Front();
+        vad.Pop();
+        segment.begin = static_cast<uint64_t>(speech.start);
+        segment.end = segment.begin + speech.samples.size();
+        if (samples) *samples = std::move(speech.samples);
+        return true;
+    }
+};
+
+// ---- VADService ----
+
+VADService::VADService() {}
+
+VADService::~VADService() {
+    shutdown();
+}
+
+bool VADService::initialize(const std::string& model_dir, const ServerConfig& config) {
+    const auto& vad_config_params = config.get_vad_config();
+    sample_rate = static_cast<int>(vad_config_params.sample_rate);
+    window_size = (sample_rate == 8000) ? 256 : 512;
+    max_batch_size = static_cast<size_t>(vad_config_params.max_batch_size);
+
+    std::string model_path = model_dir + "/silero_vad/silero_vad.onnx";
+
+    sherpa_config.silero_vad.model = model_path;
+    sherpa_config.silero_vad.threshold = vad_config_params.threshold;
+    sherpa_config.silero_vad.min_silence_duration = vad_config_params.min_silence_duration;
+    sherpa_config.silero_vad.min_speech_duration = vad_config_params.min_speech_duration;
+    sherpa_config.silero_vad.max_speech_duration = vad_config_params.max_speech_duration;
+    sherpa_config.silero_vad.window_size = window_size;
+    sherpa_config.sample_rate = sample_rate;
+    sherpa_config.num_threads = vad_config_params.num_threads;
+    sherpa_config.debug = vad_config_params.debug;
+    // 回退模式下VAD内部缓冲区只需容纳最长的一句话
+    sherpa_buffer_seconds = vad_config_params.max_speech_duration + 2.0f;
+
+    if (vad_config_params.batched) {
+#ifdef ASR_ENABLE_BATCHED_VAD
+        try {
+            batch_model = std::make_unique<SileroBatchModel>(model_path, sample_rate, vad_config_params.num_threads);
+        } catch (const std::exception& e) {
+            LOG_WARN("VAD_SERVICE", "Failed to load silero model for batched VAD: " << e.what()
+                     << ", falling back to per-session VAD");
+            batch_model.reset();
+        }
+#else
+        LOG_WARN("VAD_SERVICE", "Built without ONNX Runtime headers, falling back to per-session VAD");
+#endif
+    }
+
+    if (batch_model) {
+        stopping = false;
+        dispatcher = std::thread(&VADService::dispatcher_loop, this);
+        LOG_INFO("VAD_SERVICE", "Batched VAD initialized (window: " << window_size
+                 << ", max batch: " << max_batch_size << ")");
+    } else {
+        // 校验sherpa-onnx VAD配置
+        try {
+            auto test_vad = VoiceActivityDetector::Create(sherpa_config, sherpa_buffer_seconds);
+            if (!test_vad.Get()) {
+                LOG_ERROR("VAD_SERVICE", "Failed to validate VAD configuration");
+                return false;
+            }
+            // 校验用的实例留给分段器复用
+            std::lock_guard<std::mutex> lock(detectors_mutex);
+            idle_detectors.push_back(std::move(test_vad));
+        } catch (const std::exception& e) {
+            LOG_ERROR("VAD_SERVICE", "Error initializing VAD: " << e.what());
+            return false;
+        }
+        LOG_INFO("VAD_SERVICE", "Per-session VAD initialized (window: " << window_size << ")");
+    }
+
+    initialized = true;
+    return true;
+}
+
+void VADService::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        if (stopping) return;
+        stopping = true;
+        pending_streams.clear();
+    }
+    pending_cv.notify_all();
+
+    if (dispatcher.joinable()) {
+        dispatcher.join();
+        LOG_INFO("VAD_SERVICE", "VAD dispatcher stopped");
+    }
+}
+
+std::unique_ptr<VADStream> VADService::create_stream(const AudioRingBuffer* source, EventCallback on_event) {
+    if (!initialized.load()) {
+        LOG_ERROR("VAD_SERVICE", "VAD service not initialized");
+        return nullptr;
+    }
+
+    if (batch_model) {
+        auto state = std::make_shared<StreamState>(source, std::move(on_event));
+        state->recurrent_state.assign(batch_model->get_state_size(), 0.0f);
+        state->context.assign(batch_model->get_context_size(), 0.0f);
+
+        configure_segmenter(state->segmenter, sherpa_config, window_size);
+
+        return std::make_unique<BatchedStream>(this, std::move(state));
+    }
+
+    try {
+        auto vad = VoiceActivityDetector::Create(sherpa_config, sherpa_buffer_seconds);
+        if (!vad.Get()) {
+            LOG_ERROR("VAD_SERVICE", "Failed to create VAD instance");
+            return nullptr;
+        }
+        return std::make_unique<SherpaStream>(this, source, std::move(vad));
+    } catch (const std::exception& e) {
+        LOG_ERROR("VAD_SERVICE", "Error creating VAD instance: " << e.what());
+        return nullptr;
+    }
+}
+
+std::unique_ptr<VADSegmenter> VADService::create_segmenter(bool keep_samples) {
+    if (!initialized.load()) {
+        LOG_ERROR("VAD_SERVICE", "VAD service not initialized");
+        return nullptr;
+    }
+
+    if (batch_model) {
+        return std::make_unique<BatchedSegmenter>(batch_model.get(), sherpa_config, window_size, keep_samples);
+    }
+
+    try {
+        {
+            std::lock_guard<std::mutex> lock(detectors_mutex);
+            if (!idle_detectors.empty()) {
+                auto vad = std::move(idle_detectors.back());
+                idle_detectors.pop_back();
+                // 每次推理约1秒音频
+                return std::make_unique<SherpaSegmenter>(this, std::move(vad), static_cast<size_t>(window_size) * 32);
+            }
+        }
+        // 空闲池为空时才加载新的实例，归还后供之后的分段器复用
+        auto vad = VoiceActivityDetector::Create(sherpa_config, sherpa_buffer_seconds);
+        if (!vad.Get()) {
+            LOG_ERROR("VAD_SERVICE", "Failed to create VAD instance");
+            return nullptr;
+        }
+        return std::make_unique<SherpaSegmenter>(this, std::move(vad), static_cast<size_t>(window_size) * 32);
+    } catch (const std::exception& e) {
+        LOG_ERROR("VAD_SERVICE", "Error creating VAD segmenter: " << e.what());
+        return nullptr;
+    }
+}
+
+bool VADService::segment_offline(const float* samples, size_t count, std::vector<VADSegment>& segments) {
+    // 只需要语音段位置，分段器不保留样本
+    auto segmenter = create_segmenter(false);
+    if (!segmenter) return false;
+
+    try {
+        // 每送入约1秒音频就取出已结束的语音段，回退模式下VAD内部缓冲区只需容纳当前语音段
+        const size_t step = static_cast<size_t>(window_size) * 32;
+        VADSegment segment;
+        for (size_t offset = 0; offset < count; offset += step) {
+            segmenter->accept(samples + offset, std::min(step, count - offset));
+            while (segmenter->pop_segment(segment)) segments.push_back(segment);
+        }
+        segmenter->flush();
+        while (segmenter->pop_segment(segment)) segments.push_back(segment);
+        return true;
+    } catch (const std::exception& e) {
+        LOG_ERROR("VAD_SERVICE", "Error in offline VAD segmentation: " << e.what());
+        return false;
+    }
+}
+
+float VADService::get_average_batch_size() const {
+    size_t batches = total_batches.load();
+    if (batches == 0) return 0.0f;
+    return static_cast<float>(total_windows.load()) / batches;
+}
+
+void VADService::enqueue(std::shared_ptr<StreamState> state) {
+    {
+        std::lock_guard<std::mutex> lock(pending_mutex);
+        if (stopping) return;
+        pending_streams.push_back(std::move(state));
+    }
+    pending_cv.notify_one();
+}
+
+// 每轮取出最多max_batch_size个有待判决窗口的流，每个流一个窗口（循环状态决定了
+// 同一流的窗口必须按顺序推理），推理期间到达的窗口自然累积到下一轮
+void VADService::dispatcher_loop() {
+    std::vector<std::shared_ptr<StreamState>> batch;
+    batch.reserve(max_batch_size);
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(pending_mutex);
+            pending_cv.wait(lock, [this] { return !pending_streams.empty() || stopping; });
+            if (stopping) break;
+
+            while (!pending_streams.empty() && batch.size() < max_batch_size) {
+                batch.push_back(std::move(pending_streams.front()));
+                pending_streams.pop_front();
+            }
+        }
+
+        try {
+            run_batch(batch);
+        } catch (const std::exception& e) {
+            LOG_ERROR("VAD_SERVICE", "Error in batched VAD inference: " << e.what());
+        }
+        batch.clear();
+    }
+}
+
+void VADService::run_batch(std::vector<std::shared_ptr<StreamState>>& batch) {
+    const uint64_t window = static_cast<uint64_t>(window_size);
+    const size_t context_size = static_cast<size_t>(batch_model->get_context_size());
+    const size_t input_len = context_size + window;
+    const size_t state_size = batch_model->get_state_size();
+
+    // 收集本轮可推理的窗口
+    std::vector<StreamState*> ready;
+    ready.reserve(batch.size());
+    std::vector<float> input(batch.size() * input_len);
+    std::vector<float> states(batch.size() * state_size);
+
+    for (auto& state : batch) {
+        if (state->closed) continue;
+
+        uint64_t position = state->processed.load();
+        if (state->available_end.load(std::memory_order_acquire) - position < window) continue;
+
+        std::lock_guard<std::mutex> lock(state->source_mutex);
+        if (!state->source) continue;
+
+        float* row = input.data() + ready.size() * input_len;
+        std::copy(state->context.begin(), state->context.end(), row);
+        state->source->copy_to(position, window, row + context_size);
+        std::copy(state->recurrent_state.begin(), state->recurrent_state.end(),
+                  states.data() + ready.size() * state_size);
+        ready.push_back(state.get());
+    }
+
+    std::vector<float> probs(ready.size(), 0.0f);
+    if (!ready.empty()) {
+        try {
+            batch_model->run(input.data(), ready.size(), input_len, states.data(), probs.data());
+            total_batches++;
+            total_windows += ready.size();
+        } catch (const std::exception& e) {
+            // 推理失败时按静音处理并保持原状态，避免会话停滞
+            LOG_ERROR("VAD_SERVICE", "Batched VAD inference failed: " << e.what());
+            std::fill(probs.begin(), probs.end(), 0.0f);
+            for (size_t i = 0; i < ready.size(); ++i) {
+                std::copy(ready[i]->recurrent_state.begin(), ready[i]->recurrent_state.end(),
+                          states.data() + i * state_size);
+            }
+        }
+    }
+
+    // 更新各流的状态和分段
+    std::vector<StreamState*> notify;
+    for (size_t i = 0; i < ready.size(); ++i) {
+        StreamState* state = ready[i];
+        const float* row = input.data() + i * input_len;
+        std::copy(row + input_len - context_size, row + input_len, state->context.begin());
+        std::copy(states.data() + i * state_size, states.data() + (i + 1) * state_size,
+                  state->recurrent_state.begin());
+
+        bool was_detected = state->detected.load();
+        VADSegment segment;
+        bool segment_ended = state->segmenter.accept(probs[i], segment);
+        bool detected = state->segmenter.triggered;
+
+        if (segment_ended) {
+            std::lock_guard<std::mutex> lock(state->segments_mutex);
+            state->segments.push_back(segment);
+            state->segment_count++;
+        }
+        state->detected = detected;
+        state->processed.store(state->segmenter.current, std::memory_order_release);
+
+        if (segment_ended || detected != was_detected) {
+            notify.push_back(state);
+        }
+    }
+
+    // 仍有完整窗口的流排到队尾等待下一轮，否则清除queued后复查，与advance_to配对
+    for (auto& state : batch) {
+        if (state->closed) continue;
+
+        uint64_t available = state->available_end.load(std::memory_order_acquire);
+        if (available - state->processed.load() >= window) {
+            enqueue(state);
+            continue;
+        }
+        state->queued.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (state->available_end.load() - state->processed.load() >= window &&
+            !state->queued.exchange(true)) {
+            enqueue(state);
+        }
+    }
+
+    for (StreamState* state : notify) {
+        if (state->on_event && !state->closed) {
+            state->on_event();
+        }
+    }
+}
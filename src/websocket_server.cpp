@@ -1,7 +1,13 @@
 #include "websocket_server.h"
 #include "oneshot_asr_session.h"
 #include "server_config.h"
+#include "audio_budget.h"
+#include "audio_ingest.h"
 #include "logger.h"
+#include "metrics.h"
+#include "trace.h"
+#include <json/json.h>
+#include <cctype>
 #include <iostream>
 #include <thread>
 #include <chrono>
@@ -27,6 +33,11 @@ WebSocketASRServer::WebSocketASRServer(const ServerConfig& config)
         on_message(hdl, msg);
     });
     
+    // 握手阶段：协商结果格式子协议
+    ws_server.set_validate_handler([this](connection_hdl hdl) {
+        return on_validate(hdl);
+    });
+    
     ws_server.set_open_handler([this](connection_hdl hdl) {
         on_open(hdl);
     });
@@ -35,6 +46,16 @@ WebSocketASRServer::WebSocketASRServer(const ServerConfig& config)
         on_close(hdl);
     });
     
+    // 普通HTTP请求：GET /metrics、GET /trace、POST /transcribe
+    ws_server.set_http_handler([this](connection_hdl hdl) {
+        on_http(hdl);
+    });
+    
+    // POST /transcribe的请求体按双声道容纳一句话识别的最大时长（另留64KB给WAV头），超出时返回413；
+    // 下混后的时长在解码请求体后再检查
+    const float max_body_seconds = config_->get_oneshot_config().max_duration_s;
+    ws_server.set_max_http_body_size(static_cast<size_t>(max_body_seconds * config_->get_vad_config().sample_rate) * 2 * 2 + 64 * 1024);
+    
     ws_server.set_reuse_addr(true);
     
     const auto& server_settings = config_->get_server_settings();
@@ -50,6 +71,7 @@ bool WebSocketASRServer::initialize() {
     LOG_INFO("SERVER", "Initializing ASR engine...");
     const auto& server_settings = config_->get_server_settings();
     bool success = asr_engine.initialize(server_settings.models_root, *config_);
+    AudioMemoryBudget::instance().set_limit(config_->get_performance_config().max_total_audio_buffer_size);
     if (success) {
         LOG_INFO("SERVER", "ASR engine initialized successfully");
         start_monitoring();
@@ -74,11 +96,35 @@ void WebSocketASRServer::run() {
         LOG_INFO("SERVER", "WebSocket ASR server listening on port " << server_settings.port);
         LOG_INFO("SERVER", "Streaming ASR endpoint: ws://localhost:" << server_settings.port << "/sttRealtime");
         LOG_INFO("SERVER", "OneShot ASR endpoint: ws://localhost:" << server_settings.port << "/oneshot");
+        LOG_INFO("SERVER", "Metrics endpoint: http://localhost:" << server_settings.port << "/metrics");
+        if (tracing::Tracer::instance().is_enabled()) {
+            LOG_INFO("SERVER", "Trace endpoint: http://localhost:" << server_settings.port << "/trace");
+        }
+        
+        // 当前线程之外再启动io_threads-1个线程运行同一个io_service
+        int num_io_threads = server_settings.io_threads;
+        for (int i = 1; i < num_io_threads; ++i) {
+            io_threads.emplace_back([this]() {
+                try {
+                    ws_server.run();
+                } catch (const std::exception& e) {
+                    LOG_ERROR("SERVER", "Error in I/O thread: " << e.what());
+                }
+            });
+        }
+        LOG_INFO("SERVER", "Running event loop on " << num_io_threads << " I/O threads");
         
         ws_server.run();
     } catch (const std::exception& e) {
         LOG_ERROR("SERVER", "Error running server: " << e.what());
     }
+    
+    for (auto& thread : io_threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    io_threads.clear();
 }
 
 void WebSocketASRServer::stop() {
@@ -87,7 +133,7 @@ void WebSocketASRServer::stop() {
     
     // Stop all streaming sessions
     {
-        std::lock_guard<std::mutex> lock(sessions_mutex);
+        std::unique_lock<std::shared_mutex> lock(sessions_mutex);
         for (auto& pair : sessions) {
             if (pair.second) {
                 pair.second->stop();
@@ -98,7 +144,7 @@ void WebSocketASRServer::stop() {
     
     // Stop all oneshot sessions
     {
-        std::lock_guard<std::mutex> lock(oneshot_sessions_mutex);
+        std::unique_lock<std::shared_mutex> lock(oneshot_sessions_mutex);
         for (auto& pair : oneshot_sessions) {
             if (pair.second) {
                 pair.second->stop();
@@ -143,11 +189,25 @@ void WebSocketASRServer::monitor_performance() {
                  << ", Active connections: " << connections 
                  << ", Active streaming sessions: " << sessions_count
                  << ", Active oneshot sessions: " << oneshot_sessions_count
+                 << ", HTTP requests in flight: " << http_in_flight.load()
+                 << ", Rejected (limit/backlog): " << rejected_connection_limit.load()
+                 << "/" << rejected_decode_backlog.load()
                  << ", ASR pool (total/available/in_use): " 
                  << pool_stats.total_instances << "/" 
                  << pool_stats.available_instances << "/" 
                  << pool_stats.in_use_instances);
         
+        // 解码器占用：区分是副本不够（高占用、长队列）还是主机整体过载
+        if (SharedASREngine* shared_asr = asr_engine.get_shared_asr()) {
+            auto occupancy_10s = shared_asr->get_occupancy(10);
+            auto occupancy_60s = shared_asr->get_occupancy(60);
+            LOG_INFO("SERVER", "Decoder utilization (10s/60s): " 
+                     << static_cast<int>(occupancy_10s.busy_fraction * 100) << "%/"
+                     << static_cast<int>(occupancy_60s.busy_fraction * 100) << "%"
+                     << ", decode queue avg/max (60s): " << occupancy_60s.average_queue 
+                     << "/" << occupancy_60s.max_queue);
+        }
+        
         // 如果池使用率过高，发出警告
         if (pool_stats.available_instances == 0 && pool_stats.total_instances > 0) {
             LOG_WARN("SERVER", "ASR pool fully utilized - consider increasing pool size");
@@ -156,7 +216,7 @@ void WebSocketASRServer::monitor_performance() {
         // Log individual session stats
         std::vector<std::string> client_ids = connection_manager.get_all_client_ids();
         for (const auto& client_id : client_ids) {
-            std::lock_guard<std::mutex> lock(sessions_mutex);
+            std::shared_lock<std::shared_mutex> lock(sessions_mutex);
             auto it = sessions.find(client_id);
             if (it != sessions.end() && it->second && it->second->is_running()) {
                 LOG_DEBUG("SERVER", "Session " << client_id << " is active");
@@ -172,23 +232,34 @@ void WebSocketASRServer::on_open(connection_hdl hdl) {
     // 检查连接的端点类型
     bool is_oneshot = is_oneshot_endpoint(hdl);
     std::string endpoint_path = get_endpoint_path(hdl);
+    ResultFormat result_format = get_result_format(hdl);
     
     if (is_oneshot) {
         // 创建一句话识别会话
-        std::lock_guard<std::mutex> lock(oneshot_sessions_mutex);
-        auto session = std::make_unique<OneShotASRSession>(&asr_engine, hdl, &ws_server, client_id);
+        auto session = std::make_shared<OneShotASRSession>(&asr_engine, hdl, &ws_server, client_id, result_format);
         session->start();
-        oneshot_sessions[client_id] = std::move(session);
+        bind_message_handler(hdl, [this, session, client_id](connection_hdl, message_ptr msg) {
+            handle_oneshot_message(*session, client_id, msg);
+        });
+        {
+            std::unique_lock<std::shared_mutex> lock(oneshot_sessions_mutex);
+            oneshot_sessions[client_id] = std::move(session);
+        }
         active_oneshot_sessions++;
         
         LOG_INFO(client_id, "New OneShot WebSocket connection opened on " << endpoint_path 
                  << ". Total connections: " << connection_manager.get_connection_count());
     } else {
-        // 创建流式识别会话
-        std::lock_guard<std::mutex> lock(sessions_mutex);
-        auto session = std::make_unique<ASRSession>(&asr_engine, hdl, &ws_server, client_id);
+        // 创建流式识别会话（VAD获取可能等待，不持有会话表锁）
+        auto session = std::make_shared<ASRSession>(&asr_engine, hdl, &ws_server, client_id, result_format);
         session->start();
-        sessions[client_id] = std::move(session);
+        bind_message_handler(hdl, [this, session, client_id](connection_hdl, message_ptr msg) {
+            handle_streaming_message(*session, client_id, msg);
+        });
+        {
+            std::unique_lock<std::shared_mutex> lock(sessions_mutex);
+            sessions[client_id] = std::move(session);
+        }
         active_sessions++;
         
         LOG_INFO(client_id, "New Streaming WebSocket connection opened on " << endpoint_path 
@@ -200,83 +271,283 @@ void WebSocketASRServer::on_close(connection_hdl hdl) {
     std::string client_id = connection_manager.get_client_id(hdl);
     connection_manager.remove_connection(hdl);
     
-    // 首先尝试从流式会话中移除
+    // 首先尝试从流式会话中移除；会话在锁外停止，避免阻塞其他I/O线程的查找
+    std::shared_ptr<ASRSession> session;
     {
-        std::lock_guard<std::mutex> lock(sessions_mutex);
+        std::unique_lock<std::shared_mutex> lock(sessions_mutex);
         auto it = sessions.find(client_id);
         if (it != sessions.end()) {
-            if (it->second) {
-                it->second->stop();
-                active_sessions--;
-            }
+            session = std::move(it->second);
             sessions.erase(it);
-            LOG_INFO(client_id, "Streaming WebSocket connection closed. Remaining connections: " 
-                     << connection_manager.get_connection_count());
-            return;
         }
     }
+    if (session) {
+        session->stop();
+        active_sessions--;
+        LOG_INFO(client_id, "Streaming WebSocket connection closed. Remaining connections: " 
+                 << connection_manager.get_connection_count());
+        return;
+    }
     
     // 然后尝试从一句话识别会话中移除
+    std::shared_ptr<OneShotASRSession> oneshot_session;
     {
-        std::lock_guard<std::mutex> lock(oneshot_sessions_mutex);
+        std::unique_lock<std::shared_mutex> lock(oneshot_sessions_mutex);
         auto it = oneshot_sessions.find(client_id);
         if (it != oneshot_sessions.end()) {
-            if (it->second) {
-                it->second->stop();
-                active_oneshot_sessions--;
-            }
+            oneshot_session = std::move(it->second);
             oneshot_sessions.erase(it);
-            LOG_INFO(client_id, "OneShot WebSocket connection closed. Remaining connections: " 
-                     << connection_manager.get_connection_count());
-            return;
         }
     }
+    if (oneshot_session) {
+        oneshot_session->stop();
+        active_oneshot_sessions--;
+        LOG_INFO(client_id, "OneShot WebSocket connection closed. Remaining connections: " 
+                 << connection_manager.get_connection_count());
+        return;
+    }
     
     LOG_WARN(client_id, "Connection closed but session not found");
 }
 
+// 连接打开时把会话绑定到该连接自己的消息处理器：之后每一帧直接交给会话，
+// 不再经过ConnectionManager的全局锁和会话表查找。处理器持有会话，随连接对象一起释放
+void WebSocketASRServer::bind_message_handler(connection_hdl hdl, server::message_handler handler) {
+    try {
+        ws_server.get_con_from_hdl(hdl)->set_message_handler(std::move(handler));
+    } catch (const std::exception& e) {
+        // 绑定失败时由端点级的on_message按client_id查找会话
+        LOG_WARN("SERVER", "Error binding connection message handler: " << e.what());
+    }
+}
+
 void WebSocketASRServer::on_message(connection_hdl hdl, message_ptr msg) {
     std::string client_id = connection_manager.get_client_id(hdl);
     
-    // 首先尝试处理流式会话消息
-    {
-        std::lock_guard<std::mutex> lock(sessions_mutex);
-        auto it = sessions.find(client_id);
-        if (it != sessions.end() && it->second) {
-            if (msg->get_opcode() == websocketpp::frame::opcode::binary) {
-                const std::string& payload = msg->get_payload();
-                std::vector<uint8_t> pcm_data(payload.begin(), payload.end());
-                it->second->add_audio_data(pcm_data);
-                LOG_DEBUG(client_id, "Received " << pcm_data.size() << " bytes of audio data for streaming");
-            } else {
-                LOG_WARN(client_id, "Received non-binary message for streaming session, ignoring");
-            }
-            return;
+    if (auto session = find_session(client_id)) {
+        handle_streaming_message(*session, client_id, msg);
+        return;
+    }
+    if (auto session = find_oneshot_session(client_id)) {
+        handle_oneshot_message(*session, client_id, msg);
+        return;
+    }
+    
+    LOG_WARN(client_id, "Received message for unknown session");
+}
+
+void WebSocketASRServer::handle_streaming_message(ASRSession& session, const std::string& client_id, message_ptr msg) {
+    if (msg->get_opcode() == websocketpp::frame::opcode::binary) {
+        // 直接从消息负载转换，不再复制到中间缓冲区
+        const std::string& payload = msg->get_payload();
+        ServerMetrics& metrics = ServerMetrics::instance();
+        metrics.frames_received.inc();
+        metrics.bytes_received.inc(payload.size());
+        
+        tracing::ScopedSpan frame_span(session.get_trace_track(), tracing::Lane::IO, "on_message");
+        frame_span.arg = static_cast<int64_t>(payload.size());
+        session.add_audio_data(reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+        LOG_DEBUG(client_id, "Received " << payload.size() << " bytes of audio data for streaming");
+    } else {
+        LOG_WARN(client_id, "Received non-binary message for streaming session, ignoring");
+    }
+}
+
+void WebSocketASRServer::handle_oneshot_message(OneShotASRSession& session, const std::string& client_id, message_ptr msg) {
+    if (msg->get_opcode() == websocketpp::frame::opcode::text) {
+        // 处理控制消息（start/stop）
+        const std::string& payload = msg->get_payload();
+        session.handle_message(payload);
+        LOG_DEBUG(client_id, "Received control message for oneshot: " << payload);
+    } else if (msg->get_opcode() == websocketpp::frame::opcode::binary) {
+        // 处理音频数据
+        const std::string& payload = msg->get_payload();
+        ServerMetrics& metrics = ServerMetrics::instance();
+        metrics.frames_received.inc();
+        metrics.bytes_received.inc(payload.size());
+        
+        session.add_audio_data(reinterpret_cast<const uint8_t*>(payload.data()), payload.size());
+        LOG_DEBUG(client_id, "Received " << payload.size() << " bytes of audio data for oneshot");
+    }
+}
+
+bool WebSocketASRServer::on_validate(connection_hdl hdl) {
+    server::connection_ptr con;
+    try {
+        con = ws_server.get_con_from_hdl(hdl);
+    } catch (const std::exception& e) {
+        LOG_ERROR("SERVER", "Error validating connection: " << e.what());
+        return false;
+    }
+    
+    if (!admit_connection(con, false)) {
+        return false;
+    }
+    
+    // 客户端在Sec-WebSocket-Protocol中提供二进制结果子协议时选用它，否则保持JSON文本帧
+    for (const auto& subprotocol : con->get_requested_subprotocols()) {
+        if (subprotocol == ResultWriter::kBinarySubprotocol) {
+            con->select_subprotocol(subprotocol);
+            break;
         }
     }
+    return true;
+}
+
+bool WebSocketASRServer::admit_connection(server::connection_ptr con, bool http_request) {
+    const auto& server_settings = config_->get_server_settings();
     
-    // 然后尝试处理一句话识别会话消息
-    {
-        std::lock_guard<std::mutex> lock(oneshot_sessions_mutex);
-        auto it = oneshot_sessions.find(client_id);
-        if (it != oneshot_sessions.end() && it->second) {
-            if (msg->get_opcode() == websocketpp::frame::opcode::text) {
-                // 处理控制消息（start/stop）
-                const std::string& payload = msg->get_payload();
-                it->second->handle_message(payload);
-                LOG_DEBUG(client_id, "Received control message for oneshot: " << payload);
-            } else if (msg->get_opcode() == websocketpp::frame::opcode::binary) {
-                // 处理音频数据
-                const std::string& payload = msg->get_payload();
-                std::vector<uint8_t> pcm_data(payload.begin(), payload.end());
-                it->second->add_audio_data(pcm_data);
-                LOG_DEBUG(client_id, "Received " << pcm_data.size() << " bytes of audio data for oneshot");
+    // 并发握手之间不加锁，瞬时最多超出I/O线程数个连接
+    size_t connections = connection_manager.get_connection_count() + http_in_flight.load();
+    if (connections >= static_cast<size_t>(server_settings.max_connections)) {
+        (http_request ? http_rejected_connection_limit : rejected_connection_limit)++;
+        con->set_status(websocketpp::http::status_code::service_unavailable);
+        con->append_header("Retry-After", "1");
+        LOG_WARN("SERVER", "Rejected connection from " << con->get_remote_endpoint()
+                 << ": connection limit reached (" << connections << "/" << server_settings.max_connections << ")");
+        return false;
+    }
+    
+    // 新会话的第一个解码请求至少要等完当前积压
+    SharedASREngine* shared_asr = asr_engine.get_shared_asr();
+    if (server_settings.max_decode_backlog_ms > 0 && shared_asr) {
+        double backlog_ms = shared_asr->estimate_backlog_seconds() * 1000.0;
+        if (backlog_ms > server_settings.max_decode_backlog_ms) {
+            (http_request ? http_rejected_decode_backlog : rejected_decode_backlog)++;
+            con->set_status(websocketpp::http::status_code::service_unavailable);
+            con->append_header("Retry-After", "1");
+            LOG_WARN("SERVER", "Rejected connection from " << con->get_remote_endpoint()
+                     << ": estimated decode backlog " << static_cast<int>(backlog_ms) << "ms exceeds "
+                     << server_settings.max_decode_backlog_ms << "ms");
+            return false;
+        }
+    }
+    return true;
+}
+
+void WebSocketASRServer::on_http(connection_hdl hdl) {
+    server::connection_ptr con;
+    try {
+        con = ws_server.get_con_from_hdl(hdl);
+    } catch (const std::exception& e) {
+        LOG_ERROR("SERVER", "Error getting HTTP connection: " << e.what());
+        return;
+    }
+    
+    std::string resource = con->get_resource();
+    std::string path = resource.substr(0, resource.find('?'));
+    if (path == "/metrics") {
+        con->set_status(websocketpp::http::status_code::ok);
+        con->append_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
+        con->set_body(render_metrics());
+    } else if (path == "/trace" && tracing::Tracer::instance().is_enabled()) {
+        // 导出当前环形缓冲区，保存为.json后用chrome://tracing或Perfetto打开
+        con->set_status(websocketpp::http::status_code::ok);
+        con->append_header("Content-Type", "application/json");
+        con->set_body(tracing::Tracer::instance().to_chrome_json());
+    } else if (path == "/transcribe") {
+        handle_transcribe(hdl, con);
+    } else {
+        con->set_status(websocketpp::http::status_code::not_found);
+        con->set_body("Not Found\n");
+    }
+}
+
+std::string WebSocketASRServer::render_metrics() {
+    metrics::ExpositionWriter writer;
+    
+    writer.family("asr_connections_total", "WebSocket connections accepted", "counter");
+    writer.sample("asr_connections_total", "", static_cast<double>(total_connections.load()));
+    
+    writer.family("asr_connections_rejected_total", "WebSocket handshakes rejected by admission control", "counter");
+    writer.sample("asr_connections_rejected_total", "reason=\"connection_limit\"",
+                  static_cast<double>(rejected_connection_limit.load()));
+    writer.sample("asr_connections_rejected_total", "reason=\"decode_backlog\"",
+                  static_cast<double>(rejected_decode_backlog.load()));
+    
+    writer.family("asr_http_requests_rejected_total", "POST /transcribe requests rejected by admission control or the audio budget", "counter");
+    writer.sample("asr_http_requests_rejected_total", "reason=\"connection_limit\"",
+                  static_cast<double>(http_rejected_connection_limit.load()));
+    writer.sample("asr_http_requests_rejected_total", "reason=\"decode_backlog\"",
+                  static_cast<double>(http_rejected_decode_backlog.load()));
+    writer.sample("asr_http_requests_rejected_total", "reason=\"audio_budget\"",
+                  static_cast<double>(http_rejected_audio_budget.load()));
+    
+    writer.family("asr_http_requests_in_flight", "POST /transcribe requests being processed", "gauge");
+    writer.sample("asr_http_requests_in_flight", "", static_cast<double>(http_in_flight.load()));
+    
+    writer.family("asr_audio_buffered_bytes", "Unprocessed audio buffered across all sessions (16-bit PCM bytes)", "gauge");
+    writer.sample("asr_audio_buffered_bytes", "", static_cast<double>(AudioMemoryBudget::instance().get_used()));
+    
+    writer.family("asr_sessions", "Active sessions", "gauge");
+    writer.sample("asr_sessions", "type=\"streaming\"", static_cast<double>(active_sessions.load()));
+    writer.sample("asr_sessions", "type=\"oneshot\"", static_cast<double>(active_oneshot_sessions.load()));
+    
+    if (asr_engine.is_initialized()) {
+        auto stats = asr_engine.get_system_stats();
+        
+        writer.family("asr_decode_replicas", "ASR recognizer replicas", "gauge");
+        writer.sample("asr_decode_replicas", "", static_cast<double>(stats.asr_total_replicas));
+        writer.family("asr_decode_replicas_in_use", "ASR recognizer replicas currently decoding", "gauge");
+        writer.sample("asr_decode_replicas_in_use", "", static_cast<double>(stats.asr_in_use_replicas));
+        writer.family("asr_decode_queue_length", "Requests waiting in the shared decode queue", "gauge");
+        writer.sample("asr_decode_queue_length", "", static_cast<double>(stats.asr_queue_length));
+        if (SharedASREngine* shared_asr = asr_engine.get_shared_asr()) {
+            writer.family("asr_decode_backlog_estimate_seconds", "Estimated decode wait for a new request, used by admission control", "gauge");
+            writer.sample("asr_decode_backlog_estimate_seconds", "", shared_asr->estimate_backlog_seconds());
+        }
+        writer.family("asr_decode_in_flight", "Requests queued or decoding", "gauge");
+        writer.sample("asr_decode_in_flight", "", static_cast<double>(stats.asr_active_recognitions));
+        
+        SharedASREngine* shared_asr = asr_engine.get_shared_asr();
+        if (shared_asr) {
+            static const int windows[] = {1, 10, 60};
+            metrics::OccupancyWindow::Summary occupancy[3];
+            for (int i = 0; i < 3; ++i) {
+                occupancy[i] = shared_asr->get_occupancy(windows[i]);
+            }
+            writer.family("asr_decoder_utilization", "Fraction of recognizer replicas busy, averaged over the window", "gauge");
+            for (int i = 0; i < 3; ++i) {
+                writer.sample("asr_decoder_utilization", "window=\"" + std::to_string(windows[i]) + "s\"", occupancy[i].busy_fraction);
+            }
+            writer.family("asr_decode_queue_length_avg", "Sampled decode queue length, averaged over the window", "gauge");
+            for (int i = 0; i < 3; ++i) {
+                writer.sample("asr_decode_queue_length_avg", "window=\"" + std::to_string(windows[i]) + "s\"", occupancy[i].average_queue);
+            }
+            writer.family("asr_decode_queue_length_max", "Largest sampled decode queue length in the window", "gauge");
+            for (int i = 0; i < 3; ++i) {
+                writer.sample("asr_decode_queue_length_max", "window=\"" + std::to_string(windows[i]) + "s\"", static_cast<double>(occupancy[i].max_queue));
             }
-            return;
         }
+        
+        writer.family("asr_vad_streams", "Active VAD streams (one per streaming session)", "gauge");
+        writer.sample("asr_vad_streams", "", static_cast<double>(stats.vad_active_streams));
+        writer.family("asr_vad_batched", "1 if VAD runs batched on a shared model", "gauge");
+        writer.sample("asr_vad_batched", "", stats.vad_batched ? 1.0 : 0.0);
+        writer.family("asr_vad_average_batch_size", "Average number of VAD windows per batch", "gauge");
+        writer.sample("asr_vad_average_batch_size", "", stats.vad_average_batch_size);
+        
+        WorkerPool* worker_pool = asr_engine.get_worker_pool();
+        writer.family("asr_worker_threads", "Worker pool threads", "gauge");
+        writer.sample("asr_worker_threads", "", static_cast<double>(worker_pool->get_thread_count()));
+        writer.family("asr_worker_queue_length", "Tasks waiting for a worker thread", "gauge");
+        writer.sample("asr_worker_queue_length", "", static_cast<double>(worker_pool->get_queue_length()));
     }
     
-    LOG_WARN(client_id, "Received message for unknown session");
+    ServerMetrics::instance().write(writer);
+    return writer.str();
+}
+
+std::shared_ptr<ASRSession> WebSocketASRServer::find_session(const std::string& client_id) {
+    std::shared_lock<std::shared_mutex> lock(sessions_mutex);
+    auto it = sessions.find(client_id);
+    return (it != sessions.end()) ? it->second : nullptr;
+}
+
+std::shared_ptr<OneShotASRSession> WebSocketASRServer::find_oneshot_session(const std::string& client_id) {
+    std::shared_lock<std::shared_mutex> lock(oneshot_sessions_mutex);
+    auto it = oneshot_sessions.find(client_id);
+    return (it != oneshot_sessions.end()) ? it->second : nullptr;
 }
 
 bool WebSocketASRServer::is_oneshot_endpoint(connection_hdl hdl) {
@@ -290,6 +561,234 @@ bool WebSocketASRServer::is_oneshot_endpoint(connection_hdl hdl) {
     }
 }
 
+namespace {
+
+// 解码URI查询参数中的%XX与'+'
+std::string percent_decode(const std::string& value) {
+    std::string decoded;
+    decoded.reserve(value.size());
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (value[i] == '+') {
+            decoded += ' ';
+        } else if (value[i] == '%' && i + 2 < value.size() &&
+                   std::isxdigit(static_cast<unsigned char>(value[i + 1])) &&
+                   std::isxdigit(static_cast<unsigned char>(value[i + 2]))) {
+            decoded += static_cast<char>(std::stoi(value.substr(i + 1, 2), nullptr, 16));
+            i += 2;
+        } else {
+            decoded += value[i];
+        }
+    }
+    return decoded;
+}
+
+// 在查询串（不含'?'）中查找参数，found为false表示不存在
+std::string get_query_param(const std::string& query, const std::string& key, bool& found) {
+    found = false;
+    size_t start = 0;
+    while (start < query.size()) {
+        size_t end = query.find('&', start);
+        if (end == std::string::npos) end = query.size();
+        size_t eq = query.find('=', start);
+        size_t name_end = (eq == std::string::npos || eq > end) ? end : eq;
+        if (percent_decode(query.substr(start, name_end - start)) == key) {
+            found = true;
+            return name_end < end ? percent_decode(query.substr(name_end + 1, end - name_end - 1)) : "";
+        }
+        start = end + 1;
+    }
+    return "";
+}
+
+} // namespace
+
+ResultFormat WebSocketASRServer::get_result_format(connection_hdl hdl) {
+    ResultFormat format;
+    try {
+        auto con = ws_server.get_con_from_hdl(hdl);
+        format.binary = con->get_subprotocol() == ResultWriter::kBinarySubprotocol;
+        
+        // ?fields=text,timestamps 只返回指定字段，未指定时返回全部字段
+        bool found = false;
+        std::string fields = get_query_param(con->get_uri()->get_query(), "fields", found);
+        if (found) {
+            std::string unknown;
+            format.fields = parse_result_fields(fields, &unknown);
+            if (!unknown.empty()) {
+                LOG_WARN("SERVER", "Ignoring unknown result fields: " << unknown);
+            }
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR("SERVER", "Error getting result format: " << e.what());
+    }
+    return format;
+}
+
+namespace {
+
+// 发送被推迟的HTTP响应，调用线程可以是工作线程或解码线程
+void send_deferred_response(server::connection_ptr con, websocketpp::http::status_code::value status,
+                            const std::string& body, const char* content_type) {
+    try {
+        con->set_status(status);
+        con->append_header("Content-Type", content_type);
+        con->set_body(body);
+        websocketpp::lib::error_code ec;
+        con->send_http_response(ec);
+        if (ec) {
+            LOG_ERROR("SERVER", "Error sending HTTP response: " << ec.message());
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR("SERVER", "Error sending HTTP response: " << e.what());
+    }
+}
+
+void send_deferred_error(server::connection_ptr con, websocketpp::http::status_code::value status,
+                         const std::string& message) {
+    Json::Value error_json;
+    error_json["type"] = "error";
+    error_json["message"] = message;
+    
+    Json::StreamWriterBuilder builder;
+    builder["indentation"] = "";
+    send_deferred_response(con, status, Json::writeString(builder, error_json), "application/json");
+}
+
+void send_transcribe_result(server::connection_ptr con, RecognitionResult result, uint32_t fields) {
+    ASRResult asr_result;
+    asr_result.text = std::move(result.text);
+    asr_result.finished = true;
+    asr_result.idx = 0;
+    if (fields & RESULT_FIELD_LANG) {
+        asr_result.lang = result.language.empty() ? "auto" : std::move(result.language);
+    }
+    // 只取出请求的字段，不依赖引擎是否已按掩码裁剪识别结果
+    if (fields & RESULT_FIELD_EMOTION) asr_result.emotion = std::move(result.emotion);
+    if (fields & RESULT_FIELD_EVENT) asr_result.event = std::move(result.event);
+    if (fields & RESULT_FIELD_TIMESTAMPS) asr_result.timestamps = std::move(result.timestamps);
+    if (fields & RESULT_FIELD_TOKENS) asr_result.tokens = std::move(result.tokens);
+    
+    // 序列化时同样按掩码写出字段，与WebSocket结果一致
+    ResultWriter writer;
+    send_deferred_response(con, websocketpp::http::status_code::ok, 
+                           writer.write_json(asr_result, fields), "application/json");
+    ServerMetrics::instance().http_results_sent.inc();
+}
+
+// 一个转写请求占用的准入名额与音频预算，最后一个持有者（发送响应的线程）释放时归还
+struct TranscribeRequest {
+    std::atomic<size_t>& in_flight;
+    size_t budget_bytes;
+    
+    TranscribeRequest(std::atomic<size_t>& counter, size_t bytes) : in_flight(counter), budget_bytes(bytes) {
+        ++in_flight;
+    }
+    ~TranscribeRequest() {
+        AudioMemoryBudget::instance().release(budget_bytes);
+        --in_flight;
+    }
+};
+
+} // namespace
+
+void WebSocketASRServer::handle_transcribe(connection_hdl hdl, server::connection_ptr con) {
+    if (con->get_request().get_method() != "POST") {
+        con->set_status(websocketpp::http::status_code::method_not_allowed);
+        con->append_header("Allow", "POST");
+        con->set_body("Method Not Allowed\n");
+        return;
+    }
+    
+    // 与WebSocket握手相同的准入控制，拒绝时已设置503
+    if (!admit_connection(con, true)) return;
+    
+    SharedASREngine* shared_asr = asr_engine.get_shared_asr();
+    WorkerPool* worker_pool = asr_engine.get_worker_pool();
+    if (!shared_asr || !shared_asr->is_initialized() || !worker_pool) {
+        con->set_status(websocketpp::http::status_code::service_unavailable);
+        con->set_body("ASR engine not available\n");
+        return;
+    }
+    
+    // 请求体和转换出的浮点音频（16位PCM的两倍大小）计入全局音频预算，直到响应发出
+    size_t budget_bytes = con->get_request_body().size() * 3;
+    if (!AudioMemoryBudget::instance().try_acquire(budget_bytes)) {
+        http_rejected_audio_budget++;
+        con->set_status(websocketpp::http::status_code::service_unavailable);
+        con->append_header("Retry-After", "1");
+        LOG_WARN("SERVER", "Rejected transcribe request from " << con->get_remote_endpoint()
+                 << ": audio buffer budget exhausted");
+        return;
+    }
+    auto request = std::make_shared<TranscribeRequest>(http_in_flight, budget_bytes);
+    
+    uint32_t fields = get_result_format(hdl).fields;
+    const auto& oneshot_config = config_->get_oneshot_config();
+    const float sample_rate = asr_engine.get_sample_rate();
+    const size_t max_samples = static_cast<size_t>(oneshot_config.max_duration_s * sample_rate);
+    const size_t segment_threshold = static_cast<size_t>(oneshot_config.segment_threshold_s * sample_rate);
+    
+    // 响应推迟到解码完成：I/O线程只负责收包，格式转换在工作线程上进行，解码由调度线程组批
+    websocketpp::lib::error_code ec = con->defer_http_response();
+    if (ec) {
+        LOG_ERROR("SERVER", "Error deferring HTTP response: " << ec.message());
+        con->set_status(websocketpp::http::status_code::internal_server_error);
+        return;
+    }
+    
+    const ASREngine* engine = &asr_engine;
+    worker_pool->post([con, request, engine, fields, sample_rate, max_samples, segment_threshold]() {
+        // 以"RIFF"开头的请求体按WAV解析，其他按16位小端单声道PCM（采样率与模型一致）
+        const std::string& body = con->get_request_body();
+        std::vector<float> samples;
+        if (body.size() >= 4 && body.compare(0, 4, "RIFF") == 0) {
+            std::string error;
+            if (!audio_ingest::decode_wav(reinterpret_cast<const uint8_t*>(body.data()), body.size(),
+                                          static_cast<int>(sample_rate), samples, error)) {
+                send_deferred_error(con, websocketpp::http::status_code::unsupported_media_type, error);
+                return;
+            }
+        } else {
+            audio_ingest::append_pcm16le(body.data(), body.size(), samples);
+        }
+        
+        if (samples.empty()) {
+            send_deferred_error(con, websocketpp::http::status_code::bad_request, "No audio data received");
+            return;
+        }
+        if (samples.size() > max_samples) {
+            send_deferred_error(con, websocketpp::http::status_code::request_entity_too_large,
+                                "Audio exceeds maximum duration of " + 
+                                std::to_string(static_cast<int>(max_samples / sample_rate)) + "s");
+            return;
+        }
+        
+        // 与/oneshot相同：超过分段阈值的音频由VAD切分，各语音段并行解码后按顺序拼接
+        try {
+            bool has_speech = engine->decode_recording(std::move(samples), segment_threshold, fields,
+                [con, request, fields](RecognitionResult result, size_t failed_segments, size_t total_segments) {
+                    if (failed_segments > 0) {
+                        std::string message = "Recognition failed";
+                        if (total_segments > 1) {
+                            message += " - " + std::to_string(failed_segments) + " of " + 
+                                       std::to_string(total_segments) + " speech segments failed";
+                        }
+                        send_deferred_error(con, websocketpp::http::status_code::internal_server_error, message);
+                        return;
+                    }
+                    send_transcribe_result(con, std::move(result), fields);
+                }, "HTTP");
+            if (!has_speech) {
+                send_transcribe_result(con, RecognitionResult{}, fields);
+            }
+        } catch (const std::exception& e) {
+            LOG_ERROR("SERVER", "Error during HTTP recognition: " << e.what());
+            send_deferred_error(con, websocketpp::http::status_code::internal_server_error, 
+                                "Recognition failed: " + std::string(e.what()));
+        }
+    });
+}
+
 std::string WebSocketASRServer::get_endpoint_path(connection_hdl hdl) {
     try {
         auto con = ws_server.get_con_from_hdl(hdl);
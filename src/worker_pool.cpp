@@ -0,0 +1,72 @@
+#include "worker_pool.h"
+#include "logger.h"
+#include <algorithm>
+#include <exception>
+
+WorkerPool::WorkerPool(size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    
+    threads.reserve(num_threads);
+    for (size_t i = 0; i < num_threads; ++i) {
+        threads.emplace_back(&WorkerPool::worker_loop, this);
+    }
+    
+    LOG_INFO("WORKER_POOL", "Worker pool started with " << num_threads << " threads");
+}
+
+WorkerPool::~WorkerPool() {
+    shutdown();
+}
+
+void WorkerPool::post(Task task) {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        if (stopping) {
+            LOG_WARN("WORKER_POOL", "Worker pool stopped, dropping task");
+            return;
+        }
+        tasks.push_back(std::move(task));
+        queued_tasks.fetch_add(1, std::memory_order_relaxed);
+    }
+    tasks_cv.notify_one();
+}
+
+void WorkerPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(tasks_mutex);
+        if (stopping) return;
+        stopping = true;
+    }
+    tasks_cv.notify_all();
+    
+    for (auto& thread : threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    LOG_INFO("WORKER_POOL", "Worker pool stopped");
+}
+
+void WorkerPool::worker_loop() {
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(tasks_mutex);
+            tasks_cv.wait(lock, [this] { return !tasks.empty() || stopping; });
+            if (tasks.empty()) break;
+            
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            queued_tasks.fetch_sub(1, std::memory_order_relaxed);
+        }
+        
+        try {
+            task();
+        } catch (const std::exception& e) {
+            LOG_ERROR("WORKER_POOL", "Error in worker task: " << e.what());
+        }
+        completed_tasks++;
+    }
+}
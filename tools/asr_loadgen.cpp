@@ -0,0 +1,833 @@
+// ASR服务压测工具：N个并发连接向/sttRealtime或/oneshot回放WAV文件，按实时或加速节奏发送音频，
+// 统计实时率、首个部分结果延迟、语音结束到最终结果延迟(p50/p95/p99)、掉线数以及服务端CPU占用
+// 用法: asr_loadgen [options] <file.wav> [file2.wav ...]，详见 --help
+#include "audio_ingest.h"
+
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
+#include <json/json.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+namespace {
+
+typedef websocketpp::client<websocketpp::config::asio_client> Client;
+typedef std::chrono::steady_clock Clock;
+
+enum class Mode { STREAMING, ONESHOT, MIXED };
+
+struct Options {
+    std::string host = "localhost";
+    int port = 8000;
+    Mode mode = Mode::STREAMING;
+    size_t connections = 10;
+    double speed = 1.0;            // 1.0为实时，>1为加速，0为不限速
+    int chunk_ms = 100;            // 每个二进制帧的音频时长
+    int sample_rate = 16000;
+    int ramp_ms = 1000;            // 在该时间内均匀建立全部连接
+    int io_threads = 2;
+    int tail_silence_ms = 1000;    // 流式回放结束后追加的静音，促使服务端VAD结束最后一段
+    int eos_silence_ms = 250;      // 客户端能量端点检测的最小静音时长，应与VAD_MIN_SILENCE_DURATION一致
+    int drain_ms = 2000;           // 流式发送完毕后无消息超过该时长即认为结束
+    int timeout_s = 60;            // 发送完毕后等待结果的最长时间
+    int server_pid = 0;            // 服务端进程号，用于采样/proc/<pid>/stat
+    bool json_output = false;
+    std::vector<std::string> files;
+};
+
+// 单声道int16音频及客户端端点检测结果（样本位置）
+struct WavFile {
+    std::string path;
+    std::vector<int16_t> samples;
+    std::vector<size_t> speech_starts;
+    std::vector<size_t> speech_ends;
+};
+
+// 与服务端共用audio_ingest的WAV解析（16位PCM，多声道下混为单声道），回放前转换回int16
+bool read_wav(const std::string& path, int expected_rate, WavFile& wav, std::string& error) {
+    std::vector<float> samples;
+    if (!audio_ingest::load_wav_file(path, expected_rate, samples, error)) {
+        if (error.compare(0, 11, "sample rate") == 0) {
+            error += " (resample with: ffmpeg -i in.wav -ar " + std::to_string(expected_rate) + " -ac 1 out.wav)";
+        }
+        return false;
+    }
+    if (samples.empty()) {
+        error = "empty data chunk";
+        return false;
+    }
+
+    wav.path = path;
+    wav.samples.resize(samples.size());
+    for (size_t i = 0; i < samples.size(); ++i) {
+        float scaled = std::max(-32768.0f, std::min(32767.0f, samples[i] * 32768.0f));
+        wav.samples[i] = static_cast<int16_t>(std::lround(scaled));
+    }
+    return true;
+}
+
+// 10ms帧能量端点检测：阈值取峰值帧能量以下35dB（且不低于-60dBFS），
+// 静音持续eos_silence_ms以上视为一句结束。只用于给延迟统计定位"语音结束"时刻
+void detect_endpoints(WavFile& wav, int sample_rate, int eos_silence_ms) {
+    const size_t frame = static_cast<size_t>(sample_rate / 100);
+    const size_t num_frames = wav.samples.size() / frame;
+    std::vector<double> rms(num_frames);
+    double peak = 0.0;
+    for (size_t f = 0; f < num_frames; ++f) {
+        double energy = 0.0;
+        for (size_t i = 0; i < frame; ++i) {
+            double s = wav.samples[f * frame + i] / 32768.0;
+            energy += s * s;
+        }
+        rms[f] = std::sqrt(energy / frame);
+        peak = std::max(peak, rms[f]);
+    }
+    const double threshold = std::max(peak * std::pow(10.0, -35.0 / 20.0), 1e-3);
+    const size_t min_silence_frames = std::max<size_t>(1, static_cast<size_t>(eos_silence_ms / 10));
+
+    bool in_speech = false;
+    size_t last_voiced = 0;
+    for (size_t f = 0; f < num_frames; ++f) {
+        if (rms[f] >= threshold) {
+            if (!in_speech) {
+                in_speech = true;
+                wav.speech_starts.push_back(f * frame);
+            }
+            last_voiced = f;
+        } else if (in_speech && f - last_voiced >= min_silence_frames) {
+            in_speech = false;
+            wav.speech_ends.push_back((last_voiced + 1) * frame);
+        }
+    }
+    if (in_speech) wav.speech_ends.push_back((last_voiced + 1) * frame);
+}
+
+// 单个连接的状态，由发送线程与websocketpp的I/O线程共同访问，全部字段受mutex保护
+struct Session {
+    enum Phase { CONNECTING, WAITING_READY, STREAMING, DRAINING, DONE };
+
+    size_t id = 0;
+    bool oneshot = false;
+    const WavFile* wav = nullptr;
+    size_t total_samples = 0;      // 含流式尾部静音
+
+    std::mutex mutex;
+    Phase phase = CONNECTING;
+    websocketpp::connection_hdl hdl;
+
+    Clock::time_point connect_start, stream_start, send_done, last_message, first_speech_sent;
+    size_t samples_sent = 0;
+    size_t next_start = 0;
+    size_t next_end = 0;
+    std::vector<Clock::time_point> eos_sent;
+    size_t eos_matched = 0;
+
+    double connect_ms = -1.0;
+    double first_partial_ms = -1.0;
+    double oneshot_latency_ms = -1.0;
+    double wall_seconds = 0.0;
+    std::vector<double> eos_to_final_ms;
+    size_t partials = 0;
+    size_t finals = 0;
+
+    bool closing = false;          // 由客户端主动关闭
+    bool connect_failed = false;
+    bool dropped = false;
+    bool server_error = false;
+    bool timed_out = false;
+    bool completed = false;
+    std::string error;
+};
+
+double ms_between(Clock::time_point from, Clock::time_point to) {
+    return std::chrono::duration<double, std::milli>(to - from).count();
+}
+
+// /proc/<pid>/stat采样：累计CPU时间(秒)与常驻内存(字节)
+bool read_proc_stat(int pid, double& cpu_seconds, uint64_t& rss_bytes) {
+    std::ifstream in("/proc/" + std::to_string(pid) + "/stat");
+    std::string content;
+    if (!in || !std::getline(in, content)) return false;
+
+    // 进程名可能包含空格，从最后一个')'之后开始解析，第3个字段是state
+    size_t pos = content.rfind(')');
+    if (pos == std::string::npos) return false;
+    std::istringstream fields(content.substr(pos + 2));
+    std::string field;
+    unsigned long long utime = 0, stime = 0;
+    long long rss_pages = 0;
+    for (int index = 3; fields >> field; ++index) {
+        if (index == 14) utime = std::strtoull(field.c_str(), nullptr, 10);
+        else if (index == 15) stime = std::strtoull(field.c_str(), nullptr, 10);
+        else if (index == 24) {
+            rss_pages = std::strtoll(field.c_str(), nullptr, 10);
+            break;
+        }
+    }
+    static const long ticks = sysconf(_SC_CLK_TCK);
+    static const long page_size = sysconf(_SC_PAGESIZE);
+    cpu_seconds = static_cast<double>(utime + stime) / ticks;
+    rss_bytes = static_cast<uint64_t>(std::max<long long>(rss_pages, 0)) * page_size;
+    return true;
+}
+
+double process_cpu_seconds() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 +
+           usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+struct Percentiles {
+    size_t count = 0;
+    double p50 = 0, p95 = 0, p99 = 0, max = 0, mean = 0;
+};
+
+Percentiles compute_percentiles(std::vector<double> values) {
+    Percentiles p;
+    p.count = values.size();
+    if (values.empty()) return p;
+    std::sort(values.begin(), values.end());
+    // nearest-rank
+    auto rank = [&](double q) {
+        size_t index = static_cast<size_t>(std::ceil(q * values.size()));
+        return values[std::min(values.size() - 1, index > 0 ? index - 1 : 0)];
+    };
+    p.p50 = rank(0.50);
+    p.p95 = rank(0.95);
+    p.p99 = rank(0.99);
+    p.max = values.back();
+    double sum = 0.0;
+    for (double v : values) sum += v;
+    p.mean = sum / values.size();
+    return p;
+}
+
+Json::Value percentiles_to_json(const Percentiles& p) {
+    Json::Value value;
+    value["count"] = static_cast<Json::UInt64>(p.count);
+    value["p50"] = p.p50;
+    value["p95"] = p.p95;
+    value["p99"] = p.p99;
+    value["max"] = p.max;
+    value["mean"] = p.mean;
+    return value;
+}
+
+void print_percentiles(const std::string& name, const Percentiles& p, const std::string& unit) {
+    std::cout << std::left << std::setw(28) << name << std::right;
+    if (p.count == 0) {
+        std::cout << "n/a" << std::endl;
+        return;
+    }
+    std::cout << std::fixed << std::setprecision(p.max < 10.0 ? 3 : 1)
+              << "n=" << p.count << "  p50=" << p.p50 << "  p95=" << p.p95
+              << "  p99=" << p.p99 << "  max=" << p.max << " " << unit << std::endl;
+}
+
+class LoadGenerator {
+public:
+    LoadGenerator(const Options& options, const std::vector<WavFile>& wavs)
+        : opts(options), wavs(wavs) {
+        client.clear_access_channels(websocketpp::log::alevel::all);
+        client.clear_error_channels(websocketpp::log::elevel::all);
+        client.init_asio();
+        client.start_perpetual();
+
+        sessions.reserve(opts.connections);
+        for (size_t i = 0; i < opts.connections; ++i) {
+            auto session = std::make_unique<Session>();
+            session->id = i;
+            session->oneshot = opts.mode == Mode::ONESHOT || (opts.mode == Mode::MIXED && i % 2 == 1);
+            session->wav = &wavs[i % wavs.size()];
+            size_t tail = session->oneshot ? 0 : static_cast<size_t>(opts.tail_silence_ms) * opts.sample_rate / 1000;
+            session->total_samples = session->wav->samples.size() + tail;
+            sessions.push_back(std::move(session));
+        }
+        chunk_samples = std::max<size_t>(1, static_cast<size_t>(opts.chunk_ms) * opts.sample_rate / 1000);
+    }
+
+    void run() {
+        std::vector<std::thread> io_threads;
+        for (int i = 0; i < opts.io_threads; ++i) {
+            io_threads.emplace_back([this]() { client.run(); });
+        }
+
+        double server_cpu_start = 0.0;
+        uint64_t rss = 0;
+        bool have_server = opts.server_pid > 0 && read_proc_stat(opts.server_pid, server_cpu_start, rss);
+        if (opts.server_pid > 0 && !have_server) {
+            std::cerr << "Warning: cannot read /proc/" << opts.server_pid << "/stat, server CPU will not be reported" << std::endl;
+        }
+        double client_cpu_start = process_cpu_seconds();
+        run_start = Clock::now();
+
+        // 服务端CPU每秒采样一次，记录平均与峰值
+        double last_cpu = server_cpu_start;
+        Clock::time_point last_sample = run_start;
+        peak_server_rss = rss;
+
+        size_t launched = 0;
+        while (true) {
+            Clock::time_point now = Clock::now();
+
+            // 按ramp节奏建立连接
+            while (launched < sessions.size() &&
+                   (opts.ramp_ms <= 0 || ms_between(run_start, now) >= static_cast<double>(opts.ramp_ms) * launched / sessions.size())) {
+                launch(*sessions[launched++]);
+            }
+
+            bool all_done = launched == sessions.size();
+            for (size_t i = 0; i < launched; ++i) {
+                if (!pump(*sessions[i], now)) all_done = false;
+            }
+
+            if (have_server && ms_between(last_sample, now) >= 1000.0) {
+                double cpu = 0.0;
+                if (read_proc_stat(opts.server_pid, cpu, rss)) {
+                    double percent = (cpu - last_cpu) * 100.0 / (ms_between(last_sample, now) / 1000.0);
+                    peak_server_cpu = std::max(peak_server_cpu, percent);
+                    peak_server_rss = std::max(peak_server_rss, rss);
+                    last_cpu = cpu;
+                }
+                last_sample = now;
+            }
+
+            if (all_done) break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+
+        run_seconds = ms_between(run_start, Clock::now()) / 1000.0;
+        client_cpu_percent = (process_cpu_seconds() - client_cpu_start) * 100.0 / run_seconds;
+        if (have_server) {
+            double cpu = 0.0;
+            if (read_proc_stat(opts.server_pid, cpu, rss)) {
+                server_cpu_percent = (cpu - server_cpu_start) * 100.0 / run_seconds;
+                peak_server_rss = std::max(peak_server_rss, rss);
+            }
+        }
+        server_cpu_reported = have_server;
+
+        client.stop_perpetual();
+        client.stop();
+        for (auto& thread : io_threads) thread.join();
+    }
+
+    void report() const {
+        size_t ok = 0, connect_failed = 0, dropped = 0, timed_out = 0, server_errors = 0, finals = 0, partials = 0, missing_finals = 0;
+        double audio_seconds = 0.0;
+        std::vector<double> connect_ms, first_partial_ms, eos_to_final_ms, oneshot_ms, rtf;
+        for (const auto& session : sessions) {
+            if (session->completed) ok++;
+            if (session->connect_failed) connect_failed++;
+            if (session->dropped) dropped++;
+            if (session->timed_out) timed_out++;
+            if (session->server_error) server_errors++;
+            finals += session->finals;
+            partials += session->partials;
+            if (session->connect_ms >= 0) connect_ms.push_back(session->connect_ms);
+            if (session->first_partial_ms >= 0) first_partial_ms.push_back(session->first_partial_ms);
+            if (session->oneshot_latency_ms >= 0) oneshot_ms.push_back(session->oneshot_latency_ms);
+            eos_to_final_ms.insert(eos_to_final_ms.end(), session->eos_to_final_ms.begin(), session->eos_to_final_ms.end());
+            if (!session->oneshot) missing_finals += session->eos_sent.size() - session->eos_matched;
+
+            double session_audio = static_cast<double>(session->samples_sent) / opts.sample_rate;
+            audio_seconds += session_audio;
+            if (session->completed && session_audio > 0.0) {
+                // 流式：从开始发送到最后一条消息的墙钟时间/音频时长；oneshot：停止录音到结果的解码时间/音频时长
+                rtf.push_back(session->oneshot ? session->oneshot_latency_ms / 1000.0 / session_audio
+                                               : session->wall_seconds / session_audio);
+            }
+        }
+
+        const Percentiles connect_p = compute_percentiles(connect_ms);
+        const Percentiles first_partial_p = compute_percentiles(first_partial_ms);
+        const Percentiles eos_p = compute_percentiles(eos_to_final_ms);
+        const Percentiles oneshot_p = compute_percentiles(oneshot_ms);
+        const Percentiles rtf_p = compute_percentiles(rtf);
+
+        if (opts.json_output) {
+            Json::Value root;
+            root["mode"] = mode_name();
+            root["connections"] = static_cast<Json::UInt64>(sessions.size());
+            root["speed"] = opts.speed;
+            root["completed"] = static_cast<Json::UInt64>(ok);
+            root["connect_failed"] = static_cast<Json::UInt64>(connect_failed);
+            root["dropped"] = static_cast<Json::UInt64>(dropped);
+            root["timed_out"] = static_cast<Json::UInt64>(timed_out);
+            root["server_errors"] = static_cast<Json::UInt64>(server_errors);
+            root["partials"] = static_cast<Json::UInt64>(partials);
+            root["finals"] = static_cast<Json::UInt64>(finals);
+            root["missing_finals"] = static_cast<Json::UInt64>(missing_finals);
+            root["audio_seconds"] = audio_seconds;
+            root["wall_seconds"] = run_seconds;
+            root["connect_ms"] = percentiles_to_json(connect_p);
+            root["first_partial_ms"] = percentiles_to_json(first_partial_p);
+            root["eos_to_final_ms"] = percentiles_to_json(eos_p);
+            root["oneshot_latency_ms"] = percentiles_to_json(oneshot_p);
+            root["rtf"] = percentiles_to_json(rtf_p);
+            root["loadgen_cpu_percent"] = client_cpu_percent;
+            if (server_cpu_reported) {
+                root["server_cpu_percent"] = server_cpu_percent;
+                root["server_cpu_peak_percent"] = peak_server_cpu;
+                root["server_peak_rss_bytes"] = static_cast<Json::UInt64>(peak_server_rss);
+            }
+            Json::StreamWriterBuilder builder;
+            std::cout << Json::writeString(builder, root) << std::endl;
+            return;
+        }
+
+        std::cout << "=== ASR Load Test Summary ===" << std::endl;
+        std::cout << "Mode: " << mode_name() << ", connections: " << sessions.size()
+                  << ", speed: " << (opts.speed > 0 ? std::to_string(opts.speed) + "x" : std::string("unlimited"))
+                  << ", files: " << wavs.size() << std::endl;
+        std::cout << "Sessions: completed " << ok << ", connect failed " << connect_failed
+                  << ", dropped " << dropped << ", timed out " << timed_out
+                  << ", server errors " << server_errors << std::endl;
+        std::cout << "Results: " << partials << " partials, " << finals << " finals";
+        if (opts.mode != Mode::ONESHOT) std::cout << ", " << missing_finals << " speech ends without final";
+        std::cout << std::endl;
+        std::cout << std::fixed << std::setprecision(1)
+                  << "Audio: " << audio_seconds << " s sent in " << run_seconds << " s wall ("
+                  << (run_seconds > 0 ? audio_seconds / run_seconds : 0.0) << "x real time aggregate)" << std::endl;
+        print_percentiles("Connect (ms)", connect_p, "ms");
+        print_percentiles("RTF", rtf_p, "");
+        if (opts.mode != Mode::ONESHOT) {
+            print_percentiles("First partial (ms)", first_partial_p, "ms");
+            print_percentiles("End of speech -> final (ms)", eos_p, "ms");
+        }
+        if (opts.mode != Mode::STREAMING) {
+            print_percentiles("Oneshot stop -> result (ms)", oneshot_p, "ms");
+        }
+        std::cout << std::fixed << std::setprecision(1);
+        if (server_cpu_reported) {
+            std::cout << "Server CPU: avg " << server_cpu_percent << "%, peak " << peak_server_cpu
+                      << "% (100% = one core), peak RSS " << peak_server_rss / (1024.0 * 1024.0) << " MiB" << std::endl;
+        }
+        std::cout << "Loadgen CPU: " << client_cpu_percent << "%";
+        if (client_cpu_percent > 80.0 * opts.io_threads) {
+            std::cout << " (load generator may be saturated, increase --io-threads)";
+        }
+        std::cout << std::endl;
+    }
+
+    bool has_failures() const {
+        for (const auto& session : sessions) {
+            if (!session->completed) return true;
+        }
+        return false;
+    }
+
+private:
+    const Options& opts;
+    const std::vector<WavFile>& wavs;
+    Client client;
+    std::vector<std::unique_ptr<Session>> sessions;
+    size_t chunk_samples = 1600;
+
+    Clock::time_point run_start;
+    double run_seconds = 0.0;
+    double client_cpu_percent = 0.0;
+    double server_cpu_percent = 0.0;
+    double peak_server_cpu = 0.0;
+    uint64_t peak_server_rss = 0;
+    bool server_cpu_reported = false;
+
+    std::string mode_name() const {
+        switch (opts.mode) {
+            case Mode::STREAMING: return "streaming";
+            case Mode::ONESHOT: return "oneshot";
+            default: return "mixed";
+        }
+    }
+
+    void launch(Session& session) {
+        std::string uri = "ws://" + opts.host + ":" + std::to_string(opts.port) +
+            (session.oneshot ? std::string("/oneshot") : "/sttRealtime?samplerate=" + std::to_string(opts.sample_rate));
+
+        std::lock_guard<std::mutex> lock(session.mutex);
+        session.connect_start = Clock::now();
+
+        websocketpp::lib::error_code ec;
+        Client::connection_ptr con = client.get_connection(uri, ec);
+        if (ec) {
+            session.connect_failed = true;
+            session.error = ec.message();
+            session.phase = Session::DONE;
+            return;
+        }
+
+        Session* s = &session;
+        con->set_open_handler([this, s](websocketpp::connection_hdl) { on_open(*s); });
+        con->set_message_handler([this, s](websocketpp::connection_hdl, Client::message_ptr msg) { on_message(*s, msg); });
+        con->set_close_handler([this, s](websocketpp::connection_hdl) { on_close(*s); });
+        con->set_fail_handler([this, s](websocketpp::connection_hdl hdl) { on_fail(*s, hdl); });
+        session.hdl = con->get_handle();
+        client.connect(con);
+    }
+
+    void begin_streaming(Session& session, Clock::time_point now) {
+        session.phase = Session::STREAMING;
+        session.stream_start = now;
+        session.last_message = now;
+    }
+
+    void on_open(Session& session) {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        Clock::time_point now = Clock::now();
+        session.connect_ms = ms_between(session.connect_start, now);
+        if (session.oneshot) {
+            // 等待服务端"ready"后再发送start
+            session.phase = Session::WAITING_READY;
+        } else {
+            begin_streaming(session, now);
+        }
+    }
+
+    void on_message(Session& session, Client::message_ptr msg) {
+        Clock::time_point now = Clock::now();
+        Json::Value root;
+        Json::CharReaderBuilder builder;
+        std::string errors;
+        const std::string& payload = msg->get_payload();
+        std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+        if (!reader->parse(payload.data(), payload.data() + payload.size(), &root, &errors)) return;
+
+        std::lock_guard<std::mutex> lock(session.mutex);
+        session.last_message = now;
+
+        if (session.oneshot) {
+            std::string type = root.get("type", "").asString();
+            if (type == "status") {
+                std::string status = root.get("status", "").asString();
+                if (status == "ready" && session.phase == Session::WAITING_READY) {
+                    websocketpp::lib::error_code ec;
+                    client.send(session.hdl, "{\"command\":\"start\"}", websocketpp::frame::opcode::text, ec);
+                } else if (status == "recording" && session.phase == Session::WAITING_READY) {
+                    begin_streaming(session, now);
+                }
+            } else if (type == "result") {
+                session.finals++;
+                if (session.phase == Session::DRAINING) {
+                    session.oneshot_latency_ms = ms_between(session.send_done, now);
+                }
+                finish(session, now);
+            } else if (type == "error") {
+                session.error = root.get("message", "").asString();
+                session.server_error = true;
+                finish(session, now);
+            }
+            return;
+        }
+
+        if (!root.isMember("text")) return;
+        bool has_text = !root["text"].asString().empty();
+        if (root.get("finished", false).asBool()) {
+            session.finals++;
+            // 与最近一个已发送、尚未匹配的语音结束点配对；更早的未匹配结束点视为被服务端合并
+            if (has_text && session.eos_matched < session.eos_sent.size()) {
+                session.eos_to_final_ms.push_back(ms_between(session.eos_sent.back(), now));
+                session.eos_matched = session.eos_sent.size();
+            }
+        } else {
+            session.partials++;
+            if (has_text && session.first_partial_ms < 0) {
+                Clock::time_point reference = session.next_start > 0 ? session.first_speech_sent : session.stream_start;
+                session.first_partial_ms = std::max(0.0, ms_between(reference, now));
+            }
+        }
+    }
+
+    void on_close(Session& session) {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        if (session.phase != Session::DONE) {
+            if (!session.closing) {
+                session.dropped = true;
+                websocketpp::lib::error_code ec;
+                Client::connection_ptr con = client.get_con_from_hdl(session.hdl, ec);
+                if (con) session.error = "closed by server: " + con->get_remote_close_reason();
+            }
+            session.phase = Session::DONE;
+        }
+    }
+
+    void on_fail(Session& session, websocketpp::connection_hdl hdl) {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        websocketpp::lib::error_code ec;
+        Client::connection_ptr con = client.get_con_from_hdl(hdl, ec);
+        if (session.connect_ms < 0) {
+            session.connect_failed = true;
+        } else {
+            session.dropped = true;
+        }
+        if (con) session.error = con->get_ec().message();
+        session.phase = Session::DONE;
+    }
+
+    // 调用方持有session.mutex
+    void finish(Session& session, Clock::time_point now) {
+        if (session.closing || session.phase == Session::DONE) return;
+        session.closing = true;
+        session.completed = session.error.empty();
+        session.wall_seconds = ms_between(session.stream_start, now) / 1000.0;
+        websocketpp::lib::error_code ec;
+        client.close(session.hdl, websocketpp::close::status::normal, "", ec);
+        if (ec) session.phase = Session::DONE;
+    }
+
+    // 发送到期的音频帧并检查结束/超时。会话已结束时返回true
+    bool pump(Session& session, Clock::time_point now) {
+        std::lock_guard<std::mutex> lock(session.mutex);
+        switch (session.phase) {
+            case Session::DONE:
+                return true;
+            case Session::CONNECTING:
+            case Session::WAITING_READY:
+                if (ms_between(session.connect_start, now) > opts.timeout_s * 1000.0) {
+                    session.timed_out = true;
+                    session.error = "timed out waiting for session start";
+                    close_with_error(session);
+                }
+                return false;
+            case Session::STREAMING:
+                send_due_audio(session, now);
+                return false;
+            case Session::DRAINING:
+                break;
+        }
+
+        if (ms_between(session.send_done, now) > opts.timeout_s * 1000.0) {
+            session.timed_out = true;
+            session.error = "timed out waiting for result";
+            close_with_error(session);
+        } else if (!session.oneshot && ms_between(std::max(session.send_done, session.last_message), now) > opts.drain_ms) {
+            // 流式会话以最后一条消息的时间作为结束时刻，不计入drain等待
+            Clock::time_point end = std::max(session.send_done, session.last_message);
+            finish(session, now);
+            session.wall_seconds = ms_between(session.stream_start, end) / 1000.0;
+        }
+        return false;
+    }
+
+    void close_with_error(Session& session) {
+        websocketpp::lib::error_code ec;
+        session.closing = true;
+        client.close(session.hdl, websocketpp::close::status::normal, session.error, ec);
+        session.phase = Session::DONE;
+    }
+
+    void send_due_audio(Session& session, Clock::time_point now) {
+        size_t due = session.total_samples;
+        if (opts.speed > 0) {
+            double elapsed = std::chrono::duration<double>(now - session.stream_start).count();
+            due = std::min(due, static_cast<size_t>(elapsed * opts.speed * opts.sample_rate));
+        }
+
+        websocketpp::lib::error_code con_ec;
+        Client::connection_ptr con = client.get_con_from_hdl(session.hdl, con_ec);
+        if (!con) return;
+
+        const std::vector<int16_t>& samples = session.wav->samples;
+        std::vector<int16_t> silence;
+        while (session.samples_sent + chunk_samples <= due || (due == session.total_samples && session.samples_sent < due)) {
+            // 不限速模式下按发送缓冲背压，避免把整个文件堆在客户端内存中
+            if (opts.speed <= 0 && con->get_buffered_amount() > 64 * chunk_samples * sizeof(int16_t)) break;
+
+            size_t begin = session.samples_sent;
+            size_t end = std::min(begin + chunk_samples, session.total_samples);
+            websocketpp::lib::error_code ec;
+            if (begin >= samples.size()) {
+                silence.assign(end - begin, 0);
+                client.send(session.hdl, silence.data(), silence.size() * sizeof(int16_t), websocketpp::frame::opcode::binary, ec);
+            } else {
+                end = std::min(end, samples.size());
+                client.send(session.hdl, samples.data() + begin, (end - begin) * sizeof(int16_t), websocketpp::frame::opcode::binary, ec);
+            }
+            if (ec) return;
+            session.samples_sent = end;
+
+            Clock::time_point sent_at = Clock::now();
+            const WavFile& wav = *session.wav;
+            while (session.next_start < wav.speech_starts.size() && wav.speech_starts[session.next_start] < end) {
+                if (session.next_start == 0) session.first_speech_sent = sent_at;
+                session.next_start++;
+            }
+            while (session.next_end < wav.speech_ends.size() && wav.speech_ends[session.next_end] <= end) {
+                session.eos_sent.push_back(sent_at);
+                session.next_end++;
+            }
+        }
+
+        if (session.samples_sent >= session.total_samples) {
+            session.phase = Session::DRAINING;
+            session.send_done = Clock::now();
+            if (session.oneshot) {
+                websocketpp::lib::error_code ec;
+                client.send(session.hdl, "{\"command\":\"stop\"}", websocketpp::frame::opcode::text, ec);
+            }
+        }
+    }
+};
+
+void print_usage(const char* program_name) {
+    std::cout << "ASR WebSocket load generator\n\n"
+              << "Usage: " << program_name << " [options] <file.wav> [file2.wav ...]\n\n"
+              << "Options:\n"
+              << "  --host HOST              Server host (default: localhost)\n"
+              << "  --port PORT              Server port (default: 8000)\n"
+              << "  --mode MODE              streaming | oneshot | mixed (default: streaming)\n"
+              << "  -c, --connections N      Concurrent connections (default: 10)\n"
+              << "  --speed X                Pacing: 1 = real time, 2 = twice real time, 0 = unlimited (default: 1)\n"
+              << "  --chunk-ms MS            Audio per binary frame (default: 100)\n"
+              << "  --sample-rate HZ         Expected WAV sample rate (default: 16000)\n"
+              << "  --ramp-ms MS             Spread connection setup over this interval (default: 1000)\n"
+              << "  --io-threads N           Client I/O threads (default: 2)\n"
+              << "  --tail-silence-ms MS     Silence appended to streaming sessions (default: 1000)\n"
+              << "  --eos-silence-ms MS      Client endpoint detector min silence, match VAD_MIN_SILENCE_DURATION (default: 250)\n"
+              << "  --drain-ms MS            Close streaming sessions after this long without messages (default: 2000)\n"
+              << "  --timeout-s S            Give up on a session after this long (default: 60)\n"
+              << "  --server-pid PID         Sample server CPU and RSS from /proc/PID/stat\n"
+              << "  --json                   Print the summary as one JSON object\n"
+              << "  --help, -h               Show this help message\n\n"
+              << "WAV files must be 16-bit PCM at --sample-rate; multi-channel files are downmixed.\n"
+              << "Files are assigned to connections round-robin; mixed mode alternates streaming/oneshot.\n\n"
+              << "Metrics:\n"
+              << "  RTF                  streaming: wall time from first frame to last result / audio duration\n"
+              << "                       (about 1.0 when paced in real time; use --speed 0 for server throughput)\n"
+              << "                       oneshot: stop -> result time / audio duration\n"
+              << "  First partial        first non-empty partial, measured from the first voiced frame sent\n"
+              << "  End of speech->final final result, measured from the frame that ended a voiced region\n"
+              << "                       (energy endpoint detector; meaningful at --speed <= 1)\n\n"
+              << "Exit status is 1 when any session failed, dropped or timed out.\n";
+}
+
+bool parse_args(int argc, char* argv[], Options& opts) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            std::exit(0);
+        }
+        else if (arg == "--host" && i + 1 < argc) {
+            opts.host = argv[++i];
+        }
+        else if (arg == "--port" && i + 1 < argc) {
+            opts.port = std::stoi(argv[++i]);
+        }
+        else if (arg == "--mode" && i + 1 < argc) {
+            std::string mode = argv[++i];
+            if (mode == "streaming") opts.mode = Mode::STREAMING;
+            else if (mode == "oneshot") opts.mode = Mode::ONESHOT;
+            else if (mode == "mixed") opts.mode = Mode::MIXED;
+            else {
+                std::cerr << "Unknown mode: " << mode << std::endl;
+                return false;
+            }
+        }
+        else if ((arg == "--connections" || arg == "-c") && i + 1 < argc) {
+            opts.connections = std::stoul(argv[++i]);
+        }
+        else if (arg == "--speed" && i + 1 < argc) {
+            opts.speed = std::stod(argv[++i]);
+        }
+        else if (arg == "--chunk-ms" && i + 1 < argc) {
+            opts.chunk_ms = std::stoi(argv[++i]);
+        }
+        else if (arg == "--sample-rate" && i + 1 < argc) {
+            opts.sample_rate = std::stoi(argv[++i]);
+        }
+        else if (arg == "--ramp-ms" && i + 1 < argc) {
+            opts.ramp_ms = std::stoi(argv[++i]);
+        }
+        else if (arg == "--io-threads" && i + 1 < argc) {
+            opts.io_threads = std::stoi(argv[++i]);
+        }
+        else if (arg == "--tail-silence-ms" && i + 1 < argc) {
+            opts.tail_silence_ms = std::stoi(argv[++i]);
+        }
+        else if (arg == "--eos-silence-ms" && i + 1 < argc) {
+            opts.eos_silence_ms = std::stoi(argv[++i]);
+        }
+        else if (arg == "--drain-ms" && i + 1 < argc) {
+            opts.drain_ms = std::stoi(argv[++i]);
+        }
+        else if (arg == "--timeout-s" && i + 1 < argc) {
+            opts.timeout_s = std::stoi(argv[++i]);
+        }
+        else if (arg == "--server-pid" && i + 1 < argc) {
+            opts.server_pid = std::stoi(argv[++i]);
+        }
+        else if (arg == "--json") {
+            opts.json_output = true;
+        }
+        else if (!arg.empty() && arg[0] == '-') {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return false;
+        }
+        else {
+            opts.files.push_back(arg);
+        }
+    }
+
+    if (opts.files.empty()) {
+        std::cerr << "No WAV files given" << std::endl;
+        return false;
+    }
+    if (opts.connections == 0 || opts.chunk_ms <= 0 || opts.sample_rate <= 0 || opts.io_threads <= 0 ||
+        opts.speed < 0 || opts.timeout_s <= 0 || opts.drain_ms <= 0) {
+        std::cerr << "Invalid option value" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options opts;
+    try {
+        if (!parse_args(argc, argv, opts)) {
+            print_usage(argv[0]);
+            return 2;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Invalid argument: " << e.what() << std::endl;
+        return 2;
+    }
+
+    std::vector<WavFile> wavs;
+    for (const auto& path : opts.files) {
+        WavFile wav;
+        std::string error;
+        if (!read_wav(path, opts.sample_rate, wav, error)) {
+            std::cerr << "Failed to load " << path << ": " << error << std::endl;
+            return 2;
+        }
+        detect_endpoints(wav, opts.sample_rate, opts.eos_silence_ms);
+        wavs.push_back(std::move(wav));
+    }
+
+    LoadGenerator generator(opts, wavs);
+    generator.run();
+    generator.report();
+    return generator.has_failures() ? 1 : 0;
+}
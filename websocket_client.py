@@ -12,6 +12,7 @@ import os
 from loguru import logger
 import argparse
 import json
+import struct
 from pathlib import Path
 import time
 
@@ -294,12 +295,55 @@ class MicrophoneStream:
         logger.info("录音已停止")
 
 
+BINARY_SUBPROTOCOL = "asr.binary.v1"
+
+
+def decode_binary_result(data):
+    """解析二进制结果帧（asr.binary.v1），返回与JSON结果相同结构的dict"""
+    offset = 0
+
+    def read(fmt):
+        nonlocal offset
+        values = struct.unpack_from(fmt, data, offset)
+        offset += struct.calcsize(fmt)
+        return values[0] if len(values) == 1 else values
+
+    def read_string(length_fmt):
+        nonlocal offset
+        length = read(length_fmt)
+        text = data[offset:offset + length].decode("utf-8")
+        offset += length
+        return text
+
+    version, flags, idx = read("<BBi")
+    if version != 1:
+        raise ValueError(f"不支持的二进制结果版本: {version}")
+    result = {
+        "text": read_string("<I"),
+        "finished": bool(flags & 1),
+        "idx": idx,
+        "lang": read_string("<H"),
+        "emotion": read_string("<H"),
+        "event": read_string("<H"),
+    }
+    count = read("<I")
+    result["timestamps"] = list(struct.unpack_from(f"<{count}f", data, offset))
+    offset += 4 * count
+    count = read("<I")
+    result["tokens"] = [read_string("<H") for _ in range(count)]
+    if flags & 2:
+        result["type"] = "result"
+    return result
+
+
 class ASRWebSocketClient:
     """语音识别WebSocket客户端"""
     
-    def __init__(self, uri, sample_rate=16000):
+    def __init__(self, uri, sample_rate=16000, binary_results=False, fields=None):
         self.uri = uri
         self.sample_rate = sample_rate
+        self.binary_results = binary_results
+        self.fields = fields
         self.websocket = None
         
     async def connect(self):
@@ -307,7 +351,10 @@ class ASRWebSocketClient:
         try:
             # 在URI中添加采样率参数
             connect_uri = f"{self.uri}?samplerate={self.sample_rate}"
-            self.websocket = await websockets.connect(connect_uri)
+            if self.fields:
+                connect_uri += f"&fields={self.fields}"
+            subprotocols = [BINARY_SUBPROTOCOL] if self.binary_results else None
+            self.websocket = await websockets.connect(connect_uri, subprotocols=subprotocols)
             logger.info(f"已连接到 {connect_uri}")
             return True
         except Exception as e:
@@ -336,14 +383,16 @@ class ASRWebSocketClient:
         
         await self.websocket.send(audio_bytes)
         
-    async def send_control_message(self, command):
-        """发送控制消息（用于oneshot接口）"""
+    async def send_control_message(self, command, duration_hint=None):
+        """发送控制消息（用于oneshot接口），duration_hint为预计录音时长（秒）"""
         if not self.websocket:
             raise RuntimeError("未连接到服务器")
         
         control_msg = {
             "command": command
         }
+        if duration_hint:
+            control_msg["duration_hint"] = duration_hint
         await self.websocket.send(json.dumps(control_msg))
         logger.debug(f"发送控制消息: {command}")
 
@@ -354,7 +403,14 @@ class ASRWebSocketClient:
         
         try:
             response = await asyncio.wait_for(self.websocket.recv(), timeout=0.1)
+            if isinstance(response, bytes):
+                return decode_binary_result(response)
             result = json.loads(response)
+            if result.get('type') == 'overflow':
+                # 服务端音频缓冲超出预算，发送速度超过了处理速度
+                logger.warning(f"⚠ [缓冲溢出] 原因: {result.get('reason')}, 处理: {result.get('action')}, "
+                               f"丢弃 {result.get('dropped_samples', 0)} 个采样点")
+                return None
             return result
         except asyncio.TimeoutError:
             return None
@@ -561,7 +617,7 @@ class ASRWebSocketClient:
             receive_task = asyncio.create_task(receive_results())
             
             # 发送开始录音命令
-            await self.send_control_message("start")
+            await self.send_control_message("start", duration_hint=len(audio_data) / self.sample_rate)
             await asyncio.sleep(0.5)  # 等待服务器准备
             
             # 分块发送音频数据
@@ -656,7 +712,7 @@ class ASRWebSocketClient:
             receive_task = asyncio.create_task(receive_results())
             
             # 发送开始录音命令
-            await self.send_control_message("start")
+            await self.send_control_message("start", duration_hint=duration)
             await asyncio.sleep(0.5)  # 等待服务器准备
             
             # 录音和发送音频数据
@@ -720,9 +776,15 @@ async def main():
     parser.add_argument("--duration", type=int, 
                        help="录音时长（秒）。流式模式：不指定则持续录音直到Ctrl+C；OneShot模式：默认10秒")
     
+    # 结果格式
+    parser.add_argument("--binary-results", action="store_true",
+                       help="协商asr.binary.v1子协议，以二进制帧接收识别结果")
+    parser.add_argument("--fields",
+                       help="只接收指定的结果字段，逗号分隔，如 text,timestamps（默认全部）")
+    
     args = parser.parse_args()
     
-    client = ASRWebSocketClient(args.server, args.sample_rate)
+    client = ASRWebSocketClient(args.server, args.sample_rate, args.binary_results, args.fields)
     
     if args.file:
         # 文件模式